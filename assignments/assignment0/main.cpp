@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
 #include <ew/external/glad.h>
 
@@ -13,11 +14,27 @@
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ew/assetManager.h>
+#include <ew/glState.h>
+#include <ew/litShader.h>
+#include <ew/uniformBuffer.h>
+#include <ew/instanceBuffer.h>
+#include <ew/scatter.h>
+#include <ew/noise.h>
+#include <ew/frustum.h>
+#include <ew/terrain.h>
+#include <ew/dynamicMesh.h>
+#include <ew/procGen.h>
+#include <memory>
+#include <vector>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
 void drawUI();
 void resetCamera(ew::Camera* camera, ew::CameraController* controller);
+void buildInstanceGrid(std::vector<glm::mat4>* modelMatrices, int count);
+void scatterInstanceField(std::vector<glm::mat4>* modelMatrices);
+void deformSphere(const ew::MeshData& sphere, float time, ew::DynamicMesh* mesh);
 
 //Creating a camera for us to view our model
 ew::Camera camera;
@@ -31,23 +48,86 @@ int screenHeight = 720;
 float prevFrameTime;
 float deltaTime;
 
-struct Material {
-	float Ka = 1.0;
-	float Kd = 0.5;
-	float Ks = 0.5;
-	float Shininess = 128;
-}material;
+ew::MaterialUniforms material;
+
+//Instancing stress test
+const int MAX_INSTANCES = 100000;
+bool stressTest = false;
+bool useInstancing = true;
+int instanceCount = 1000;
+bool instancesDirty = true; //Rebuild instance matrices before the next draw
+
+//Poisson-disk scatter layout for the stress test
+bool scatterLayout = false;
+bool scatterDensityMask = false;
+float scatterAreaSize = 200.0f;
+ew::ScatterSettings scatterSettings;
+ew::ScatterStats scatterStats;
+
+//Cull stress test instances against the camera before uploading them
+bool frustumCulling = false;
+ew::CullStats cullStats;
+float cullMs;
+
+float submitMs;
+int drawCallsPerFrame;
+int instancesDrawn;
+
+//Asset registry. Switching monkeys leaves the other one cached until the budget pushes it out.
+int assetBudgetMB = 256;
+bool useFbxMonkey = false;
+int extraBrickHandles = 0; //Duplicate requests for the brick texture, which share the first one's GPU copy
+bool unloadUnusedAssets = false;
+ew::AssetStats assetStats;
+std::vector<ew::AssetInfo> assetInfos;
+
+//Parse speed of the OBJ loader against Assimp on the monkey
+bool runObjBenchmark = false;
+bool objBenchmarkDone = false;
+ew::ObjImportBenchmark objBenchmark;
+
+//Streamed terrain under the monkey. Workers start the first time it's shown.
+bool showTerrain = false;
+ew::TerrainSettings terrainSettings;
+ew::TerrainStats terrainStats;
+
+//Sphere next to the monkey, deformed on the CPU every frame and streamed through a DynamicMesh
+bool showBlob = false;
+float blobAmplitude = 0.15f;
+int blobSubdivisions = 64;
+float blobDeformMs;
+int blobVertices;
+unsigned int blobStalls;
 
 int main() {
 	GLFWwindow* window = initWindow("Assignment 0", screenWidth, screenHeight);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
-	//Making a shader with the shader files in the assets folder
-	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
+	//Shared lit shader from assets/ew, with a directional light. The instanced variant is only built once the stress test needs it.
+	ew::ShaderVariants litVariants = ew::createLitShaderVariants();
+	const ew::Shader& shader = litVariants.get(0);
+	ew::UniformBuffer frameBuffer(sizeof(ew::FrameUniforms));
+	ew::UniformBuffer materialBuffer(sizeof(ew::MaterialUniforms));
+	//Declared before every handle, so it outlives them
+	ew::AssetManager assets;
 	//Loading a 3D model for us to render
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
-	//Handles to OpenGL object are unsigned integers
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
+	ew::AssetHandle objMonkey = assets.loadModel("assets/suzanne.obj");
+	ew::AssetHandle fbxMonkey;
+	ew::AssetHandle brickTexture = assets.loadTexture("assets/brick_color.jpg");
+	std::vector<ew::AssetHandle> brickDuplicates;
+	std::unique_ptr<ew::Terrain> terrain;
+	ew::MeshData blobSphere;
+	int blobSphereSubdivisions = 0;
+	//Created the first time it's shown, sized for the largest subdivision the UI allows
+	ew::DynamicMesh blobMesh;
+
+	std::vector<glm::mat4> instanceMatrices;
+	std::vector<glm::mat4> visibleMatrices;
+	std::vector<int> visibleInstances;
+	ew::CullBounds instanceBounds;
+	bool allInstancesUploaded = false; //Instance buffer holds all of instanceMatrices, not a culled subset
+	ew::InstanceBuffer instanceBuffer(MAX_INSTANCES);
+	scatterSettings.minDistance = 3.0f;  //Monkeys are about 2 units wide
 
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
 	camera.target = glm::vec3(0.0f, 0.0f, 0.0f);  //Look at the center of the scene
@@ -68,6 +148,29 @@ int main() {
 
 		cameraController.move(window, &camera, deltaTime);
 
+		assets.setBudget((size_t)assetBudgetMB * 1024 * 1024);
+		if (unloadUnusedAssets) {
+			assets.unloadUnused();
+			unloadUnusedAssets = false;
+		}
+		if (runObjBenchmark) {
+			objBenchmarkDone = ew::benchmarkObjImport("assets/suzanne.obj", &objBenchmark);
+			runObjBenchmark = false;
+		}
+		//Dropping the handle leaves the model cached, so switching back is free until it is evicted
+		if (useFbxMonkey && !fbxMonkey.isValid()) {
+			fbxMonkey = assets.loadModel("assets/Suzanne.fbx");
+		}
+		else if (!useFbxMonkey) {
+			fbxMonkey.reset();
+		}
+		while ((int)brickDuplicates.size() < extraBrickHandles) {
+			brickDuplicates.push_back(assets.loadTexture("assets/brick_color.jpg"));
+		}
+		brickDuplicates.resize(extraBrickHandles);
+		//Fetched every frame, since an evicted asset comes back with new GL objects
+		ew::Model& monkeyModel = *assets.getModel(useFbxMonkey ? fbxMonkey : objMonkey);
+
 		//RENDER
 		glClearColor(0.6f,0.8f,0.92f,1.0f);
 		//Clears backbuffer color and depth values
@@ -77,22 +180,123 @@ int main() {
 		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
 
 		//Bind brick texture to texture unit 0
-		glBindTextureUnit(0, brickTexture);
+		ew::bindTextureUnit(0, assets.getTexture(brickTexture));
+
+		if (stressTest && instancesDirty) {
+			if (scatterLayout)
+				scatterInstanceField(&instanceMatrices);
+			else
+				buildInstanceGrid(&instanceMatrices, instanceCount);
+			instancesDirty = false;
+			allInstancesUploaded = false;
+		}
+		const std::vector<glm::mat4>* drawMatrices = &instanceMatrices;
+		if (stressTest && frustumCulling) {
+			double cullStart = glfwGetTime();
+			//Spheres are unaffected by the shared spin, but recomputed anyway so any monkeyTransform works
+			glm::mat4 monkeyMatrix = monkeyTransform.modelMatrix();
+			instanceBounds.clear();
+			instanceBounds.reserve(instanceMatrices.size());
+			for (size_t i = 0; i < instanceMatrices.size(); i++)
+			{
+				instanceBounds.add(ew::transformSphere(monkeyModel.getBoundingSphere(), instanceMatrices[i] * monkeyMatrix));
+			}
+			ew::frustumCull(ew::extractFrustum(camera.projectionMatrix() * camera.viewMatrix()), instanceBounds, ew::CullShape::SPHERE, &visibleInstances, &cullStats);
+			visibleMatrices.resize(visibleInstances.size());
+			for (size_t i = 0; i < visibleInstances.size(); i++)
+			{
+				visibleMatrices[i] = instanceMatrices[visibleInstances[i]];
+			}
+			cullMs = (float)((glfwGetTime() - cullStart) * 1000.0);
+			//Clamped to MAX_INSTANCES
+			instanceBuffer.update(visibleMatrices.data(), visibleMatrices.size());
+			drawMatrices = &visibleMatrices;
+			allInstancesUploaded = false;
+		}
+		else if (stressTest && !allInstancesUploaded) {
+			//Clamped to MAX_INSTANCES
+			instanceBuffer.update(instanceMatrices.data(), instanceMatrices.size());
+			allInstancesUploaded = true;
+		}
+		int numInstances = stressTest ? (int)instanceBuffer.getCount() : 1;
+		instancesDrawn = numInstances;
+		bool instanced = stressTest && useInstancing;
+
+		//CPU time spent setting uniforms and submitting draws
+		double submitStart = glfwGetTime();
 
 		//Set shader uniforms and draw
-		shader.use();
-		shader.setVec3("_EyePos", camera.position);
+		const ew::Shader& activeShader = instanced ? litVariants.get(ew::LIT_INSTANCED) : shader;
+		activeShader.use();
+		ew::FrameUniforms frameUniforms;
+		frameUniforms.viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+		frameUniforms.eyePos = camera.position;
+		frameBuffer.update(&frameUniforms, sizeof(ew::FrameUniforms));
+		frameBuffer.bind(ew::UNIFORM_BLOCK_FRAME);
+		materialBuffer.update(&material, sizeof(ew::MaterialUniforms));
+		materialBuffer.bind(ew::UNIFORM_BLOCK_MATERIAL);
 		//Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
-		shader.setInt("_MainTex", 0);
+		activeShader.setInt("_MainTex", 0);
 		//transform.modelMatrix() combines translation, rotation, and scale into a 4x4 model matrix
-		shader.setMat4("_Model", monkeyTransform.modelMatrix());
-		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		shader.setFloat("_Material.Ka", material.Ka);
-		shader.setFloat("_Material.Kd", material.Kd);
-		shader.setFloat("_Material.Ks", material.Ks);
-		shader.setFloat("_Material.Shininess", material.Shininess);
+		activeShader.setMat4("_Model", monkeyTransform.modelMatrix());
+
+		if (instanced) {
+			//Every monkey in one call, each reads its matrix from the instance buffer
+			instanceBuffer.bind();
+			monkeyModel.drawInstanced(numInstances);
+			drawCallsPerFrame = monkeyModel.getNumDrawCalls();
+		}
+		else if (stressTest) {
+			//Baseline: one uniform upload and one draw call per monkey
+			drawCallsPerFrame = 0;
+			for (int i = 0; i < numInstances; i++)
+			{
+				shader.setMat4("_Model", (*drawMatrices)[i] * monkeyTransform.modelMatrix());
+				monkeyModel.draw();  //Draws monkey model using current shader
+				drawCallsPerFrame += monkeyModel.getNumDrawCalls();
+			}
+		}
+		else {
+			monkeyModel.draw();  //Draws monkey model using current shader
+			drawCallsPerFrame = monkeyModel.getNumDrawCalls();
+		}
+		submitMs = (float)((glfwGetTime() - submitStart) * 1000.0);
+
+		if (showTerrain) {
+			if (!terrain) {
+				terrain.reset(new ew::Terrain(terrainSettings));
+			}
+			terrain->update(camera);
+			terrainStats = terrain->getStats();
+			//Chunks are in world space. Lowered so the hills stay under the monkey.
+			shader.use();
+			shader.setMat4("_Model", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -terrainSettings.heightScale - 2.0f, 0.0f)));
+			terrain->draw();
+		}
+
+		if (showBlob) {
+			if (blobSphereSubdivisions != blobSubdivisions) {
+				blobSphere = ew::createSphere(1.0f, blobSubdivisions);
+				blobSphereSubdivisions = blobSubdivisions;
+			}
+			if (blobMesh.getMaxVertices() == 0) {
+				ew::MeshData largest = ew::createSphere(1.0f, 256);
+				blobMesh.create((unsigned int)largest.vertices.size(), (unsigned int)largest.indices.size());
+			}
+			double deformStart = glfwGetTime();
+			deformSphere(blobSphere, time, &blobMesh);
+			blobDeformMs = (float)((glfwGetTime() - deformStart) * 1000.0);
+			blobStalls = blobMesh.getNumStalls();
+			blobVertices = blobMesh.getNumVertices();
+			shader.use();
+			shader.setMat4("_Model", glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, 0.0f, 0.0f)));
+			blobMesh.draw();
+		}
 
-		monkeyModel.draw();  //Draws monkey model using current shader
+		//After this frame's draws, so nothing drawn this frame is evicted
+		assets.update();
+		assetStats = assets.getStats();
+		assets.getAssetInfo(&assetInfos);
 
 		drawUI();
 
@@ -116,6 +320,82 @@ void drawUI() {
 		ImGui::SliderFloat("SpecularK", &material.Ks, 0.0f, 1.0f);
 		ImGui::SliderFloat("Shininess", &material.Shininess, 2.0f, 1024.0f);
 	}
+	if (ImGui::CollapsingHeader("Textures")) {
+		const ew::TextureCookStats& cookStats = ew::getTextureCookStats();
+		ImGui::Text("Cooked: %d, loaded cooked: %d", cookStats.cooked, cookStats.loadedCooked);
+		if (cookStats.encodeMs > 0.0) {
+			ImGui::Text("Encode: %.1f ms, %.1f MP/s", cookStats.encodeMs, cookStats.encodedMegapixels / (cookStats.encodeMs / 1000.0));
+		}
+		if (cookStats.mipMs > 0.0) {
+			ImGui::Text("Mips: %.1f ms", cookStats.mipMs);
+		}
+		ImGui::Text("VRAM: %zu KB compressed vs %zu KB RGBA8", cookStats.compressedBytes / 1024, cookStats.uncompressedBytes / 1024);
+	}
+	if (ImGui::CollapsingHeader("Assets")) {
+		ImGui::SliderInt("VRAM budget (MB)", &assetBudgetMB, 1, 1024);
+		ImGui::Checkbox("FBX monkey", &useFbxMonkey);
+		ImGui::SliderInt("Extra brick handles", &extraBrickHandles, 0, 8);
+		if (ImGui::Button("Unload unused")) {
+			unloadUnusedAssets = true;
+		}
+		ImGui::Text("GPU: %.2f MB (peak %.2f MB)", assetStats.gpuBytes / (1024.0 * 1024.0), assetStats.peakGpuBytes / (1024.0 * 1024.0));
+		ImGui::Text("Assets: %d, resident %d, referenced %d", assetStats.assets, assetStats.resident, assetStats.referenced);
+		ImGui::Text("Requests: %d, hits %d", assetStats.requests, assetStats.hits);
+		ImGui::Text("Loads: %d (%d reloads), %.1f ms", assetStats.loads, assetStats.reloads, assetStats.loadMs);
+		ImGui::Text("Evictions: %d, frames over budget: %d", assetStats.evictions, assetStats.overBudgetFrames);
+		for (size_t i = 0; i < assetInfos.size(); i++)
+		{
+			const ew::AssetInfo& info = assetInfos[i];
+			ImGui::Text("%s %s: %d refs, %s, %zu KB, unused %d frames, %d loads", info.type == ew::AssetType::TEXTURE ? "Texture" : "Model", info.filePath.c_str(),
+				info.refCount, info.resident ? "resident" : "evicted", info.gpuBytes / 1024, info.framesSinceUse, info.loads);
+		}
+	}
+	if (ImGui::CollapsingHeader("Instancing")) {
+		ImGui::Checkbox("Stress test", &stressTest);
+		ImGui::Checkbox("Hardware instancing", &useInstancing);
+		instancesDirty |= ImGui::Checkbox("Poisson-disk scatter", &scatterLayout);
+		if (scatterLayout) {
+			instancesDirty |= ImGui::SliderFloat("Area size", &scatterAreaSize, 10.0f, 1000.0f);
+			instancesDirty |= ImGui::SliderFloat("Min distance", &scatterSettings.minDistance, 2.0f, 10.0f);
+			instancesDirty |= ImGui::Checkbox("Density mask", &scatterDensityMask);
+			instancesDirty |= ImGui::SliderInt("Seed", (int*)&scatterSettings.seed, 0, 100);
+			ImGui::Text("Scattered %zu of %zu points in %.2f ms", scatterStats.numPoints, scatterStats.numSampled, scatterStats.seconds * 1000.0);
+			ImGui::Text("%.2f M points/s", scatterStats.pointsPerSecond() / 1000000.0);
+		}
+		else {
+			instancesDirty |= ImGui::SliderInt("Instances", &instanceCount, 1, MAX_INSTANCES);
+		}
+		ImGui::Checkbox("Frustum culling", &frustumCulling);
+		if (frustumCulling) {
+			ImGui::Text("Culled: %d visible / %d tested in %.3f ms", cullStats.visible, cullStats.tested, cullMs);
+		}
+		ImGui::Text("Instances drawn: %d", instancesDrawn);
+		ImGui::Text("Draw calls: %d", drawCallsPerFrame);
+		ImGui::Text("CPU submit: %.3f ms", submitMs);
+	}
+	if (ImGui::CollapsingHeader("OBJ Import")) {
+		if (ImGui::Button("Benchmark OBJ import")) {
+			runObjBenchmark = true;
+		}
+		if (objBenchmarkDone) {
+			ImGui::Text("OBJ loader: %.2f ms, %.1f MB/s (%u threads)", objBenchmark.obj.parseSeconds * 1000.0, objBenchmark.objMegabytesPerSecond(), objBenchmark.obj.numThreads);
+			ImGui::Text("Assimp:     %.2f ms, %.1f MB/s", objBenchmark.assimpSeconds * 1000.0, objBenchmark.assimpMegabytesPerSecond());
+		}
+	}
+	if (ImGui::CollapsingHeader("Terrain")) {
+		ImGui::Checkbox("Show terrain", &showTerrain);
+		ImGui::Text("Chunks: %d resident, %d pending, %u generated", terrainStats.residentChunks, terrainStats.pendingChunks, terrainStats.chunksGenerated);
+		ImGui::Text("Generate: %.2f ms last, %.2f ms average", terrainStats.lastChunkMs, terrainStats.avgChunkMs);
+		ImGui::Text("Memory: %.1f MB resident (peak %.1f MB) of %.1f MB pool", terrainStats.residentBytes / (1024.0 * 1024.0),
+			terrainStats.peakResidentBytes / (1024.0 * 1024.0), terrainStats.poolBytes / (1024.0 * 1024.0));
+	}
+	if (ImGui::CollapsingHeader("Dynamic Mesh")) {
+		ImGui::Checkbox("Deforming sphere", &showBlob);
+		ImGui::SliderFloat("Amplitude", &blobAmplitude, 0.0f, 0.5f);
+		ImGui::SliderInt("Subdivisions", &blobSubdivisions, 8, 256);
+		ImGui::Text("Vertices: %d, deform + write %.3f ms", blobVertices, blobDeformMs);
+		ImGui::Text("Ring stalls: %u", blobStalls);
+	}
 	ImGui::End();
 
 	ImGui::Render();
@@ -154,6 +434,7 @@ GLFWwindow* initWindow(const char* title, int width, int height) {
 		printf("GLAD Failed to load GL headers");
 		return nullptr;
 	}
+	ew::initParallelShaderCompile(glfwGetProcAddress);
 
 	//Initialize ImGUI
 	IMGUI_CHECKVERSION();
@@ -169,4 +450,67 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller)
 	camera->position = glm::vec3(0, 0, 5.0f);
 	camera->target = glm::vec3(0);
 	controller->yaw = controller->pitch = 0;
-}
\ No newline at end of file
+}
+
+/// <summary>
+/// Lays out count model matrices in a square grid on the XZ plane, centered on the origin
+/// </summary>
+void buildInstanceGrid(std::vector<glm::mat4>* modelMatrices, int count)
+{
+	const float spacing = 3.0f;
+	int columns = (int)ceilf(sqrtf((float)count));
+	float halfWidth = (columns - 1) * spacing * 0.5f;
+	modelMatrices->resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 position = glm::vec3((i % columns) * spacing - halfWidth, 0.0f, -(i / columns) * spacing);
+		(*modelMatrices)[i] = glm::translate(glm::mat4(1.0f), position);
+	}
+}
+
+/// <summary>
+/// Scatters monkeys over a square area with the Poisson-disk sampler, optionally thinned by an fBm density mask
+/// </summary>
+void scatterInstanceField(std::vector<glm::mat4>* modelMatrices)
+{
+	scatterSettings.min = glm::vec2(-scatterAreaSize * 0.5f, -scatterAreaSize);
+	scatterSettings.max = glm::vec2(scatterAreaSize * 0.5f, 0.0f);
+	ew::ScatterDensityFn density = nullptr;
+	if (scatterDensityMask) {
+		density = [](float x, float z) {
+			ew::FbmSettings noise;
+			return ew::fbm2D(x, z, noise) * 0.5f + 0.5f;
+		};
+	}
+	ew::scatterInstances(scatterSettings, modelMatrices, density, nullptr, &scatterStats);
+}
+
+/// <summary>
+/// Writes sphere into the next segment of mesh with its radius pushed in and out by moving waves.
+/// Normals come from the radius' gradient, so lighting follows the bumps.
+/// </summary>
+void deformSphere(const ew::MeshData& sphere, float time, ew::DynamicMesh* mesh)
+{
+	const float frequency = 6.0f;
+	mesh->beginUpdate();
+	ew::Vertex* vertices = mesh->getVertices();
+	size_t numVertices = sphere.vertices.size() < mesh->getMaxVertices() ? sphere.vertices.size() : mesh->getMaxVertices();
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		const ew::Vertex& source = sphere.vertices[i];
+		glm::vec3 direction = glm::normalize(source.pos);
+		float waveX = frequency * direction.x + time * 2.0f;
+		float waveY = frequency * direction.y + time * 1.3f;
+		float radius = 1.0f + blobAmplitude * sinf(waveX) * sinf(waveY);
+		//Gradient of the radius, minus its part along the direction. Steeper bumps tilt the normal further.
+		glm::vec3 gradient = blobAmplitude * frequency * glm::vec3(cosf(waveX) * sinf(waveY), sinf(waveX) * cosf(waveY), 0.0f);
+		gradient -= direction * glm::dot(direction, gradient);
+		vertices[i].pos = direction * radius;
+		vertices[i].normal = glm::normalize(direction - gradient / radius);
+		vertices[i].uv = source.uv;
+	}
+	//Topology never changes, but every segment needs its own copy of the indices
+	size_t numIndices = sphere.indices.size() < mesh->getMaxIndices() ? sphere.indices.size() : mesh->getMaxIndices();
+	memcpy(mesh->getIndices(), sphere.indices.data(), sizeof(unsigned int) * numIndices);
+	mesh->endUpdate((unsigned int)numVertices, (unsigned int)numIndices);
+}
@@ -11,14 +11,29 @@
 #include <ew/model.h>
 #include <ew/camera.h>
 #include <ew/transform.h>
+#include <ew/transformHierarchy.h>
+#include <ew/frustum.h>
+#include <ew/bvh.h>
+#include <ew/renderQueue.h>
+#include <ew/uniformBuffer.h>
+#include <ew/litShader.h>
+#include <ew/shaderReloader.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ew/textureLoader.h>
+#include <ew/texturePacker.h>
+#include <ew/cascadedShadows.h>
+#include <ew/shadowCache.h>
+#include <ew/glState.h>
 #include <ew/procGen.h>
+#include <ew/tangents.h>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
 void drawUI();
 void resetCamera(ew::Camera* camera, ew::CameraController* controller);
+void benchmarkRays(const ew::SceneBvh& sceneBvh);
+int drawShadowCasters(const ew::Shader& depthShader, ew::UniformHandle modelHandle, int cascade, bool drawStatic, bool drawDynamic);
 
 //Creating a camera for us to view our model
 ew::Camera camera;
@@ -34,15 +49,89 @@ float deltaTime;
 
 //ImGui Stuff
 glm::vec3 light;
-ew::Transform monkeyTransform;
+glm::vec3 monkeyPosition;
 float bias;
 
-struct Material {
-	float Ka = 1.0;
-	float Kd = 0.5;
-	float Ks = 0.5;
-	float Shininess = 128;
-}material;
+//Scene transforms. World matrices are rebuilt once per frame and shared by the shadow and lit passes.
+ew::TransformHierarchy sceneTransforms;
+int monkeyNode;
+int planeNode;
+
+//Frustum culling against the camera and the shadow light
+bool frustumCulling = true;
+ew::CullStats cameraCullStats;
+ew::CullStats lightCullStats;
+
+//Mouse picking against the scene BVH (left click)
+const char* pickedName = "None";
+float pickedDistance;
+int pickedTriangle = -1;
+bool runRayBenchmark = false;
+double singleRaysPerSecond;
+double packetRaysPerSecond;
+ew::BvhBuildStats monkeyBvhStats;
+//Tiles get a normal map, everything else a flat one. Needs the tangents generated for every mesh at load.
+bool normalMapping = true;
+ew::TangentStats monkeyTangentStats;
+
+//Batching comparison
+bool mergedDraw = false;
+int monkeyDrawCalls;
+float litSubmitMs; //CPU time to submit the lit pass, the same span with or without the render queue
+
+ew::MaterialUniforms material;
+
+//Sorted render queue vs drawing in scene order
+const int SHADOW_PASS = 0;
+const int LIT_PASS = 1;
+bool useRenderQueue = false;
+int numClutterObjects = 0; //Extra cubes and monkeys with alternating textures, to give the sort something to do
+ew::RenderQueueStats renderQueueStats;
+float sceneSubmitMs;
+ew::GLStateStats glStateStats; //Binds made by last frame's scene draws
+ew::UniformStats uniformStats; //Uniform calls made by last frame's scene draws
+
+//Startup cost of the depth program. Warm = linked from the program binary cache.
+ew::ProgramLoadStats depthLoadStats;
+//Lit shader variant in use. Toggling shadows switches variants, building the new one on first use.
+bool shadows = true;
+ew::ShaderVariantStats litVariantStats;
+int numLitVariants;
+bool glStateDebug = false;
+//Edit the shaders in the source tree's assets folders while running to reload them
+ew::ShaderReloadStats shaderReloadStats;
+int numWatchedShaders, numWatchedShaderFiles;
+bool shaderFileEvents;
+ew::TextureLoaderStats textureLoaderStats;
+int textureUploadBudgetKB = 8 * 1024;
+//Separate textures from the loader, or the same two packed into one texture array / atlas, so every material binds the same texture
+enum TexturePacking { TEXTURES_SEPARATE, TEXTURES_ARRAY, TEXTURES_ATLAS };
+int texturePacking = TEXTURES_SEPARATE;
+ew::TexturePackStats arrayPackStats;
+ew::TexturePackStats atlasPackStats;
+//Cascades fit to the camera every frame, or the single fixed map around the origin
+bool cascadedShadows = true;
+ew::CascadeSettings cascadeSettings;
+ew::CascadeStats cascadeStats;
+const int CASCADE_PASS = 2; //Passes CASCADE_PASS to CASCADE_PASS + SHADOW_MAX_CASCADES - 1, one per cascade
+//Static casters (plane and clutter) kept in a cache and only redrawn when the light or one of them moves. The monkey is drawn on top every frame.
+bool shadowCaching = true;
+ew::ShadowCacheStats shadowCacheStats;
+int shadowDraws; //Caster draws in last frame's shadow pass
+const int STATIC_SHADOW_PASS = CASCADE_PASS + ew::SHADOW_MAX_CASCADES; //Plus the cascade (or 0 for the fixed map), for static casters being cached
+
+struct SceneObject {
+	const ew::Mesh* mesh = nullptr; //Either mesh or model
+	ew::Model* model = nullptr;
+	const ew::RenderMaterial* material = nullptr;
+	glm::mat4 transform;
+	ew::AABB bounds; //World space
+	bool lightVisible = true;
+	unsigned int cascadeMask = 0; //Bit i set when it casts into cascade i
+	bool cameraVisible = true;
+	bool isStatic = true; //Never moves, so its shadow can be cached
+};
+std::vector<SceneObject> sceneObjects;
 
 int main() {
 	GLFWwindow* window = initWindow("Assignment 2", screenWidth, screenHeight);
@@ -51,19 +140,92 @@ int main() {
 	//Setting some global OpenGL variables
 	glEnable(GL_DEPTH_TEST);  //Depth testing
 
-	//Making a shader with the shader files in the assets folder
-	ew::Shader litShader = ew::Shader("assets/lit.vert", "assets/lit.frag");
+	//Declared first so it outlives every shader it watches
+	ew::ShaderReloader shaderReloader;
+	//Edits to the shaders in the source tree apply right away, without a rebuild to copy them
+	shaderReloader.addSourceDirectory(ASSETS_SOURCE_DIR);
+	//Shared lit shader from assets/ew, specialized for a point light with cascaded, single or no shadows
+	ew::ShaderVariants litVariants = ew::createLitShaderVariants();
+	const uint32_t litCascadeFeatures = ew::LIT_POINT_LIGHT | ew::LIT_CASCADED_SHADOWS;
+	const uint32_t litShadowFeatures = ew::LIT_POINT_LIGHT | ew::LIT_SHADOWS;
+	const uint32_t litNoShadowFeatures = ew::LIT_POINT_LIGHT;
+	//All build in parallel where the driver supports it. get() only waits for the one needed first.
+	litVariants.request(litCascadeFeatures);
+	litVariants.request(litShadowFeatures);
+	litVariants.request(litNoShadowFeatures);
 	ew::Shader depthShader = ew::Shader("assets/depth.vert", "assets/depth.frag");
+	depthLoadStats = depthShader.getLoadStats();
+	shaderReloader.watch(&litVariants);
+	shaderReloader.watch(&depthShader, "assets/depth.vert", "assets/depth.frag");
+	const ew::Shader* samplersSetFor = nullptr;
 	//Loading a 3D model for us to render
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
-	ew::Mesh planeMesh(ew::createPlane(5.0f, 5.0f, 10.0f));
+	ew::ModelOptions monkeyOptions;
+	monkeyOptions.buildBvh = true;
+	monkeyOptions.generateTangents = true;
+	ew::Model monkeyModel = ew::Model("assets/suzanne.obj", monkeyOptions);
+	monkeyTangentStats = monkeyModel.getTangentStats();
+	//Same model with all submeshes packed into one buffer, drawn with glMultiDrawElementsIndirect
+	ew::ModelOptions mergedOptions;
+	mergedOptions.mergeMeshes = true;
+	mergedOptions.generateTangents = true;
+	ew::Model monkeyModelMerged = ew::Model("assets/suzanne.obj", mergedOptions);
+	ew::MeshData planeMeshData = ew::createPlane(5.0f, 5.0f, 10.0f);
+	ew::generateTangents(&planeMeshData);
+	ew::Mesh planeMesh(planeMeshData);
+	ew::MeshData cubeMeshData = ew::createCube(0.4f);
+	ew::generateTangents(&cubeMeshData);
+	ew::Mesh cubeMesh(cubeMeshData);
+	ew::RenderQueue renderQueue;
+	ew::MeshBvh planeBvh(planeMeshData);
+	//Top level over both objects, rebuilt every frame since the monkey moves
+	ew::SceneBvh sceneBvh;
+	std::vector<ew::BvhInstance> bvhInstances(2);
+	bvhInstances[0].bvh = &planeBvh;
+	bvhInstances[1].bvh = &monkeyModel.getBvh();
+	const char* instanceNames[2] = { "Plane", "Monkey" };
+	monkeyBvhStats = monkeyModel.getBvhBuildStats();
 	ew::Transform planeTransform;
 	planeTransform.position = glm::vec3(0, -2.0, 0);
-
-
-	//Handles to OpenGL object are unsigned integers
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
-	GLuint tileTexture = ew::loadTexture("assets/Tiles.png");
+	planeNode = sceneTransforms.add(planeTransform);
+	monkeyNode = sceneTransforms.add(ew::Transform());
+	glm::quat monkeyRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+
+	//Decoded on worker threads and streamed in over a few frames. Materials show a grey placeholder until then.
+	ew::TextureLoader textureLoader;
+	ew::TextureHandle brickTexture = textureLoader.load("assets/brick_color.jpg");
+	ew::TextureHandle tileTexture = textureLoader.load("assets/Tiles.png");
+	//_MainTex samples unit 1
+	ew::UniformBuffer tileMaterialBuffer(sizeof(ew::MaterialUniforms));
+	ew::RenderMaterial tileMaterial;
+	tileMaterial.uniformBuffer = &tileMaterialBuffer;
+	ew::UniformBuffer brickMaterialBuffer(sizeof(ew::MaterialUniforms));
+	ew::RenderMaterial brickMaterial;
+	brickMaterial.uniformBuffer = &brickMaterialBuffer;
+	//_NormalMap samples unit 3. Loaded up front, since the loader's grey placeholder isn't a valid normal.
+	//Built from the displacement map rather than shipping a second image
+	tileMaterial.textures[3] = ew::loadNormalMapFromHeight("assets/Tiles131_2K-JPG_Displacement.jpg", 0.02f);
+	unsigned int flatNormalMap;
+	glCreateTextures(GL_TEXTURE_2D, 1, &flatNormalMap);
+	glTextureStorage2D(flatNormalMap, 1, GL_RG8, 1, 1);
+	const unsigned char flatNormal[2] = { 128, 128 };
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(flatNormalMap, 0, 0, 0, 1, 1, GL_RG, GL_UNSIGNED_BYTE, flatNormal);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	brickMaterial.textures[3] = flatNormalMap;
+	//Both packings are built the first time they're picked. Indices match the add() order: tiles 0, brick 1.
+	ew::TexturePackOptions arrayPackOptions;
+	arrayPackOptions.mode = ew::TEXTURE_PACK_ARRAY;
+	ew::TexturePacker arrayPacker(arrayPackOptions);
+	ew::TexturePackOptions atlasPackOptions;
+	atlasPackOptions.mode = ew::TEXTURE_PACK_ATLAS;
+	ew::TexturePacker atlasPacker(atlasPackOptions);
+	ew::UniformBuffer frameBuffer(sizeof(ew::FrameUniforms));
+	ew::CascadedShadowMap cascadedShadowMap(cascadeSettings);
+	ew::UniformBuffer shadowBuffer(sizeof(ew::CascadeUniforms));
+	ew::ShadowCache cascadeCache;
+	ew::ShadowCache fixedCache;
+	ew::UniformHandle depthModelHandle = depthShader.getUniformHandle("model");
 
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
 	camera.target = glm::vec3(0.0f, 0.0f, 0.0f);  //Look at the center of the scene
@@ -79,7 +241,8 @@ int main() {
 	//2D texture to be used as framebuffer's depth buffer
 	glGenTextures(1, &depthMap);
 	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	//Same format as the shadow cache, so the cache can be copied into it
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -95,6 +258,7 @@ int main() {
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	fixedCache.setSize(SHADOW_WIDTH, SHADOW_HEIGHT, 1);
 
 	light = glm::vec3(0.25f, 3.0f, -0.5f);
 	bias = 0.005f;
@@ -105,6 +269,43 @@ int main() {
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		ew::resetGLStateStats();
+		ew::resetUniformStats();
+		ew::setGLStateDebug(glStateDebug);
+		//Before any draws, so a swapped program is used for the whole frame
+		shaderReloader.update();
+		shaderReloadStats = shaderReloader.getStats();
+		numWatchedShaders = (int)shaderReloader.getNumWatchedShaders();
+		numWatchedShaderFiles = (int)shaderReloader.getNumWatchedFiles();
+		shaderFileEvents = shaderReloader.isUsingFileEvents();
+		textureLoader.setUploadBudget((size_t)textureUploadBudgetKB * 1024);
+		textureLoader.update();
+		textureLoaderStats = textureLoader.getStats();
+		//Both materials take the UI's settings, plus where their texture is when packed
+		ew::MaterialUniforms tileUniforms = material;
+		ew::MaterialUniforms brickUniforms = material;
+		if (texturePacking == TEXTURES_SEPARATE) {
+			tileMaterial.textures[1] = textureLoader.get(tileTexture);
+			brickMaterial.textures[1] = textureLoader.get(brickTexture);
+		}
+		else {
+			ew::TexturePacker& packer = texturePacking == TEXTURES_ARRAY ? arrayPacker : atlasPacker;
+			if (packer.getNumTextures() == 0) {
+				packer.add("assets/Tiles.png");
+				packer.add("assets/brick_color.jpg");
+				packer.pack();
+			}
+			const ew::PackedTexture& tilePacked = packer.get(0);
+			const ew::PackedTexture& brickPacked = packer.get(1);
+			tileMaterial.textures[1] = tilePacked.texture;
+			tileUniforms.MainTexLayer = (float)tilePacked.layer;
+			tileUniforms.MainTexRect = tilePacked.uvRect;
+			brickMaterial.textures[1] = brickPacked.texture;
+			brickUniforms.MainTexLayer = (float)brickPacked.layer;
+			brickUniforms.MainTexRect = brickPacked.uvRect;
+		}
+		arrayPackStats = arrayPacker.getStats();
+		atlasPackStats = atlasPacker.getStats();
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
@@ -112,29 +313,267 @@ int main() {
 
 		cameraController.move(window, &camera, deltaTime);
 
+		//Rotate monkey model around Y axis. Both passes used to apply deltaTime each, so spin at the same total rate.
+		monkeyRotation = glm::rotate(monkeyRotation, deltaTime * 2.0f, glm::vec3(0.0, 1.0, 0.0));
+		sceneTransforms.setRotation(monkeyNode, monkeyRotation);
+		sceneTransforms.setPosition(monkeyNode, monkeyPosition);
+		sceneTransforms.update();
+
+		bvhInstances[0].transform = sceneTransforms.getWorldMatrix(planeNode);
+		bvhInstances[1].transform = sceneTransforms.getWorldMatrix(monkeyNode);
+		sceneBvh.build(bvhInstances);
+		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1) && !ImGui::GetIO().WantCaptureMouse) {
+			double mouseX, mouseY;
+			glfwGetCursorPos(window, &mouseX, &mouseY);
+			ew::Ray ray = ew::cameraRay(camera, (float)(mouseX / screenWidth) * 2.0f - 1.0f, 1.0f - (float)(mouseY / screenHeight) * 2.0f);
+			ew::RayHit hit;
+			if (sceneBvh.intersect(ray, &hit)) {
+				pickedName = instanceNames[hit.instance];
+				pickedDistance = hit.t;
+				pickedTriangle = hit.triangle;
+			}
+			else {
+				pickedName = "None";
+				pickedTriangle = -1;
+			}
+		}
+		if (runRayBenchmark) {
+			benchmarkRays(sceneBvh);
+			runRayBenchmark = false;
+		}
+
 		//Create a view matrix to transform each object so they're visible from the light's pov
 		glm::mat4 lightView = glm::lookAt(light, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
 		glm::mat4 lightSpaceMatrix = lightProjection * lightView;
+		bool useCascades = shadows && cascadedShadows;
+		if (useCascades) {
+			//Only reallocates when the resolution or count changed. Light direction is from the light towards the origin, as above.
+			cascadedShadowMap.setSettings(cascadeSettings);
+			cascadedShadowMap.update(camera, -light);
+			cascadeStats = cascadedShadowMap.getStats();
+		}
+
+		ew::Model& activeMonkey = mergedDraw ? monkeyModelMerged : monkeyModel;
+		const ew::RenderMaterial* materials[2] = { &tileMaterial, &brickMaterial };
+		tileMaterialBuffer.update(&tileUniforms, sizeof(ew::MaterialUniforms));
+		brickMaterialBuffer.update(&brickUniforms, sizeof(ew::MaterialUniforms));
+
+		uint32_t litFeatures = useCascades ? litCascadeFeatures : shadows ? litShadowFeatures : litNoShadowFeatures;
+		if (texturePacking == TEXTURES_ARRAY) {
+			litFeatures |= ew::LIT_TEXTURE_ARRAY;
+		}
+		if (normalMapping) {
+			litFeatures |= ew::LIT_NORMAL_MAP;
+		}
+		const ew::Shader& litShader = litVariants.get(litFeatures);
+		if (samplersSetFor != &litShader) {
+			//Samplers never change, so each variant gets them once instead of every frame
+			litShader.use();
+			litShader.setInt("_MainTex", 1);
+			litShader.setInt("_ShadowMap", 2);
+			litShader.setInt("_NormalMap", 3);
+			samplersSetFor = &litShader;
+		}
+		ew::UniformHandle litModelHandle = litShader.getUniformHandle("_Model");
+		litVariantStats = litVariants.getStats();
+		numLitVariants = (int)litVariants.getNumVariants();
+
+		//Scene order: plane, monkey, then the clutter grid
+		sceneObjects.resize(2 + numClutterObjects);
+		sceneObjects[0].mesh = &planeMesh;
+		sceneObjects[0].material = &tileMaterial;
+		sceneObjects[0].transform = sceneTransforms.getWorldMatrix(planeNode);
+		sceneObjects[1].model = &activeMonkey;
+		sceneObjects[1].material = &brickMaterial;
+		sceneObjects[1].transform = sceneTransforms.getWorldMatrix(monkeyNode);
+		sceneObjects[1].isStatic = false;
+		//Mesh and material both alternate, so drawing in this order changes state on nearly every draw
+		int clutterColumns = (int)ceilf(sqrtf((float)numClutterObjects));
+		for (int i = 0; i < numClutterObjects; i++)
+		{
+			SceneObject& object = sceneObjects[2 + i];
+			bool isCube = (i % 2) == 0;
+			object.mesh = isCube ? &cubeMesh : nullptr;
+			object.model = isCube ? nullptr : &activeMonkey;
+			object.material = materials[(i / 2) % 2];
+			glm::vec3 position = glm::vec3((i % clutterColumns) - clutterColumns * 0.5f, -1.7f, (i / clutterColumns) - clutterColumns * 0.5f) * glm::vec3(0.8f, 1.0f, 0.8f);
+			object.transform = glm::translate(glm::mat4(1.0f), position) * glm::scale(glm::mat4(1.0f), glm::vec3(isCube ? 1.0f : 0.3f));
+		}
+
+		ew::CullBounds sceneBounds;
+		for (size_t i = 0; i < sceneObjects.size(); i++)
+		{
+			SceneObject& object = sceneObjects[i];
+			object.bounds = ew::transformAABB(object.mesh ? object.mesh->getBounds() : object.model->getBounds(), object.transform);
+			object.lightVisible = object.cameraVisible = !frustumCulling;
+			object.cascadeMask = frustumCulling ? 0 : (1u << cascadedShadowMap.getNumCascades()) - 1;
+			sceneBounds.add(object.bounds);
+		}
+		if (frustumCulling) {
+			std::vector<int> visibleIndices;
+			if (useCascades) {
+				for (int c = 0; c < cascadedShadowMap.getNumCascades(); c++)
+				{
+					cascadedShadowMap.cullCasters(c, sceneBounds, &visibleIndices);
+					for (size_t i = 0; i < visibleIndices.size(); i++)
+					{
+						sceneObjects[visibleIndices[i]].cascadeMask |= 1u << c;
+					}
+				}
+				cascadeStats = cascadedShadowMap.getStats();
+			}
+			else {
+				ew::frustumCull(ew::extractFrustum(lightSpaceMatrix), sceneBounds, ew::CullShape::AABB, &visibleIndices, &lightCullStats);
+				for (size_t i = 0; i < visibleIndices.size(); i++)
+				{
+					sceneObjects[visibleIndices[i]].lightVisible = true;
+				}
+			}
+			ew::frustumCull(ew::extractFrustum(camera.projectionMatrix() * camera.viewMatrix()), sceneBounds, ew::CullShape::AABB, &visibleIndices, &cameraCullStats);
+			for (size_t i = 0; i < visibleIndices.size(); i++)
+			{
+				sceneObjects[visibleIndices[i]].cameraVisible = true;
+			}
+		}
+
+		//Shadow layers (cascades, or the fixed map as layer 0) whose static casters are redrawn this frame. The rest come from the cache.
+		bool cacheShadows = shadows && shadowCaching;
+		int numShadowLayers = useCascades ? cascadedShadowMap.getNumCascades() : 1;
+		ew::ShadowCache& shadowCache = useCascades ? cascadeCache : fixedCache;
+		bool refreshStatic[ew::SHADOW_MAX_CASCADES] = {};
+		if (cacheShadows) {
+			if (useCascades) {
+				int resolution = cascadedShadowMap.getSettings().resolution;
+				cascadeCache.setSize(resolution, resolution, numShadowLayers);
+			}
+			shadowCache.beginFrame();
+			for (size_t i = 0; i < sceneObjects.size(); i++)
+			{
+				const SceneObject& object = sceneObjects[i];
+				if (object.isStatic) {
+					shadowCache.addStaticCaster(object.transform, object.mesh ? (const void*)object.mesh : (const void*)object.model);
+				}
+			}
+			for (int layer = 0; layer < numShadowLayers; layer++)
+			{
+				int staticDraws = 0;
+				for (size_t i = 0; i < sceneObjects.size(); i++)
+				{
+					const SceneObject& object = sceneObjects[i];
+					bool casts = useCascades ? (object.cascadeMask & (1u << layer)) != 0 : object.lightVisible;
+					staticDraws += object.isStatic && casts;
+				}
+				glm::mat4 layerMatrix = useCascades ? cascadedShadowMap.getLightMatrix(layer) : lightSpaceMatrix;
+				refreshStatic[layer] = shadowCache.needsRefresh(layer, layerMatrix, staticDraws);
+			}
+			shadowCacheStats = shadowCache.getStats();
+		}
+
+		//CPU time to submit both passes (not GPU time)
+		double sceneSubmitStart = glfwGetTime();
+		shadowDraws = 0;
+		if (useRenderQueue) {
+			renderQueue.clear();
+			for (size_t i = 0; i < sceneObjects.size(); i++)
+			{
+				const SceneObject& object = sceneObjects[i];
+				ew::DrawPacket packet;
+				packet.mesh = object.mesh;
+				packet.model = object.model;
+				packet.transform = object.transform;
+				for (int layer = 0; layer < numShadowLayers && shadows; layer++)
+				{
+					bool casts = useCascades ? (object.cascadeMask & (1u << layer)) != 0 : object.lightVisible;
+					if (!casts) {
+						continue;
+					}
+					packet.shader = &depthShader;
+					packet.pass = useCascades ? CASCADE_PASS + layer : SHADOW_PASS;
+					if (cacheShadows && object.isStatic) {
+						//Into the cache, if it's being redrawn
+						if (!refreshStatic[layer]) {
+							continue;
+						}
+						packet.pass = STATIC_SHADOW_PASS + layer;
+					}
+					renderQueue.submit(packet);
+					shadowDraws++;
+				}
+				if (object.cameraVisible) {
+					packet.shader = &litShader;
+					packet.material = object.material;
+					packet.pass = LIT_PASS;
+					//Front to back within each state group
+					packet.depth = glm::length(glm::vec3(object.transform[3]) - camera.position);
+					renderQueue.submit(packet);
+				}
+			}
+			renderQueue.sort();
+		}
 
 		//Render scene from light's pov
 		depthShader.use();
-		depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-		glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-		glClear(GL_DEPTH_BUFFER_BIT);
-
 		glCullFace(GL_FRONT);
 
-		depthShader.setMat4("model", planeTransform.modelMatrix());
-		planeMesh.draw();
-
-		//Rotate monkey model around Y axis
-		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
-
-		depthShader.setMat4("model", monkeyTransform.modelMatrix());
-		monkeyModel.draw();
+		if (useCascades) {
+			//Each cascade's casters into its own layer
+			for (int c = 0; c < cascadedShadowMap.getNumCascades(); c++)
+			{
+				depthShader.setMat4("lightSpaceMatrix", cascadedShadowMap.getLightMatrix(c));
+				//Not cleared when the cache fills it
+				cascadedShadowMap.beginCascade(c, !cacheShadows);
+				if (cacheShadows) {
+					if (refreshStatic[c]) {
+						//Depth clamp from beginCascade is still on
+						cascadeCache.beginStatic(c);
+						if (useRenderQueue) {
+							renderQueue.execute(STATIC_SHADOW_PASS + c, "model");
+						}
+						else {
+							shadowDraws += drawShadowCasters(depthShader, depthModelHandle, c, true, false);
+						}
+						cascadedShadowMap.beginCascade(c, false);
+					}
+					cascadeCache.restore(c, cascadedShadowMap.getDepthTexture(), GL_TEXTURE_2D_ARRAY);
+				}
+				if (useRenderQueue) {
+					renderQueue.execute(CASCADE_PASS + c, "model");
+				}
+				else {
+					shadowDraws += drawShadowCasters(depthShader, depthModelHandle, c, !cacheShadows, true);
+				}
+			}
+			cascadedShadowMap.end();
+		}
+		else {
+			depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+			if (cacheShadows && refreshStatic[0]) {
+				fixedCache.beginStatic(0);
+				if (useRenderQueue) {
+					renderQueue.execute(STATIC_SHADOW_PASS, "model");
+				}
+				else {
+					shadowDraws += drawShadowCasters(depthShader, depthModelHandle, -1, true, false);
+				}
+			}
+
+			glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+			glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+			if (cacheShadows) {
+				fixedCache.restore(0, depthMap, GL_TEXTURE_2D);
+			}
+			else {
+				glClear(GL_DEPTH_BUFFER_BIT);
+			}
+
+			if (useRenderQueue) {
+				renderQueue.execute(SHADOW_PASS, "model");
+			}
+			else if (shadows) {
+				shadowDraws += drawShadowCasters(depthShader, depthModelHandle, -1, !cacheShadows, true);
+			}
+		}
 
 		glCullFace(GL_BACK);
 
@@ -147,37 +586,65 @@ int main() {
 		//Clears backbuffer color and depth values
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		//Binding textures
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tileTexture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, brickTexture);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, depthMap);
+		//Binding textures. Color textures come from each object's material.
+		if (useCascades) {
+			ew::bindTextureUnit(2, cascadedShadowMap.getDepthTexture());
+			ew::CascadeUniforms cascadeUniforms;
+			cascadedShadowMap.getUniforms(&cascadeUniforms);
+			shadowBuffer.update(&cascadeUniforms, sizeof(ew::CascadeUniforms));
+			shadowBuffer.bind(ew::UNIFORM_BLOCK_SHADOWS);
+		}
+		else {
+			ew::bindTextureUnit(2, depthMap);
+		}
+
+		//One upload for everything the lit shaders share this frame
+		ew::FrameUniforms frameUniforms;
+		frameUniforms.viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+		frameUniforms.lightSpaceMatrix = lightSpaceMatrix;
+		frameUniforms.eyePos = camera.position;
+		frameUniforms.bias = bias;
+		frameUniforms.lightPos = light;
+		frameBuffer.update(&frameUniforms, sizeof(ew::FrameUniforms));
+		frameBuffer.bind(ew::UNIFORM_BLOCK_FRAME);
 
-		//Set shader uniforms and draw
 		litShader.use();
-		litShader.setVec3("_EyePos", camera.position);
-		litShader.setVec3("_LightPos", light);
-		//Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
-		litShader.setInt("_MainTex", 1);
-		litShader.setInt("_ShadowMap", 2);
-		//transform.modelMatrix() combines translation, rotation, and scale into a 4x4 model matrix
-		litShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		litShader.setMat4("_LightSpaceMatrix", lightSpaceMatrix);
-		litShader.setFloat("_Material.Ka", material.Ka);
-		litShader.setFloat("_Material.Kd", material.Kd);
-		litShader.setFloat("_Material.Ks", material.Ks);
-		litShader.setFloat("_Material.Shininess", material.Shininess);
-		litShader.setFloat("_Bias", bias);
-
-		litShader.setMat4("_Model", planeTransform.modelMatrix());
-		planeMesh.draw();
-
-		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
-
-		litShader.setMat4("_Model", monkeyTransform.modelMatrix());
-		monkeyModel.draw();  //Draws monkey model using current shader
+
+		double litSubmitStart = glfwGetTime();
+		if (useRenderQueue) {
+			renderQueue.execute(LIT_PASS, "_Model");
+			renderQueueStats = renderQueue.getStats();
+		}
+		else {
+			//Scene order, only rebinding when the material changes
+			const ew::RenderMaterial* boundMaterial = nullptr;
+			for (size_t i = 0; i < sceneObjects.size(); i++)
+			{
+				const SceneObject& object = sceneObjects[i];
+				if (!object.cameraVisible) {
+					continue;
+				}
+				if (object.material != boundMaterial) {
+					boundMaterial = object.material;
+					ew::bindTextureUnit(1, boundMaterial->textures[1]);
+					ew::bindTextureUnit(3, boundMaterial->textures[3]);
+					boundMaterial->uniformBuffer->bind(ew::UNIFORM_BLOCK_MATERIAL);
+				}
+				litShader.setMat4(litModelHandle, object.transform);
+				if (object.mesh) {
+					object.mesh->draw();
+				}
+				else {
+					object.model->draw();
+				}
+			}
+		}
+		litSubmitMs = (float)((glfwGetTime() - litSubmitStart) * 1000.0);
+		sceneSubmitMs = (float)((glfwGetTime() - sceneSubmitStart) * 1000.0);
+		monkeyDrawCalls = activeMonkey.getNumDrawCalls();
+
+		glStateStats = ew::getGLStateStats();
+		uniformStats = ew::getUniformStats();
 
 		drawUI();
 
@@ -200,9 +667,9 @@ void drawUI() {
 		ImGui::SliderFloat("Light Y", &light.y, 0.0f, 10.0f);
 		ImGui::SliderFloat("Light Z", &light.z, -1.0f, 1.0f);
 	}
-	ImGui::SliderFloat("Monkey X", &monkeyTransform.position.x, -5.0f, 5.0f);
-	ImGui::SliderFloat("Monkey Y", &monkeyTransform.position.y, -5.0f, 5.0f);
-	ImGui::SliderFloat("Monkey Z", &monkeyTransform.position.z, -5.0f, 5.0f);
+	ImGui::SliderFloat("Monkey X", &monkeyPosition.x, -5.0f, 5.0f);
+	ImGui::SliderFloat("Monkey Y", &monkeyPosition.y, -5.0f, 5.0f);
+	ImGui::SliderFloat("Monkey Z", &monkeyPosition.z, -5.0f, 5.0f);
 
 	ImGui::SliderFloat("Bias", &bias, 0.0f, 0.5f);
 
@@ -214,6 +681,130 @@ void drawUI() {
 		ImGui::SliderFloat("DiffuseK", &material.Kd, 0.0f, 1.0f);
 		ImGui::SliderFloat("SpecularK", &material.Ks, 0.0f, 1.0f);
 		ImGui::SliderFloat("Shininess", &material.Shininess, 2.0f, 1024.0f);
+		ImGui::Checkbox("Normal mapping", &normalMapping);
+		ImGui::Text("Monkey tangents: %zu triangles, %.2f M triangles/s", monkeyTangentStats.triangles, monkeyTangentStats.trianglesPerSecond() / 1000000.0);
+		ImGui::Text("Split vertices: %zu", monkeyTangentStats.splitVertices);
+	}
+	if (ImGui::CollapsingHeader("Batching")) {
+		ImGui::Checkbox("Merged multi-draw", &mergedDraw);
+		ImGui::Text("Monkey draw calls: %d", monkeyDrawCalls);
+		ImGui::Text("Lit pass CPU submit: %.4f ms", litSubmitMs);
+	}
+	if (ImGui::CollapsingHeader("Render Queue")) {
+		ImGui::Checkbox("Sorted render queue", &useRenderQueue);
+		ImGui::SliderInt("Clutter objects", &numClutterObjects, 0, 2000);
+		//Both include the shadow passes. The queue's also includes building and sorting the packets.
+		ImGui::Text("Scene CPU submit: %.3f ms", sceneSubmitMs);
+		ImGui::Text("Lit pass CPU submit: %.3f ms", litSubmitMs);
+		if (useRenderQueue) {
+			const ew::RenderQueueStats& stats = renderQueueStats;
+			ImGui::Text("Packets: %d, sort %.3f ms", stats.packets, stats.sortMs);
+			ImGui::Text("               sorted / scene order");
+			ImGui::Text("Program changes: %d / %d", stats.programChanges, stats.unsortedProgramChanges);
+			ImGui::Text("Texture binds:   %d / %d", stats.textureBinds, stats.unsortedTextureBinds);
+			ImGui::Text("Mesh changes:    %d / %d", stats.meshChanges, stats.unsortedMeshChanges);
+		}
+	}
+	if (ImGui::CollapsingHeader("GL State")) {
+		ImGui::Checkbox("Verify against glGet (slow)", &glStateDebug);
+		ImGui::Text("            issued / elided");
+		ImGui::Text("Programs:      %d / %d", glStateStats.programsIssued, glStateStats.programsElided);
+		ImGui::Text("Vertex arrays: %d / %d", glStateStats.vertexArraysIssued, glStateStats.vertexArraysElided);
+		ImGui::Text("Textures:      %d / %d", glStateStats.texturesIssued, glStateStats.texturesElided);
+		ImGui::Text("Desyncs: %d", glStateStats.desyncs);
+		ImGui::Text("Uniform calls: %d", uniformStats.uniformCalls);
+		ImGui::Text("Uniform location queries: %d", uniformStats.locationQueries);
+	}
+	if (ImGui::CollapsingHeader("Shaders")) {
+		ImGui::Checkbox("Shadows", &shadows);
+		ImGui::Text("depth: %.2f ms (%s%s)", depthLoadStats.milliseconds, depthLoadStats.fromCache ? "warm" : "cold", depthLoadStats.binaryRejected ? ", cached binary rejected" : "");
+		ImGui::Text("lit variants: %d (%d compiled, %d from cache, %d failed)", numLitVariants, litVariantStats.compiled, litVariantStats.fromCache, litVariantStats.failed);
+		ImGui::Text("Variant hits: %d, misses: %d, blocked %.2f ms", litVariantStats.hits, litVariantStats.misses, litVariantStats.blockedMs);
+		ImGui::Text("Parallel compile: %s", ew::isParallelShaderCompileSupported() ? "yes" : "no");
+		ImGui::Text("Hot reload: %d programs, %d files (%s)", numWatchedShaders, numWatchedShaderFiles, shaderFileEvents ? "inotify" : "polling");
+		ImGui::Text("Reloads: %d, failed: %d, compiling: %d", shaderReloadStats.reloads, shaderReloadStats.failures, shaderReloadStats.compiling);
+		ImGui::Text("Save to swap: %.1f ms (max %.1f ms)", shaderReloadStats.lastLatencyMs, shaderReloadStats.maxLatencyMs);
+		ImGui::Text("Reload update: %.3f ms", shaderReloadStats.lastUpdateMs);
+		if (!shaderReloadStats.lastError.empty()) {
+			ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", shaderReloadStats.lastErrorFile.c_str());
+			ImGui::TextWrapped("%s", shaderReloadStats.lastError.c_str());
+		}
+	}
+	if (ImGui::CollapsingHeader("Textures")) {
+		ImGui::SliderInt("Upload budget (KB/frame)", &textureUploadBudgetKB, 64, 32 * 1024);
+		ImGui::Text("Ready: %d / %d (%d failed)", textureLoaderStats.ready, textureLoaderStats.requested, textureLoaderStats.failed);
+		ImGui::Text("Decode: %.2f ms total on workers", textureLoaderStats.decodeMs);
+		ImGui::Text("Uploaded: %zu KB in %d calls, %d PBO stalls", textureLoaderStats.bytesUploaded / 1024, textureLoaderStats.uploads, textureLoaderStats.pboStalls);
+		ImGui::Text("Loader update: %.3f ms", textureLoaderStats.updateMs);
+		const char* packingNames[3] = { "Separate textures", "Texture array", "Atlas" };
+		ImGui::Combo("Packing", &texturePacking, packingNames, 3);
+		//Compare with the render queue on and off, and with clutter objects alternating materials
+		ImGui::Text("Texture binds: %d issued, %d elided", glStateStats.texturesIssued, glStateStats.texturesElided);
+		if (useRenderQueue) {
+			ImGui::Text("Queue texture binds: %d sorted / %d scene order", renderQueueStats.textureBinds, renderQueueStats.unsortedTextureBinds);
+		}
+		if (arrayPackStats.arrays > 0) {
+			ImGui::Text("Array: %d layers in %d arrays, %zu KB, %.1f ms", arrayPackStats.layers, arrayPackStats.arrays, arrayPackStats.bytes / 1024, arrayPackStats.packMs);
+		}
+		if (atlasPackStats.atlases > 0) {
+			ImGui::Text("Atlas: %d textures in %d atlases, %.1f%% occupied, %zu KB, %.1f ms", atlasPackStats.textures - atlasPackStats.failed, atlasPackStats.atlases,
+				atlasPackStats.atlasOccupancy() * 100.0f, atlasPackStats.bytes / 1024, atlasPackStats.packMs);
+		}
+	}
+	if (ImGui::CollapsingHeader("Cascaded Shadows")) {
+		ImGui::Checkbox("Cascades (off = one fixed map)", &cascadedShadows);
+		ImGui::SliderInt("Cascades", &cascadeSettings.numCascades, 2, ew::SHADOW_MAX_CASCADES);
+		const char* resolutionNames[3] = { "1024", "2048", "4096" };
+		int resolutionIndex = cascadeSettings.resolution >= 4096 ? 2 : cascadeSettings.resolution >= 2048 ? 1 : 0;
+		if (ImGui::Combo("Resolution", &resolutionIndex, resolutionNames, 3)) {
+			cascadeSettings.resolution = 1024 << resolutionIndex;
+		}
+		ImGui::SliderFloat("Max distance", &cascadeSettings.maxDistance, 5.0f, 100.0f);
+		ImGui::SliderFloat("Split lambda", &cascadeSettings.splitLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Bias (texels)", &cascadeSettings.biasTexels, 0.0f, 5.0f);
+		ImGui::Checkbox("Stable fit (off = tight)", &cascadeSettings.stableFit);
+		ImGui::Text("Refits: %d", cascadeStats.refits);
+		//Casters are only counted with frustum culling on. Otherwise every object is drawn into every cascade.
+		for (int i = 0; i < cascadeStats.numCascades; i++)
+		{
+			ImGui::Text("%d: to %.2f, texel %.4f, %.1f%% used, %d casters", i, cascadeStats.splitDistances[i], cascadeStats.texelSize[i],
+				cascadeStats.utilization[i] * 100.0f, frustumCulling ? cascadeStats.casters[i] : (int)sceneObjects.size());
+		}
+	}
+	if (ImGui::CollapsingHeader("Shadow Cache")) {
+		ImGui::Checkbox("Cache static casters", &shadowCaching);
+		ImGui::Text("Shadow draws: %d", shadowDraws);
+		if (shadowCaching) {
+			ImGui::Text("Draws saved: %d", shadowCacheStats.drawsSaved);
+			ImGui::Text("Layers: %d redrawn, %d cached", shadowCacheStats.refreshes, shadowCacheStats.hits);
+			ImGui::Text("Total redraws: %d, %d from static changes", shadowCacheStats.totalRefreshes, shadowCacheStats.invalidations);
+			ImGui::Text("Cache: %zu KB", shadowCacheStats.bytes / 1024);
+		}
+	}
+	if (ImGui::CollapsingHeader("Transforms")) {
+		const ew::TransformHierarchyStats& stats = sceneTransforms.getStats();
+		ImGui::Text("World matrices recomputed: %d", stats.recomputed);
+		ImGui::Text("World matrices reused: %d", stats.reused);
+	}
+	if (ImGui::CollapsingHeader("Culling")) {
+		ImGui::Checkbox("Frustum culling", &frustumCulling);
+		ImGui::Text("Camera: %d visible / %d tested", cameraCullStats.visible, cameraCullStats.tested);
+		if (!cascadedShadows) {
+			ImGui::Text("Light: %d visible / %d tested", lightCullStats.visible, lightCullStats.tested);
+		}
+	}
+	if (ImGui::CollapsingHeader("Picking")) {
+		ImGui::Text("Left click to pick");
+		ImGui::Text("Picked: %s", pickedName);
+		if (pickedTriangle >= 0) {
+			ImGui::Text("Distance: %.3f, triangle %d", pickedDistance, pickedTriangle);
+		}
+		if (ImGui::Button("Run ray benchmark")) {
+			runRayBenchmark = true;
+		}
+		ImGui::Text("Single rays: %.2f M/s", singleRaysPerSecond / 1000000.0);
+		ImGui::Text("4-ray packets: %.2f M/s", packetRaysPerSecond / 1000000.0);
+		ImGui::Text("Monkey BVH: %zu triangles, %zu nodes, %.2f ms", monkeyBvhStats.numPrimitives, monkeyBvhStats.numNodes, monkeyBvhStats.buildSeconds * 1000.0);
 	}
 	ImGui::End();
 
@@ -223,8 +814,13 @@ void drawUI() {
 	//Stretch image to be window size
 	ImVec2 windowSize = ImGui::GetWindowSize();
 	//Invert 0-1 V to flip vertically for ImGui display
-	//shadowMap is the texture2D handle
-	ImGui::Image((ImTextureID)depthMap,  windowSize, ImVec2(0, 1), ImVec2(1,0));
+	//shadowMap is the texture2D handle. Only the fixed map, since ImGui can't show array layers.
+	if (cascadedShadows) {
+		ImGui::Text("Showing the fixed map only. Turn off cascades to see it.");
+	}
+	else {
+		ImGui::Image((ImTextureID)depthMap, windowSize, ImVec2(0, 1), ImVec2(1, 0));
+	}
 	ImGui::EndChild();
 	ImGui::End();
 
@@ -264,6 +860,7 @@ GLFWwindow* initWindow(const char* title, int width, int height) {
 		printf("GLAD Failed to load GL headers");
 		return nullptr;
 	}
+	ew::initParallelShaderCompile(glfwGetProcAddress);
 
 	//Initialize ImGUI
 	IMGUI_CHECKVERSION();
@@ -279,4 +876,66 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller)
 	camera->position = glm::vec3(0, 0, 5.0f);
 	camera->target = glm::vec3(0);
 	controller->yaw = controller->pitch = 0;
-}
\ No newline at end of file
+}
+
+/// <summary>
+/// Draws the casters of one shadow layer with the depth shader, which must be in use with its light matrix set
+/// </summary>
+/// <param name="cascade">Cascade to draw the casters of, or -1 for the fixed map</param>
+/// <returns>Number of objects drawn</returns>
+int drawShadowCasters(const ew::Shader& depthShader, ew::UniformHandle modelHandle, int cascade, bool drawStatic, bool drawDynamic)
+{
+	int draws = 0;
+	for (size_t i = 0; i < sceneObjects.size(); i++)
+	{
+		const SceneObject& object = sceneObjects[i];
+		bool casts = cascade >= 0 ? (object.cascadeMask & (1u << cascade)) != 0 : object.lightVisible;
+		if (!casts || !(object.isStatic ? drawStatic : drawDynamic)) {
+			continue;
+		}
+		depthShader.setMat4(modelHandle, object.transform);
+		if (object.mesh) {
+			object.mesh->draw();
+		}
+		else {
+			object.model->draw();
+		}
+		draws++;
+	}
+	return draws;
+}
+
+/// <summary>
+/// Casts one ray per pixel of a 512x512 image from the camera, first one at a time then as 2x2 packets
+/// </summary>
+void benchmarkRays(const ew::SceneBvh& sceneBvh)
+{
+	const int size = 512;
+	std::vector<ew::Ray> rays(size * size);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			rays[y * size + x] = ew::cameraRay(camera, (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f);
+		}
+	}
+	double start = glfwGetTime();
+	for (size_t i = 0; i < rays.size(); i++)
+	{
+		ew::RayHit hit;
+		sceneBvh.intersect(rays[i], &hit);
+	}
+	singleRaysPerSecond = rays.size() / (glfwGetTime() - start);
+
+	start = glfwGetTime();
+	for (int y = 0; y < size; y += 2)
+	{
+		for (int x = 0; x < size; x += 2)
+		{
+			const ew::Ray packet[4] = { rays[y * size + x], rays[y * size + x + 1], rays[(y + 1) * size + x], rays[(y + 1) * size + x + 1] };
+			ew::RayHit hits[4];
+			sceneBvh.intersect4(packet, hits);
+		}
+	}
+	packetRaysPerSecond = rays.size() / (glfwGetTime() - start);
+}
@@ -13,6 +13,9 @@
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ew/glState.h>
+#include <ew/litShader.h>
+#include <ew/uniformBuffer.h>
 #include <ew/procGen.h>
 #include <slib/animation.h>
 #include <slib/joint.h>
@@ -38,19 +41,17 @@ int screenHeight = 720;
 float prevFrameTime;
 float deltaTime;
 
-struct Material {
-	float Ka = 1.0;
-	float Kd = 0.5;
-	float Ks = 0.5;
-	float Shininess = 128;
-}material;
+ew::MaterialUniforms material;
 
 int main() {
 	GLFWwindow* window = initWindow("Assignment 6", screenWidth, screenHeight);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
-	//Making a shader with the shader files in the assets folder
-	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
+	//Shared lit shader from assets/ew, with a directional light
+	ew::ShaderVariants litVariants = ew::createLitShaderVariants();
+	const ew::Shader& shader = litVariants.get(0);
+	ew::UniformBuffer frameBuffer(sizeof(ew::FrameUniforms));
+	ew::UniformBuffer materialBuffer(sizeof(ew::MaterialUniforms));
 	//Loading a 3D model for us to render
 	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
 	//Handles to OpenGL object are unsigned integers
@@ -153,20 +154,21 @@ int main() {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		//Bind brick texture to texture unit 0
-		glBindTextureUnit(0, brickTexture);
+		ew::bindTextureUnit(0, brickTexture);
 
 		//Set shader uniforms and draw
 		shader.use();
-		shader.setVec3("_EyePos", camera.position);
+		ew::FrameUniforms frameUniforms;
+		frameUniforms.viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+		frameUniforms.eyePos = camera.position;
+		frameBuffer.update(&frameUniforms, sizeof(ew::FrameUniforms));
+		frameBuffer.bind(ew::UNIFORM_BLOCK_FRAME);
+		materialBuffer.update(&material, sizeof(ew::MaterialUniforms));
+		materialBuffer.bind(ew::UNIFORM_BLOCK_MATERIAL);
 		//Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
 		shader.setInt("_MainTex", 0);
 		//transform.modelMatrix() combines translation, rotation, and scale into a 4x4 model matrix
 		//shader.setMat4("_Model", monkeyTransform.modelMatrix());
-		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		shader.setFloat("_Material.Ka", material.Ka);
-		shader.setFloat("_Material.Kd", material.Kd);
-		shader.setFloat("_Material.Ks", material.Ks);
-		shader.setFloat("_Material.Shininess", material.Shininess);
 
 		shader.setMat4("_Model", planeTransform.modelMatrix());
 		planeMesh.draw();
@@ -352,6 +354,7 @@ GLFWwindow* initWindow(const char* title, int width, int height) {
 		printf("GLAD Failed to load GL headers");
 		return nullptr;
 	}
+	ew::initParallelShaderCompile(glfwGetProcAddress);
 
 	//Initialize ImGUI
 	IMGUI_CHECKVERSION();
@@ -0,0 +1,9 @@
+//Per-frame data shared by every draw, filled from ew::FrameUniforms
+layout(std140, binding = 0) uniform FrameData{
+	mat4 _ViewProjection;  //Combined View->Projection Matrix
+	mat4 _LightSpaceMatrix;  //World->light clip space, for shadow lookups
+	vec3 _EyePos;
+	float _Bias;  //Shadow depth bias
+	vec3 _LightPos;  //Point light position
+	vec3 _LightDirection;  //Directional light, pointing away from the light
+};
@@ -0,0 +1,84 @@
+#version 450
+//Features (see ew/litShader.h): SHADOWS, POINT_LIGHT (directional otherwise), TEXTURE_ARRAY, CASCADED_SHADOWS, NORMAL_MAP
+out vec4 FragColor; //The color of this fragment
+
+in Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec3 WorldNormal; //Vertex normal in world space
+	vec2 TexCoord;
+#ifdef SHADOWS
+	vec4 FragPosLightSpace;
+#endif
+#ifdef NORMAL_MAP
+	vec4 WorldTangent;
+#endif
+}fs_in;
+
+#include "frame.glsl"
+#include "material.glsl"
+#if defined(SHADOWS) || defined(CASCADED_SHADOWS)
+#include "shadows.glsl"
+#endif
+
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray _MainTex; //Layer from the material
+#else
+uniform sampler2D _MainTex; //2D texture sampler
+#endif
+#ifdef NORMAL_MAP
+uniform sampler2D _NormalMap; //Tangent space, OpenGL convention (green up)
+#endif
+uniform vec3 _LightColor = vec3(1.0); //White light
+uniform vec3 _AmbientColor = vec3(0.3,0.4,0.46);
+
+void main(){
+	//Make sure fragment normal is still length 1 after interpolation
+	vec3 normal = normalize(fs_in.WorldNormal);
+#ifdef NORMAL_MAP
+	//Meshes without tangents read (0,0,0) and keep the vertex normal
+	if (dot(fs_in.WorldTangent.xyz, fs_in.WorldTangent.xyz) > 1e-8){
+		//Re-orthogonalized, since interpolation bends both vectors
+		vec3 tangent = normalize(fs_in.WorldTangent.xyz - normal * dot(normal, fs_in.WorldTangent.xyz));
+		vec3 bitangent = cross(normal, tangent) * fs_in.WorldTangent.w;
+		//Only X and Y are stored (BC5/RG8), Z is rebuilt
+		vec2 xy = texture(_NormalMap, fs_in.TexCoord).rg * 2.0 - 1.0;
+		vec3 tangentNormal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+		normal = normalize(mat3(tangent, bitangent, normal) * tangentNormal);
+	}
+#endif
+#ifdef POINT_LIGHT
+	vec3 toLight = normalize(_LightPos - fs_in.WorldPos);
+#else
+	vec3 toLight = -_LightDirection;
+#endif
+	float diffuseFactor = 0.5 * max(dot(normal, toLight), 0.0);
+	//Direction towards eye
+	vec3 toEye = normalize(_EyePos - fs_in.WorldPos);
+	//Blinn-phong uses half angle
+	vec3 h = normalize(toLight + toEye);
+	float specularFactor = pow(max(dot(normal, h), 0.0), _Material.Shininess);
+	//Combination of specular and diffuse reflection
+	vec3 lightColor = (_Material.Kd * diffuseFactor + _Material.Ks * specularFactor) * _LightColor;
+#if defined(CASCADED_SHADOWS)
+	lightColor *= 1.0 - ShadowCalculation(fs_in.WorldPos);
+#elif defined(SHADOWS)
+	lightColor *= 1.0 - ShadowCalculation(fs_in.FragPosLightSpace);
+#endif
+	//Add some ambient light
+	lightColor += _AmbientColor * _Material.Ka;
+	//Atlas entries only cover part of the texture
+	vec2 uv = fs_in.TexCoord * _Material.MainTexRect.xy + _Material.MainTexRect.zw;
+	//Taken before wrapping, so the jump at the wrap doesn't pick the smallest mip
+	vec2 uvDx = dFdx(uv);
+	vec2 uvDy = dFdy(uv);
+	if (_Material.MainTexRect.xy != vec2(1.0)){
+		//Wrapped inside the entry, so repeating UVs tile it instead of reading its neighbours
+		uv = fract(fs_in.TexCoord) * _Material.MainTexRect.xy + _Material.MainTexRect.zw;
+	}
+#ifdef TEXTURE_ARRAY
+	vec3 objectColor = textureGrad(_MainTex, vec3(uv, _Material.MainTexLayer), uvDx, uvDy).rgb;
+#else
+	vec3 objectColor = textureGrad(_MainTex, uv, uvDx, uvDy).rgb;
+#endif
+	FragColor = vec4(objectColor * lightColor, 1.0);
+}
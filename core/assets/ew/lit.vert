@@ -0,0 +1,55 @@
+#version 450
+//Features (see ew/litShader.h): INSTANCED, SHADOWS, NORMAL_MAP
+// Vertex attributes
+layout (location = 0) in vec3 vPos;  //Vertex position in model space
+layout (location = 1) in vec3 vNormal;  //Vertex position in model space
+layout (location = 2) in vec2 vTexCoord; //Vertex texture coordinate (UV)
+#ifdef NORMAL_MAP
+layout (location = 3) in vec4 vTangent; //xyz tangent, w bitangent sign. (0,0,0,1) when the mesh has none.
+#endif
+
+#include "frame.glsl"
+
+uniform mat4 _Model;  //Model->World Matrix. Applied to every instance before its own matrix.
+
+#ifdef INSTANCED
+//Per-instance Model->World matrices, written by ew::InstanceBuffer
+layout (std430, binding = 0) readonly buffer InstanceBlock{
+	mat4 _Models[];
+};
+#endif
+
+//This whole block will be passed to the next shader stage
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec3 WorldNormal; //Vertex normal in world space
+	vec2 TexCoord;
+#ifdef SHADOWS
+	vec4 FragPosLightSpace;
+#endif
+#ifdef NORMAL_MAP
+	vec4 WorldTangent; //w = bitangent sign
+#endif
+}vs_out;
+
+void main(){
+#ifdef INSTANCED
+	mat4 model = _Models[gl_InstanceID] * _Model;
+#else
+	mat4 model = _Model;
+#endif
+	//Transform vertex position to world space
+	vs_out.WorldPos = vec3(model * vec4(vPos, 1.0));
+	//Transform vertex normal to world space using Normal Matrix
+	vs_out.WorldNormal = transpose(inverse(mat3(model))) * vNormal;
+	vs_out.TexCoord = vTexCoord;
+#ifdef NORMAL_MAP
+	//Tangents follow the surface, so the model matrix moves them as it does positions
+	vs_out.WorldTangent = vec4(mat3(model) * vTangent.xyz, vTangent.w);
+#endif
+#ifdef SHADOWS
+	vs_out.FragPosLightSpace = _LightSpaceMatrix * vec4(vs_out.WorldPos, 1.0);
+#endif
+	//Transform vertex position to homogeneous clip space
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos, 1.0);
+}
@@ -0,0 +1,13 @@
+struct Material{
+	float Ka; //Ambient coefficient (0-1)
+	float Kd; //Diffuse coefficient (0-1)
+	float Ks; //Specular coefficient (0-1)
+	float Shininess; //Affects size of specular highlight
+	vec4 MainTexRect; //_MainTex UV scale (xy) and offset (zw), for textures packed into an atlas
+	float MainTexLayer; //_MainTex array layer (TEXTURE_ARRAY)
+};
+
+//One buffer per material, filled from ew::MaterialUniforms
+layout(std140, binding = 1) uniform MaterialData{
+	Material _Material;
+};
@@ -0,0 +1,69 @@
+#ifdef CASCADED_SHADOWS
+//Filled from ew::CascadeUniforms by ew::CascadedShadowMap
+layout(std140, binding = 2) uniform ShadowData{
+	mat4 _CascadeMatrices[4];  //World->light clip space of each cascade
+	vec4 _CascadeSplits;  //Far view depth of each cascade
+	vec4 _CascadeBias;  //Depth bias of each cascade, scaled to its texel size
+	vec3 _CameraForward;
+	int _NumCascades;
+};
+uniform sampler2DArray _ShadowMap; //One layer per cascade
+
+//0 = lit, 1 = fully shadowed. 3x3 PCF in the nearest cascade that covers worldPos, lit past the last one.
+float ShadowCalculation(vec3 worldPos)
+{
+	float viewDepth = dot(worldPos - _EyePos, _CameraForward);
+	int cascade = 0;
+	while (cascade < _NumCascades && viewDepth > _CascadeSplits[cascade])
+		cascade++;
+	if (cascade >= _NumCascades)
+		return 0.0;
+	vec4 fragPosLightSpace = _CascadeMatrices[cascade] * vec4(worldPos, 1.0);
+	//Orthographic, so no perspective divide
+	vec3 projCoords = fragPosLightSpace.xyz * 0.5 + 0.5;
+	if (projCoords.z > 1.0)
+		return 0.0;
+	float currentDepth = projCoords.z - _CascadeBias[cascade];
+	vec2 texelSize = 1.0 / textureSize(_ShadowMap, 0).xy;
+	float shadow = 0.0;
+	for(int x = -1; x <= 1; ++x)
+	{
+		for(int y = -1; y <= 1; ++y)
+		{
+			float pcfDepth = texture(_ShadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, cascade)).r;
+			shadow += currentDepth > pcfDepth ? 1.0 : 0.0;
+		}
+	}
+	return shadow / 9.0;
+}
+#else
+uniform sampler2D _ShadowMap;
+
+//0 = lit, 1 = fully shadowed. 3x3 PCF.
+float ShadowCalculation(vec4 fragPosLightSpace)
+{
+	float shadow = 0.0f;
+	vec2 texelSize = 1.0f / textureSize(_ShadowMap, 0);
+	//Perform perspective divide
+	vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+	//Transform the NDC coordinates to the range [0,1]
+	projCoords = projCoords * 0.5 + 0.5;
+	//Get depth of current fragment from light's perspective
+	float currentDepth = projCoords.z;
+
+	for(int x = -1; x <= 1; ++x)
+	{
+		for(int y = -1; y <= 1; ++y)
+		{
+			float pcfDepth = texture(_ShadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
+			shadow += currentDepth - _Bias > pcfDepth ? 1.0 : 0.0;
+		}
+	}
+	shadow /= 9.0;
+
+	if(projCoords.z > 1.0)
+		shadow = 0.0;
+
+	return shadow;
+}
+#endif
@@ -0,0 +1,332 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "assetManager.h"
+#include "glState.h"
+#include "texture.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace ew {
+	namespace {
+		const uint64_t FNV_OFFSET = 14695981039346656037ull;
+		const uint64_t FNV_PRIME = 1099511628211ull;
+
+		uint64_t hashString(const std::string& s) {
+			uint64_t hash = FNV_OFFSET;
+			for (size_t i = 0; i < s.size(); i++)
+			{
+				hash ^= (unsigned char)s[i];
+				hash *= FNV_PRIME;
+			}
+			return hash;
+		}
+
+		//Spellings of one file give the same key
+		std::string normalizePath(const std::string& filePath) {
+			std::string path = filePath;
+			for (size_t i = 0; i < path.size(); i++)
+			{
+				if (path[i] == '\\')
+					path[i] = '/';
+			}
+			//"a//b" and "a/./b" are "a/b"
+			for (size_t i = path.find("//"); i != std::string::npos; i = path.find("//", i))
+			{
+				path.erase(i, 1);
+			}
+			for (size_t i = path.find("/./"); i != std::string::npos; i = path.find("/./", i))
+			{
+				path.erase(i, 2);
+			}
+			while (path.compare(0, 2, "./") == 0) {
+				path.erase(0, 2);
+			}
+			return path;
+		}
+	}
+
+	AssetHandle::AssetHandle(AssetManager* manager, int index)
+		: m_manager(manager), m_index(index)
+	{
+		m_manager->addRef(m_index);
+	}
+
+	AssetHandle::AssetHandle(const AssetHandle& other)
+		: m_manager(other.m_manager), m_index(other.m_index)
+	{
+		if (m_manager) {
+			m_manager->addRef(m_index);
+		}
+	}
+
+	AssetHandle::AssetHandle(AssetHandle&& other)
+		: m_manager(other.m_manager), m_index(other.m_index)
+	{
+		other.m_manager = nullptr;
+		other.m_index = -1;
+	}
+
+	AssetHandle& AssetHandle::operator=(AssetHandle other)
+	{
+		//other holds the new reference, and releases the old one on its way out
+		std::swap(m_manager, other.m_manager);
+		std::swap(m_index, other.m_index);
+		return *this;
+	}
+
+	AssetHandle::~AssetHandle()
+	{
+		reset();
+	}
+
+	void AssetHandle::reset()
+	{
+		if (m_manager) {
+			m_manager->release(m_index);
+		}
+		m_manager = nullptr;
+		m_index = -1;
+	}
+
+	AssetManager::AssetManager(size_t budgetBytes)
+		: m_budget(budgetBytes)
+	{
+	}
+
+	AssetManager::~AssetManager()
+	{
+		for (size_t i = 0; i < m_assets.size(); i++)
+		{
+			unload(&m_assets[i]);
+		}
+	}
+
+	AssetHandle AssetManager::loadTexture(const std::string& filePath)
+	{
+		Asset asset;
+		asset.filePath = filePath;
+		asset.type = AssetType::TEXTURE;
+		return acquire("texture:" + normalizePath(filePath), std::move(asset));
+	}
+
+	AssetHandle AssetManager::loadTexture(const std::string& filePath, int wrapMode, int magFilter, int minFilter, bool mipmap)
+	{
+		Asset asset;
+		asset.filePath = filePath;
+		asset.type = AssetType::TEXTURE;
+		asset.defaultTextureOptions = false;
+		asset.wrapMode = wrapMode;
+		asset.magFilter = magFilter;
+		asset.minFilter = minFilter;
+		asset.mipmap = mipmap;
+		std::string key = "texture:" + normalizePath(filePath) + "|" + std::to_string(wrapMode) + "," + std::to_string(magFilter) + "," + std::to_string(minFilter) + "," + std::to_string(mipmap);
+		return acquire(key, std::move(asset));
+	}
+
+	AssetHandle AssetManager::loadModel(const std::string& filePath, const ModelOptions& options)
+	{
+		Asset asset;
+		asset.filePath = filePath;
+		asset.type = AssetType::MODEL;
+		asset.modelOptions = options;
+		std::string key = "model:" + normalizePath(filePath) + "|" + std::to_string(options.mergeMeshes) + std::to_string(options.generateTangents)
+			+ std::to_string(options.useCookedCache) + std::to_string(options.buildBvh);
+		return acquire(key, std::move(asset));
+	}
+
+	AssetHandle AssetManager::acquire(const std::string& key, Asset asset)
+	{
+		m_stats.requests++;
+		uint64_t hash = hashString(key);
+		while (true) {
+			auto it = m_lookup.find(hash);
+			if (it == m_lookup.end()) {
+				break;
+			}
+			if (m_assets[it->second].key == key) {
+				m_stats.hits++;
+				Asset* existing = &m_assets[it->second];
+				if (!existing->resident) {
+					load(existing);
+				}
+				existing->lastUsedFrame = m_frame;
+				return AssetHandle(this, it->second);
+			}
+			//Two keys with one hash. Probe on rather than share.
+			hash++;
+		}
+		asset.key = key;
+		int index = (int)m_assets.size();
+		m_assets.push_back(std::move(asset));
+		m_lookup.emplace(hash, index);
+		load(&m_assets[index]);
+		m_assets[index].lastUsedFrame = m_frame;
+		return AssetHandle(this, index);
+	}
+
+	void AssetManager::addRef(int index)
+	{
+		m_assets[index].refCount++;
+	}
+
+	void AssetManager::release(int index)
+	{
+		//Stays resident as a cache entry until evicted or unloadUnused()
+		m_assets[index].refCount--;
+	}
+
+	AssetManager::Asset* AssetManager::use(const AssetHandle& handle, AssetType type)
+	{
+		if (handle.m_manager != this || m_assets[handle.m_index].type != type) {
+			return nullptr;
+		}
+		Asset* asset = &m_assets[handle.m_index];
+		if (!asset->resident) {
+			load(asset);
+		}
+		asset->lastUsedFrame = m_frame;
+		return asset;
+	}
+
+	unsigned int AssetManager::getTexture(const AssetHandle& handle)
+	{
+		Asset* asset = use(handle, AssetType::TEXTURE);
+		return asset ? asset->texture : 0;
+	}
+
+	Model* AssetManager::getModel(const AssetHandle& handle)
+	{
+		Asset* asset = use(handle, AssetType::MODEL);
+		return asset ? asset->model.get() : nullptr;
+	}
+
+	void AssetManager::load(Asset* asset)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		if (asset->type == AssetType::TEXTURE) {
+			if (asset->defaultTextureOptions) {
+				asset->texture = ew::loadTexture(asset->filePath.c_str());
+			}
+			else {
+				asset->texture = ew::loadTexture(asset->filePath.c_str(), asset->wrapMode, asset->magFilter, asset->minFilter, asset->mipmap);
+			}
+			asset->gpuBytes = getTextureGPUBytes(asset->texture);
+		}
+		else {
+			asset->model.reset(new Model(asset->filePath, asset->modelOptions));
+			asset->gpuBytes = asset->model->getGPUBytes();
+		}
+		asset->resident = true;
+		asset->loads++;
+		m_stats.loads++;
+		if (asset->loads > 1) {
+			m_stats.reloads++;
+		}
+		m_stats.gpuBytes += asset->gpuBytes;
+		m_stats.peakGpuBytes = std::max(m_stats.peakGpuBytes, m_stats.gpuBytes);
+		m_stats.loadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	void AssetManager::unload(Asset* asset)
+	{
+		if (!asset->resident) {
+			return;
+		}
+		if (asset->texture != 0) {
+			glDeleteTextures(1, &asset->texture);
+			forgetTexture(asset->texture);
+			asset->texture = 0;
+		}
+		if (asset->model) {
+			asset->model->unload();
+			asset->model.reset();
+		}
+		m_stats.gpuBytes -= asset->gpuBytes;
+		asset->gpuBytes = 0;
+		asset->resident = false;
+	}
+
+	bool AssetManager::evict()
+	{
+		while (m_stats.gpuBytes > m_budget) {
+			Asset* victim = nullptr;
+			for (size_t i = 0; i < m_assets.size(); i++)
+			{
+				Asset* asset = &m_assets[i];
+				if (!asset->resident || asset->lastUsedFrame >= m_frame) {
+					continue;
+				}
+				//Unreferenced assets are only a cache, so they go before anything still held, then oldest first
+				if (!victim || (asset->refCount == 0) > (victim->refCount == 0)
+					|| ((asset->refCount == 0) == (victim->refCount == 0) && asset->lastUsedFrame < victim->lastUsedFrame)) {
+					victim = asset;
+				}
+			}
+			if (!victim) {
+				return false;
+			}
+			unload(victim);
+			m_stats.evictions++;
+		}
+		return true;
+	}
+
+	void AssetManager::update()
+	{
+		if (!evict()) {
+			m_stats.overBudgetFrames++;
+		}
+		m_frame++;
+	}
+
+	void AssetManager::unloadUnused()
+	{
+		for (size_t i = 0; i < m_assets.size(); i++)
+		{
+			if (m_assets[i].refCount == 0 && m_assets[i].resident) {
+				unload(&m_assets[i]);
+				m_stats.evictions++;
+			}
+		}
+	}
+
+	void AssetManager::setBudget(size_t bytes)
+	{
+		m_budget = bytes;
+	}
+
+	const AssetStats& AssetManager::getStats()
+	{
+		m_stats.assets = (int)m_assets.size();
+		m_stats.resident = 0;
+		m_stats.referenced = 0;
+		for (size_t i = 0; i < m_assets.size(); i++)
+		{
+			m_stats.resident += m_assets[i].resident;
+			m_stats.referenced += m_assets[i].refCount > 0;
+		}
+		return m_stats;
+	}
+
+	void AssetManager::getAssetInfo(std::vector<AssetInfo>* infos)const
+	{
+		infos->clear();
+		for (size_t i = 0; i < m_assets.size(); i++)
+		{
+			const Asset& asset = m_assets[i];
+			AssetInfo info;
+			info.filePath = asset.filePath;
+			info.type = asset.type;
+			info.refCount = asset.refCount;
+			info.resident = asset.resident;
+			info.gpuBytes = asset.gpuBytes;
+			info.framesSinceUse = (int)(m_frame - asset.lastUsedFrame);
+			info.loads = asset.loads;
+			infos->push_back(info);
+		}
+	}
+}
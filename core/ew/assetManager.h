@@ -0,0 +1,138 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "model.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ew {
+	class AssetManager;
+
+	enum class AssetType {
+		TEXTURE,
+		MODEL
+	};
+
+	/// <summary>
+	/// Shared reference to an asset. Copies add a reference and destruction drops it, like a shared_ptr.
+	/// Must not outlive the manager that made it.
+	/// </summary>
+	class AssetHandle {
+	public:
+		AssetHandle() {};
+		AssetHandle(const AssetHandle& other);
+		AssetHandle(AssetHandle&& other);
+		AssetHandle& operator=(AssetHandle other);
+		~AssetHandle();
+		//Drops the reference early
+		void reset();
+		inline bool isValid()const { return m_manager != nullptr; }
+	private:
+		friend class AssetManager;
+		AssetHandle(AssetManager* manager, int index);
+		AssetManager* m_manager = nullptr;
+		int m_index = -1;
+	};
+
+	struct AssetStats {
+		int assets = 0; //Registered, resident or not
+		int resident = 0; //On the GPU
+		int referenced = 0; //With at least one handle
+		int requests = 0; //load* calls
+		int hits = 0; //load* calls that found the asset already registered, so nothing new was created
+		int loads = 0; //Reads from disk, reloads included
+		int reloads = 0; //Loads of an asset that was evicted earlier
+		int evictions = 0;
+		int overBudgetFrames = 0; //update() calls that couldn't get under budget, because everything left was used that frame
+		size_t gpuBytes = 0;
+		size_t peakGpuBytes = 0;
+		double loadMs = 0.0;
+	};
+
+	//One registered asset, for debug UI
+	struct AssetInfo {
+		std::string filePath;
+		AssetType type;
+		int refCount;
+		bool resident;
+		size_t gpuBytes;
+		int framesSinceUse;
+		int loads;
+	};
+
+	/// <summary>
+	/// Registry of textures and models keyed by a hash of their path and load options, so every request for the
+	/// same file shares one GPU copy. Assets are refcounted through AssetHandle and remember how many bytes they take on the GPU.
+	/// When the total goes over the budget, update() evicts least recently used assets until it fits, unreferenced ones first.
+	/// Evicted assets stay registered and are loaded again the next time they're fetched, so fetch them every frame
+	/// through getTexture()/getModel() rather than keeping the GL name or pointer.
+	/// Assets used since the last update() are never evicted. GL thread only.
+	/// </summary>
+	class AssetManager {
+	public:
+		AssetManager(size_t budgetBytes = 512 * 1024 * 1024);
+		//Frees every asset, referenced or not
+		~AssetManager();
+		AssetManager(const AssetManager&) = delete;
+		AssetManager& operator=(const AssetManager&) = delete;
+		//Same as ew::loadTexture(filePath), flipped vertically
+		AssetHandle loadTexture(const std::string& filePath);
+		AssetHandle loadTexture(const std::string& filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+		AssetHandle loadModel(const std::string& filePath, const ModelOptions& options = ModelOptions());
+		//GL texture name, loading it again first if it was evicted. 0 for invalid handles, models, and failed loads.
+		unsigned int getTexture(const AssetHandle& handle);
+		//Loading it again first if it was evicted. Null for invalid handles and textures.
+		Model* getModel(const AssetHandle& handle);
+		//Once per frame: evicts down to the budget, then starts a new frame for the LRU order
+		void update();
+		//Frees every asset without references now, whatever the budget
+		void unloadUnused();
+		void setBudget(size_t bytes);
+		inline size_t getBudget()const { return m_budget; }
+		const AssetStats& getStats();
+		void getAssetInfo(std::vector<AssetInfo>* infos)const;
+	private:
+		friend class AssetHandle;
+		struct Asset {
+			std::string key; //Path and options the hash came from, to catch collisions
+			std::string filePath;
+			AssetType type = AssetType::TEXTURE;
+			//Texture options
+			bool defaultTextureOptions = true;
+			int wrapMode = 0;
+			int magFilter = 0;
+			int minFilter = 0;
+			bool mipmap = true;
+			ModelOptions modelOptions;
+
+			unsigned int texture = 0;
+			std::unique_ptr<Model> model;
+			bool resident = false;
+			int refCount = 0;
+			size_t gpuBytes = 0;
+			uint64_t lastUsedFrame = 0;
+			int loads = 0;
+		};
+		AssetHandle acquire(const std::string& key, Asset asset);
+		void addRef(int index);
+		void release(int index);
+		//Fetching an asset marks it used this frame
+		Asset* use(const AssetHandle& handle, AssetType type);
+		void load(Asset* asset);
+		void unload(Asset* asset);
+		//Evicts least recently used assets not used this frame until under budget. False if it couldn't get there.
+		bool evict();
+
+		std::vector<Asset> m_assets;
+		std::unordered_map<uint64_t, int> m_lookup; //Key hash -> index into m_assets
+		size_t m_budget;
+		uint64_t m_frame = 1;
+		AssetStats m_stats;
+	};
+}
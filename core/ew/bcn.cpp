@@ -0,0 +1,383 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "bcn.h"
+#include "parallel.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_BCN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//S3TC isn't core GL and glad is generated without extensions
+#define EW_GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define EW_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define EW_GL_COMPRESSED_RED_RGTC1 0x8DBB
+#define EW_GL_COMPRESSED_RG_RGTC2 0x8DBD
+
+namespace ew {
+	namespace {
+		//One 4x4 block, one array per channel so 4 pixels fit an SSE register
+		struct Block {
+			alignas(16) float r[16];
+			alignas(16) float g[16];
+			alignas(16) float b[16];
+			alignas(16) float a[16];
+		};
+
+		void loadBlock(const unsigned char* pixels, int width, int height, int numComponents, int blockX, int blockY, Block* block) {
+			for (int y = 0; y < 4; y++)
+			{
+				int py = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+				for (int x = 0; x < 4; x++)
+				{
+					int px = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+					const unsigned char* p = pixels + ((size_t)py * width + px) * numComponents;
+					int i = y * 4 + x;
+					block->r[i] = p[0];
+					block->g[i] = numComponents > 1 ? p[1] : 0.0f;
+					block->b[i] = numComponents > 2 ? p[2] : 0.0f;
+					block->a[i] = numComponents > 3 ? p[3] : 255.0f;
+				}
+			}
+		}
+
+		float sum16(const float* v) {
+#ifdef EW_BCN_SSE2
+			__m128 s = _mm_add_ps(_mm_add_ps(_mm_load_ps(v), _mm_load_ps(v + 4)), _mm_add_ps(_mm_load_ps(v + 8), _mm_load_ps(v + 12)));
+			s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+			s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+			return _mm_cvtss_f32(s);
+#else
+			float s = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				s += v[i];
+			}
+			return s;
+#endif
+		}
+
+		//dots[i] = (r, g, b)[i] . dir
+		void dot16(const Block& block, const float dir[3], float* dots) {
+#ifdef EW_BCN_SSE2
+			__m128 dr = _mm_set1_ps(dir[0]), dg = _mm_set1_ps(dir[1]), db = _mm_set1_ps(dir[2]);
+			for (int i = 0; i < 16; i += 4)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(block.r + i), dr), _mm_mul_ps(_mm_load_ps(block.g + i), dg)), _mm_mul_ps(_mm_load_ps(block.b + i), db));
+				_mm_storeu_ps(dots + i, d);
+			}
+#else
+			for (int i = 0; i < 16; i++)
+			{
+				dots[i] = block.r[i] * dir[0] + block.g[i] * dir[1] + block.b[i] * dir[2];
+			}
+#endif
+		}
+
+		//levels[i] = how many of the 3 thresholds dots[i] is above, 0-3
+		void classify16(const float* dots, const float thresholds[3], int* levels) {
+#ifdef EW_BCN_SSE2
+			__m128 t0 = _mm_set1_ps(thresholds[0]), t1 = _mm_set1_ps(thresholds[1]), t2 = _mm_set1_ps(thresholds[2]);
+			for (int i = 0; i < 16; i += 4)
+			{
+				__m128 d = _mm_loadu_ps(dots + i);
+				//Each comparison is all ones (-1) when true
+				__m128i count = _mm_add_epi32(_mm_add_epi32(_mm_castps_si128(_mm_cmpgt_ps(d, t0)), _mm_castps_si128(_mm_cmpgt_ps(d, t1))), _mm_castps_si128(_mm_cmpgt_ps(d, t2)));
+				_mm_storeu_si128((__m128i*)(levels + i), _mm_sub_epi32(_mm_setzero_si128(), count));
+			}
+#else
+			for (int i = 0; i < 16; i++)
+			{
+				levels[i] = (dots[i] > thresholds[0]) + (dots[i] > thresholds[1]) + (dots[i] > thresholds[2]);
+			}
+#endif
+		}
+
+		uint16_t to565(float r, float g, float b) {
+			int r5 = (int)(r * (31.0f / 255.0f) + 0.5f);
+			int g6 = (int)(g * (63.0f / 255.0f) + 0.5f);
+			int b5 = (int)(b * (31.0f / 255.0f) + 0.5f);
+			r5 = r5 < 0 ? 0 : (r5 > 31 ? 31 : r5);
+			g6 = g6 < 0 ? 0 : (g6 > 63 ? 63 : g6);
+			b5 = b5 < 0 ? 0 : (b5 > 31 ? 31 : b5);
+			return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+		}
+
+		void from565(uint16_t c, float* rgb) {
+			int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+			rgb[0] = (float)((r << 3) | (r >> 2));
+			rgb[1] = (float)((g << 2) | (g >> 4));
+			rgb[2] = (float)((b << 3) | (b >> 2));
+		}
+
+		/// <summary>
+		/// Picks the nearest of the 4 palette colors for every pixel. Palette colors lie on a line,
+		/// so nearest along that line is found with 3 threshold compares on one dot product.
+		/// </summary>
+		uint32_t selectColorIndices(const Block& block, uint16_t c0, uint16_t c1, int* levels) {
+			float p0[3], p1[3];
+			from565(c0, p0);
+			from565(c1, p1);
+			float dir[3] = { p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2] };
+			float d0 = p0[0] * dir[0] + p0[1] * dir[1] + p0[2] * dir[2];
+			float d1 = p1[0] * dir[0] + p1[1] * dir[1] + p1[2] * dir[2];
+			//Palette along dir: c1, (c0 + 2c1) / 3, (2c0 + c1) / 3, c0. Thresholds halfway between neighbours.
+			float step = (d0 - d1) / 3.0f;
+			float thresholds[3] = { d1 + step * 0.5f, d1 + step * 1.5f, d1 + step * 2.5f };
+			float dots[16];
+			dot16(block, dir, dots);
+			classify16(dots, thresholds, levels);
+			//Level along the line -> BC1 index
+			static const uint32_t LEVEL_TO_INDEX[4] = { 1, 3, 2, 0 };
+			uint32_t indices = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				indices |= LEVEL_TO_INDEX[levels[i]] << (i * 2);
+			}
+			return indices;
+		}
+
+		/// <summary>
+		/// Least squares endpoints for the palette positions chosen in levels, as in stb_dxt's refine step.
+		/// False if every pixel picked the same level, which leaves the fit undetermined.
+		/// </summary>
+		bool refineEndpoints(const Block& block, const int* levels, float* e0, float* e1) {
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ap[3] = {}, bp[3] = {};
+			for (int i = 0; i < 16; i++)
+			{
+				//Weight of c0 at each level along the line from c1
+				float a = levels[i] * (1.0f / 3.0f);
+				float b = 1.0f - a;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				ap[0] += a * block.r[i]; ap[1] += a * block.g[i]; ap[2] += a * block.b[i];
+				bp[0] += b * block.r[i]; bp[1] += b * block.g[i]; bp[2] += b * block.b[i];
+			}
+			float det = aa * bb - ab * ab;
+			if (fabsf(det) < 1e-6f)
+				return false;
+			float inv = 1.0f / det;
+			for (int c = 0; c < 3; c++)
+			{
+				e0[c] = (ap[c] * bb - bp[c] * ab) * inv;
+				e1[c] = (bp[c] * aa - ap[c] * ab) * inv;
+			}
+			return true;
+		}
+
+		void encodeColorBlock(const Block& block, unsigned char* output) {
+			float mean[3] = { sum16(block.r) / 16.0f, sum16(block.g) / 16.0f, sum16(block.b) / 16.0f };
+			//Covariance of the colors around their mean
+			Block centered;
+			for (int i = 0; i < 16; i++)
+			{
+				centered.r[i] = block.r[i] - mean[0];
+				centered.g[i] = block.g[i] - mean[1];
+				centered.b[i] = block.b[i] - mean[2];
+			}
+			float products[16];
+			float cov[6];
+			const float* channels[3] = { centered.r, centered.g, centered.b };
+			int k = 0;
+			for (int c0 = 0; c0 < 3; c0++)
+			{
+				for (int c1 = c0; c1 < 3; c1++)
+				{
+					for (int i = 0; i < 16; i++)
+					{
+						products[i] = channels[c0][i] * channels[c1][i];
+					}
+					cov[k++] = sum16(products);
+				}
+			}
+			//Principal axis by power iteration, starting from the bounding box diagonal
+			float minC[3] = { 255.0f, 255.0f, 255.0f }, maxC[3] = { 0.0f, 0.0f, 0.0f };
+			for (int i = 0; i < 16; i++)
+			{
+				const float p[3] = { block.r[i], block.g[i], block.b[i] };
+				for (int c = 0; c < 3; c++)
+				{
+					minC[c] = p[c] < minC[c] ? p[c] : minC[c];
+					maxC[c] = p[c] > maxC[c] ? p[c] : maxC[c];
+				}
+			}
+			float axis[3] = { maxC[0] - minC[0], maxC[1] - minC[1], maxC[2] - minC[2] };
+			for (int iteration = 0; iteration < 4; iteration++)
+			{
+				float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+				float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+				float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+				float length = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+				if (length < 1e-6f)
+					break;
+				axis[0] = x / length;
+				axis[1] = y / length;
+				axis[2] = z / length;
+			}
+
+			uint16_t c0, c1;
+			float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			if (axisLength2 < 1e-6f) {
+				//Solid block
+				c0 = c1 = to565(mean[0], mean[1], mean[2]);
+			}
+			else {
+				//Endpoints at the extreme projections onto the axis
+				float dots[16];
+				dot16(centered, axis, dots);
+				float minT = dots[0], maxT = dots[0];
+				for (int i = 1; i < 16; i++)
+				{
+					minT = dots[i] < minT ? dots[i] : minT;
+					maxT = dots[i] > maxT ? dots[i] : maxT;
+				}
+				minT /= axisLength2;
+				maxT /= axisLength2;
+				float e0[3], e1[3];
+				for (int c = 0; c < 3; c++)
+				{
+					e0[c] = mean[c] + axis[c] * maxT;
+					e1[c] = mean[c] + axis[c] * minT;
+				}
+				c0 = to565(e0[0], e0[1], e0[2]);
+				c1 = to565(e1[0], e1[1], e1[2]);
+				if (c0 != c1) {
+					int levels[16];
+					selectColorIndices(block, c0, c1, levels);
+					if (refineEndpoints(block, levels, e0, e1)) {
+						uint16_t r0 = to565(e0[0], e0[1], e0[2]);
+						uint16_t r1 = to565(e1[0], e1[1], e1[2]);
+						if (r0 != r1) {
+							c0 = r0;
+							c1 = r1;
+						}
+					}
+				}
+			}
+			//c0 > c1 selects the 4 color mode. Swapping endpoints mirrors the palette, so indices are picked after.
+			if (c0 < c1) {
+				uint16_t t = c0;
+				c0 = c1;
+				c1 = t;
+			}
+			uint32_t indices = 0;
+			if (c0 != c1) {
+				int levels[16];
+				indices = selectColorIndices(block, c0, c1, levels);
+			}
+			memcpy(output, &c0, 2);
+			memcpy(output + 2, &c1, 2);
+			memcpy(output + 4, &indices, 4);
+		}
+
+		/// <summary>
+		/// BC4 block for one channel: min/max endpoints in 8 value mode, each value rounded to the nearest of 8 steps.
+		/// </summary>
+		void encodeChannelBlock(const float* values, unsigned char* output) {
+			float minV = values[0], maxV = values[0];
+			for (int i = 1; i < 16; i++)
+			{
+				minV = values[i] < minV ? values[i] : minV;
+				maxV = values[i] > maxV ? values[i] : maxV;
+			}
+			unsigned char a0 = (unsigned char)(maxV + 0.5f);
+			unsigned char a1 = (unsigned char)(minV + 0.5f);
+			uint64_t bits = 0;
+			if (a0 != a1) {
+				int steps[16];
+				float scale = 7.0f / (float)(a0 - a1);
+#ifdef EW_BCN_SSE2
+				__m128 vMin = _mm_set1_ps((float)a1), vScale = _mm_set1_ps(scale), half = _mm_set1_ps(0.5f);
+				for (int i = 0; i < 16; i += 4)
+				{
+					__m128 t = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), vMin), vScale), half);
+					_mm_storeu_si128((__m128i*)(steps + i), _mm_cvttps_epi32(_mm_max_ps(t, _mm_setzero_ps())));
+				}
+#else
+				for (int i = 0; i < 16; i++)
+				{
+					float t = (values[i] - a1) * scale + 0.5f;
+					steps[i] = t > 0.0f ? (int)t : 0;
+				}
+#endif
+				for (int i = 0; i < 16; i++)
+				{
+					int step = steps[i] > 7 ? 7 : steps[i];
+					//Step 7 is a0, step 0 is a1, steps between are indices 6..2
+					uint64_t index = step == 7 ? 0 : (step == 0 ? 1 : (uint64_t)(8 - step));
+					bits |= index << (i * 3);
+				}
+			}
+			output[0] = a0;
+			output[1] = a1;
+			for (int i = 0; i < 6; i++)
+			{
+				output[2 + i] = (unsigned char)(bits >> (i * 8));
+			}
+		}
+	}
+
+	size_t getBCBlockSize(BCFormat format)
+	{
+		return (format == BC1 || format == BC4) ? 8 : 16;
+	}
+
+	size_t getBCImageSize(BCFormat format, int width, int height)
+	{
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBCBlockSize(format);
+	}
+
+	unsigned int getBCGLFormat(BCFormat format)
+	{
+		switch (format) {
+		case BC1:
+			return EW_GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BC3:
+			return EW_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BC4:
+			return EW_GL_COMPRESSED_RED_RGTC1;
+		default:
+			return EW_GL_COMPRESSED_RG_RGTC2;
+		}
+	}
+
+	void compressBC(BCFormat format, const unsigned char* pixels, int width, int height, int numComponents, unsigned char* output)
+	{
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+		size_t blockSize = getBCBlockSize(format);
+		parallelFor((size_t)blocksY, 16, [&](size_t begin, size_t end) {
+			Block block;
+			for (size_t by = begin; by < end; by++)
+			{
+				unsigned char* out = output + by * blocksX * blockSize;
+				for (int bx = 0; bx < blocksX; bx++, out += blockSize)
+				{
+					loadBlock(pixels, width, height, numComponents, bx, (int)by, &block);
+					switch (format) {
+					case BC1:
+						encodeColorBlock(block, out);
+						break;
+					case BC3:
+						encodeChannelBlock(block.a, out);
+						encodeColorBlock(block, out + 8);
+						break;
+					case BC4:
+						encodeChannelBlock(block.r, out);
+						break;
+					case BC5:
+						encodeChannelBlock(block.r, out);
+						encodeChannelBlock(block.g, out + 8);
+						break;
+					}
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,33 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ew {
+	//Block compressed formats. Every format stores 4x4 pixel blocks.
+	enum BCFormat {
+		BC1 = 1, //RGB, 8 bytes per block (DXT1 / GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+		BC3 = 3, //RGBA, 16 bytes per block (DXT5 / GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+		BC4 = 4, //R, 8 bytes per block (GL_COMPRESSED_RED_RGTC1)
+		BC5 = 5 //RG, 16 bytes per block, e.g. normal maps (GL_COMPRESSED_RG_RGTC2)
+	};
+
+	size_t getBCBlockSize(BCFormat format);
+	//Bytes for a width x height image. Partial blocks at the edges count as whole blocks.
+	size_t getBCImageSize(BCFormat format, int width, int height);
+	//GL internal format for glCompressedTexImage2D
+	unsigned int getBCGLFormat(BCFormat format);
+
+	/// <summary>
+	/// Encodes an 8 bit image to blocks, row of blocks by row of blocks, in parallel.
+	/// BC1 fits endpoints along the principal axis of each block's colors and refines them with least squares.
+	/// The fit and index selection use SSE2 where available. Edge blocks repeat the last row/column.
+	/// </summary>
+	/// <param name="pixels">width * height pixels of numComponents bytes each, rows tightly packed</param>
+	/// <param name="numComponents">1-4. Missing channels read as 0, missing alpha as 255.</param>
+	/// <param name="output">getBCImageSize(format, width, height) bytes</param>
+	void compressBC(BCFormat format, const unsigned char* pixels, int width, int height, int numComponents, unsigned char* output);
+}
@@ -0,0 +1,40 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ew {
+	struct AABB {
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		inline glm::vec3 center()const { return (min + max) * 0.5f; }
+		inline glm::vec3 extents()const { return (max - min) * 0.5f; }
+	};
+
+	struct BoundingSphere {
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+	};
+
+	//Smallest world space AABB containing the transformed box
+	inline AABB transformAABB(const AABB& box, const glm::mat4& m) {
+		glm::vec3 center = glm::vec3(m * glm::vec4(box.center(), 1.0f));
+		glm::vec3 e = box.extents();
+		glm::vec3 extents = glm::abs(glm::vec3(m[0])) * e.x + glm::abs(glm::vec3(m[1])) * e.y + glm::abs(glm::vec3(m[2])) * e.z;
+		AABB result;
+		result.min = center - extents;
+		result.max = center + extents;
+		return result;
+	}
+
+	//Radius grows by the largest axis scale, so the sphere stays conservative under non-uniform scale
+	inline BoundingSphere transformSphere(const BoundingSphere& sphere, const glm::mat4& m) {
+		float scaleSq = glm::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])), glm::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])), glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))));
+		BoundingSphere result;
+		result.center = glm::vec3(m * glm::vec4(sphere.center, 1.0f));
+		result.radius = sphere.radius * sqrtf(scaleSq);
+		return result;
+	}
+}
@@ -0,0 +1,864 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "bvh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_BVH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	static const int BVH_BINS = 16;
+	//Leaves with more primitives than this are always split if they can be
+	static const uint32_t BVH_MESH_MAX_LEAF_SIZE = 8;
+	static const uint32_t BVH_SCENE_MAX_LEAF_SIZE = 2;
+	//Node visit cost relative to one primitive test, for SAH
+	static const float BVH_TRAVERSAL_COST = 1.0f;
+	//Deeper nodes are made leaves, so traversal never overflows its fixed stack
+	static const int BVH_MAX_DEPTH = 62;
+	static const int BVH_STACK_SIZE = 64;
+	//Primitives per thread before binning a node in parallel
+	static const size_t BVH_MIN_PRIMITIVES_PER_THREAD = 16384;
+	//Nodes at most this large are handed to a single thread as a whole subtree
+	static const size_t BVH_MIN_SUBTREE_PRIMITIVES = 4096;
+
+	static inline AABB emptyAABB() {
+		AABB box;
+		box.min = glm::vec3(FLT_MAX);
+		box.max = glm::vec3(-FLT_MAX);
+		return box;
+	}
+
+	static inline void growAABB(AABB* box, const AABB& other) {
+		box->min = glm::min(box->min, other.min);
+		box->max = glm::max(box->max, other.max);
+	}
+
+	static inline void growAABB(AABB* box, const glm::vec3& p) {
+		box->min = glm::min(box->min, p);
+		box->max = glm::max(box->max, p);
+	}
+
+	static inline float surfaceArea(const AABB& box) {
+		glm::vec3 d = box.max - box.min;
+		if (d.x < 0.0f)
+			return 0.0f;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	//Primitives to build over, as bounds + centroids. prims is reordered into leaf order.
+	struct BvhBuilder {
+		const AABB* bounds;
+		const glm::vec3* centroids;
+		uint32_t* prims;
+		uint32_t maxLeafSize;
+	};
+
+	struct BvhRange {
+		AABB bounds;
+		AABB centroidBounds;
+	};
+
+	struct BvhBin {
+		AABB bounds;
+		uint32_t count;
+	};
+
+	struct BvhSplit {
+		int axis = -1;
+		int bin = 0; //Primitives in bins < bin go left
+		int numBins = BVH_BINS;
+		float cost = FLT_MAX; //Sum of area * count over both sides
+	};
+
+	static void growRange(const BvhBuilder& b, size_t begin, size_t end, BvhRange* range) {
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t prim = b.prims[i];
+			growAABB(&range->bounds, b.bounds[prim]);
+			growAABB(&range->centroidBounds, b.centroids[prim]);
+		}
+	}
+
+	static BvhRange computeRange(const BvhBuilder& b, uint32_t first, uint32_t count, bool parallel) {
+		BvhRange range;
+		range.bounds = emptyAABB();
+		range.centroidBounds = emptyAABB();
+		if (!parallel) {
+			growRange(b, first, first + count, &range);
+			return range;
+		}
+		std::mutex mutex;
+		parallelFor(count, BVH_MIN_PRIMITIVES_PER_THREAD, [&](size_t begin, size_t end) {
+			BvhRange local;
+			local.bounds = emptyAABB();
+			local.centroidBounds = emptyAABB();
+			growRange(b, first + begin, first + end, &local);
+			std::lock_guard<std::mutex> lock(mutex);
+			growAABB(&range.bounds, local.bounds);
+			growAABB(&range.centroidBounds, local.centroidBounds);
+		});
+		return range;
+	}
+
+	static inline int binIndex(float centroid, float binMin, float binScale, int numBins) {
+		int bin = (int)((centroid - binMin) * binScale);
+		return bin < 0 ? 0 : (bin >= numBins ? numBins - 1 : bin);
+	}
+
+	static void clearBins(BvhBin bins[3][BVH_BINS], int numBins) {
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = 0; i < numBins; i++)
+			{
+				bins[axis][i].bounds = emptyAABB();
+				bins[axis][i].count = 0;
+			}
+		}
+	}
+
+	static void binPrimitives(const BvhBuilder& b, size_t begin, size_t end, const glm::vec3& binMin, const float binScale[3], int numBins, BvhBin bins[3][BVH_BINS]) {
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t prim = b.prims[i];
+			const glm::vec3& c = b.centroids[prim];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				BvhBin& bin = bins[axis][binIndex(c[axis], binMin[axis], binScale[axis], numBins)];
+				growAABB(&bin.bounds, b.bounds[prim]);
+				bin.count++;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Bins centroids along all 3 axes and returns the split with the lowest surface area cost.
+	/// Only splits with primitives on both sides are considered.
+	/// </summary>
+	static BvhSplit findSplit(const BvhBuilder& b, uint32_t first, uint32_t count, const BvhRange& range, bool parallel) {
+		BvhSplit best;
+		//Small nodes don't need all the bins
+		best.numBins = count < (uint32_t)BVH_BINS ? (int)count : BVH_BINS;
+		const int numBins = best.numBins;
+		glm::vec3 binMin = range.centroidBounds.min;
+		glm::vec3 extent = range.centroidBounds.max - range.centroidBounds.min;
+		float binScale[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			binScale[axis] = extent[axis] > 0.0f ? numBins / extent[axis] : 0.0f;
+		}
+		BvhBin bins[3][BVH_BINS];
+		clearBins(bins, numBins);
+		if (!parallel) {
+			binPrimitives(b, first, first + count, binMin, binScale, numBins, bins);
+		}
+		else {
+			std::mutex mutex;
+			parallelFor(count, BVH_MIN_PRIMITIVES_PER_THREAD, [&](size_t begin, size_t end) {
+				BvhBin local[3][BVH_BINS];
+				clearBins(local, numBins);
+				binPrimitives(b, first + begin, first + end, binMin, binScale, numBins, local);
+				std::lock_guard<std::mutex> lock(mutex);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					for (int i = 0; i < numBins; i++)
+					{
+						growAABB(&bins[axis][i].bounds, local[axis][i].bounds);
+						bins[axis][i].count += local[axis][i].count;
+					}
+				}
+			});
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (binScale[axis] == 0.0f)
+				continue;
+			//Sweep from the right to get the cost of everything at or after each split
+			float rightArea[BVH_BINS];
+			uint32_t rightCount[BVH_BINS];
+			AABB box = emptyAABB();
+			uint32_t n = 0;
+			for (int i = numBins - 1; i > 0; i--)
+			{
+				growAABB(&box, bins[axis][i].bounds);
+				n += bins[axis][i].count;
+				rightArea[i] = surfaceArea(box);
+				rightCount[i] = n;
+			}
+			box = emptyAABB();
+			n = 0;
+			for (int i = 1; i < numBins; i++)
+			{
+				growAABB(&box, bins[axis][i - 1].bounds);
+				n += bins[axis][i - 1].count;
+				if (n == 0 || rightCount[i] == 0)
+					continue;
+				float cost = surfaceArea(box) * n + rightArea[i] * rightCount[i];
+				if (cost < best.cost) {
+					best.axis = axis;
+					best.bin = i;
+					best.cost = cost;
+				}
+			}
+		}
+		return best;
+	}
+
+	/// <summary>
+	/// Decides between a leaf and the best SAH split, and partitions prims if splitting.
+	/// </summary>
+	/// <returns>True with *mid set to the first right primitive, false for a leaf</returns>
+	static bool splitRange(const BvhBuilder& b, uint32_t first, uint32_t count, int depth, const BvhRange& range, bool parallel, uint32_t* mid) {
+		if (count <= 1 || depth >= BVH_MAX_DEPTH)
+			return false;
+		BvhSplit split = findSplit(b, first, count, range, parallel);
+		if (split.axis < 0)
+			return false; //All centroids coincide
+		float area = surfaceArea(range.bounds);
+		float splitCost = BVH_TRAVERSAL_COST + (area > 0.0f ? split.cost / area : 0.0f);
+		if (count <= b.maxLeafSize && splitCost >= (float)count)
+			return false;
+
+		//Same bin function as findSplit so both sides match what was costed
+		int axis = split.axis;
+		float binMin = range.centroidBounds.min[axis];
+		float binScale = split.numBins / (range.centroidBounds.max[axis] - binMin);
+		int64_t i = first;
+		int64_t j = (int64_t)first + count - 1;
+		while (i <= j)
+		{
+			if (binIndex(b.centroids[b.prims[i]][axis], binMin, binScale, split.numBins) < split.bin) {
+				i++;
+			}
+			else {
+				std::swap(b.prims[i], b.prims[j]);
+				j--;
+			}
+		}
+		*mid = (uint32_t)i;
+		return true;
+	}
+
+	static void setLeaf(BvhNode* node, const BvhRange& range, uint32_t first, uint32_t count) {
+		node->boundsMin = range.bounds.min;
+		node->boundsMax = range.bounds.max;
+		node->leftFirst = first;
+		node->count = count;
+	}
+
+	//Single threaded build of a subtree into nodes[nodeIndex]
+	static void buildSubtree(const BvhBuilder& b, std::vector<BvhNode>& nodes, uint32_t nodeIndex, uint32_t first, uint32_t count, int depth) {
+		BvhRange range = computeRange(b, first, count, false);
+		uint32_t mid;
+		if (!splitRange(b, first, count, depth, range, false, &mid)) {
+			setLeaf(&nodes[nodeIndex], range, first, count);
+			return;
+		}
+		uint32_t left = (uint32_t)nodes.size();
+		nodes.resize(nodes.size() + 2);
+		BvhNode& node = nodes[nodeIndex];
+		node.boundsMin = range.bounds.min;
+		node.boundsMax = range.bounds.max;
+		node.leftFirst = left;
+		node.count = 0;
+		buildSubtree(b, nodes, left, first, mid - first, depth + 1);
+		buildSubtree(b, nodes, left + 1, mid, first + count - mid, depth + 1);
+	}
+
+	/// <summary>
+	/// Builds a BVH over numPrimitives bounds. The top levels are split one node at a time with parallel binning
+	/// until every open node is small enough, then those subtrees are built concurrently and appended.
+	/// </summary>
+	static void buildBvh(BvhBuilder b, uint32_t numPrimitives, std::vector<BvhNode>* nodes, BvhBuildStats* stats) {
+		nodes->clear();
+		if (numPrimitives == 0)
+			return;
+		struct SubtreeJob {
+			uint32_t nodeIndex, first, count;
+			int depth;
+		};
+		const size_t numThreads = getNumWorkerThreads();
+		size_t subtreeSize = numPrimitives / (numThreads * 8);
+		if (subtreeSize < BVH_MIN_SUBTREE_PRIMITIVES)
+			subtreeSize = BVH_MIN_SUBTREE_PRIMITIVES;
+
+		nodes->reserve(numPrimitives * 2);
+		nodes->resize(1);
+		std::vector<SubtreeJob> open;
+		std::vector<SubtreeJob> jobs;
+		open.push_back({ 0, 0, numPrimitives, 0 });
+		while (!open.empty())
+		{
+			SubtreeJob job = open.back();
+			open.pop_back();
+			if (job.count <= subtreeSize || numThreads <= 1) {
+				jobs.push_back(job);
+				continue;
+			}
+			BvhRange range = computeRange(b, job.first, job.count, true);
+			uint32_t mid;
+			if (!splitRange(b, job.first, job.count, job.depth, range, true, &mid)) {
+				setLeaf(&(*nodes)[job.nodeIndex], range, job.first, job.count);
+				continue;
+			}
+			uint32_t left = (uint32_t)nodes->size();
+			nodes->resize(nodes->size() + 2);
+			BvhNode& node = (*nodes)[job.nodeIndex];
+			node.boundsMin = range.bounds.min;
+			node.boundsMax = range.bounds.max;
+			node.leftFirst = left;
+			node.count = 0;
+			open.push_back({ left, job.first, mid - job.first, job.depth + 1 });
+			open.push_back({ left + 1, mid, job.first + job.count - mid, job.depth + 1 });
+		}
+
+		//Subtrees vary a lot in size, so threads pull them from a shared counter
+		std::vector<std::vector<BvhNode>> subtrees(jobs.size());
+		std::atomic<size_t> nextJob(0);
+		parallelFor(std::min(numThreads, jobs.size()), 1, [&](size_t, size_t) {
+			for (size_t j = nextJob++; j < jobs.size(); j = nextJob++)
+			{
+				const SubtreeJob& job = jobs[j];
+				subtrees[j].reserve(job.count * 2);
+				subtrees[j].resize(1);
+				buildSubtree(b, subtrees[j], 0, job.first, job.count, job.depth);
+			}
+		});
+
+		//Append each subtree, moving its root into the placeholder node and offsetting child links
+		for (size_t j = 0; j < jobs.size(); j++)
+		{
+			const std::vector<BvhNode>& subtree = subtrees[j];
+			uint32_t offset = (uint32_t)nodes->size() - 1;
+			for (size_t k = 0; k < subtree.size(); k++)
+			{
+				BvhNode node = subtree[k];
+				if (!node.isLeaf())
+					node.leftFirst += offset;
+				if (k == 0)
+					(*nodes)[jobs[j].nodeIndex] = node;
+				else
+					nodes->push_back(node);
+			}
+		}
+		if (stats) {
+			stats->numPrimitives = numPrimitives;
+			stats->numNodes = nodes->size();
+			stats->numSubtrees = (int)jobs.size();
+			stats->numThreads = (unsigned int)numThreads;
+		}
+	}
+
+	//Slab test. Returns the entry distance, or FLT_MAX on a miss or when the box starts beyond tBest.
+	static inline float intersectNode(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tBest) {
+		float tx1 = (node.boundsMin.x - origin.x) * invDir.x, tx2 = (node.boundsMax.x - origin.x) * invDir.x;
+		float ty1 = (node.boundsMin.y - origin.y) * invDir.y, ty2 = (node.boundsMax.y - origin.y) * invDir.y;
+		float tz1 = (node.boundsMin.z - origin.z) * invDir.z, tz2 = (node.boundsMax.z - origin.z) * invDir.z;
+		float tMin = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::min(tz1, tz2));
+		float tMax = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::max(tz1, tz2));
+		if (tMax >= tMin && tMax >= 0.0f && tMin < tBest)
+			return tMin;
+		return FLT_MAX;
+	}
+
+	/// <summary>
+	/// Small stack traversal that visits the nearer child first.
+	/// leaf(first, count, &tBest) tests primitives, may shrink tBest, and returns true to stop early.
+	/// </summary>
+	template<typename LeafFn>
+	static void traverse(const std::vector<BvhNode>& nodes, const Ray& ray, float tBest, LeafFn leaf) {
+		if (nodes.empty())
+			return;
+		glm::vec3 invDir = glm::vec3(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+		if (intersectNode(nodes[0], ray.origin, invDir, tBest) == FLT_MAX)
+			return;
+		uint32_t stack[BVH_STACK_SIZE];
+		int stackSize = 0;
+		uint32_t current = 0;
+		while (true)
+		{
+			const BvhNode& node = nodes[current];
+			if (node.isLeaf()) {
+				if (leaf(node.leftFirst, node.count, &tBest))
+					return;
+			}
+			else {
+				uint32_t nearChild = node.leftFirst;
+				uint32_t farChild = node.leftFirst + 1;
+				float tNear = intersectNode(nodes[nearChild], ray.origin, invDir, tBest);
+				float tFar = intersectNode(nodes[farChild], ray.origin, invDir, tBest);
+				if (tFar < tNear) {
+					std::swap(nearChild, farChild);
+					std::swap(tNear, tFar);
+				}
+				if (tNear != FLT_MAX) {
+					if (tFar != FLT_MAX)
+						stack[stackSize++] = farChild;
+					current = nearChild;
+					continue;
+				}
+			}
+			if (stackSize == 0)
+				return;
+			current = stack[--stackSize];
+		}
+	}
+
+	MeshBvh::MeshBvh(const MeshData& meshData)
+	{
+		build(&meshData, 1);
+	}
+
+	void MeshBvh::build(const MeshData* meshes, size_t count, BvhBuildStats* stats)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		size_t numTriangles = 0;
+		for (size_t m = 0; m < count; m++)
+		{
+			numTriangles += meshes[m].indices.size() / 3;
+		}
+		std::vector<Triangle> triangles(numTriangles);
+		std::vector<AABB> bounds(numTriangles);
+		std::vector<glm::vec3> centroids(numTriangles);
+		size_t firstTriangle = 0;
+		for (size_t m = 0; m < count; m++)
+		{
+			const Vertex* vertices = meshes[m].vertices.data();
+			const unsigned int* indices = meshes[m].indices.data();
+			size_t meshTriangles = meshes[m].indices.size() / 3;
+			parallelFor(meshTriangles, BVH_MIN_PRIMITIVES_PER_THREAD, [&](size_t begin, size_t end) {
+				for (size_t t = begin; t < end; t++)
+				{
+					const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+					const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+					const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+					size_t i = firstTriangle + t;
+					triangles[i].v0 = p0;
+					triangles[i].edge1 = p1 - p0;
+					triangles[i].edge2 = p2 - p0;
+					bounds[i].min = glm::min(p0, glm::min(p1, p2));
+					bounds[i].max = glm::max(p0, glm::max(p1, p2));
+					centroids[i] = (p0 + p1 + p2) * (1.0f / 3.0f);
+				}
+			});
+			firstTriangle += meshTriangles;
+		}
+
+		m_triangleIds.resize(numTriangles);
+		for (size_t i = 0; i < numTriangles; i++)
+		{
+			m_triangleIds[i] = (int)i;
+		}
+		BvhBuilder builder;
+		builder.bounds = bounds.data();
+		builder.centroids = centroids.data();
+		builder.prims = (uint32_t*)m_triangleIds.data();
+		builder.maxLeafSize = BVH_MESH_MAX_LEAF_SIZE;
+		buildBvh(builder, (uint32_t)numTriangles, &m_nodes, stats);
+
+		m_triangles.resize(numTriangles);
+		parallelFor(numTriangles, BVH_MIN_PRIMITIVES_PER_THREAD, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				m_triangles[i] = triangles[m_triangleIds[i]];
+			}
+		});
+		if (stats) {
+			stats->buildSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+	}
+
+	AABB MeshBvh::getBounds() const
+	{
+		if (m_nodes.empty())
+			return emptyAABB();
+		AABB box;
+		box.min = m_nodes[0].boundsMin;
+		box.max = m_nodes[0].boundsMax;
+		return box;
+	}
+
+	//Moller-Trumbore. Returns true for a hit in (0, tBest).
+	static inline bool intersectTriangle(const glm::vec3& v0, const glm::vec3& edge1, const glm::vec3& edge2, const Ray& ray, float tBest, float* t, float* u, float* v) {
+		glm::vec3 pvec = glm::cross(ray.direction, edge2);
+		float det = glm::dot(edge1, pvec);
+		if (fabsf(det) < 1e-12f)
+			return false;
+		float invDet = 1.0f / det;
+		glm::vec3 tvec = ray.origin - v0;
+		float bu = glm::dot(tvec, pvec) * invDet;
+		if (bu < 0.0f || bu > 1.0f)
+			return false;
+		glm::vec3 qvec = glm::cross(tvec, edge1);
+		float bv = glm::dot(ray.direction, qvec) * invDet;
+		if (bv < 0.0f || bu + bv > 1.0f)
+			return false;
+		float dist = glm::dot(edge2, qvec) * invDet;
+		if (dist <= 0.0f || dist >= tBest)
+			return false;
+		*t = dist;
+		*u = bu;
+		*v = bv;
+		return true;
+	}
+
+	bool MeshBvh::intersect(const Ray& ray, RayHit* hit) const
+	{
+		int triangle = -1;
+		float hitT = ray.tMax, hitU = 0.0f, hitV = 0.0f;
+		traverse(m_nodes, ray, ray.tMax, [&](uint32_t first, uint32_t count, float* tBest) {
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const Triangle& tri = m_triangles[i];
+				if (intersectTriangle(tri.v0, tri.edge1, tri.edge2, ray, *tBest, &hitT, &hitU, &hitV)) {
+					*tBest = hitT;
+					triangle = (int)i;
+				}
+			}
+			return false;
+		});
+		//Every accepted hit is closer than the previous one, so the last one written wins
+		if (triangle < 0)
+			return false;
+		hit->t = hitT;
+		hit->u = hitU;
+		hit->v = hitV;
+		hit->triangle = m_triangleIds[triangle];
+		hit->instance = -1;
+		return true;
+	}
+
+	bool MeshBvh::occluded(const Ray& ray) const
+	{
+		bool found = false;
+		traverse(m_nodes, ray, ray.tMax, [&](uint32_t first, uint32_t count, float* tBest) {
+			float t, u, v;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const Triangle& tri = m_triangles[i];
+				if (intersectTriangle(tri.v0, tri.edge1, tri.edge2, ray, *tBest, &t, &u, &v)) {
+					found = true;
+					return true;
+				}
+			}
+			return false;
+		});
+		return found;
+	}
+
+#ifdef EW_BVH_SSE2
+	//4 rays as structure-of-arrays, one per lane
+	struct RayPacket {
+		__m128 ox, oy, oz;
+		__m128 dx, dy, dz;
+		__m128 ix, iy, iz; //Inverse direction
+		__m128 tBest;
+	};
+
+	static RayPacket makePacket(const Ray rays[4]) {
+		RayPacket p;
+		p.ox = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+		p.oy = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+		p.oz = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+		p.dx = _mm_setr_ps(rays[0].direction.x, rays[1].direction.x, rays[2].direction.x, rays[3].direction.x);
+		p.dy = _mm_setr_ps(rays[0].direction.y, rays[1].direction.y, rays[2].direction.y, rays[3].direction.y);
+		p.dz = _mm_setr_ps(rays[0].direction.z, rays[1].direction.z, rays[2].direction.z, rays[3].direction.z);
+		const __m128 one = _mm_set1_ps(1.0f);
+		p.ix = _mm_div_ps(one, p.dx);
+		p.iy = _mm_div_ps(one, p.dy);
+		p.iz = _mm_div_ps(one, p.dz);
+		p.tBest = _mm_setr_ps(rays[0].tMax, rays[1].tMax, rays[2].tMax, rays[3].tMax);
+		return p;
+	}
+
+	//Slab test for all 4 lanes. Returns a lane mask of hits and the smallest entry distance among them.
+	static inline int intersectNode4(const BvhNode& node, const RayPacket& p, float* tNearest) {
+		__m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.x), p.ox), p.ix);
+		__m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.x), p.ox), p.ix);
+		__m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.y), p.oy), p.iy);
+		__m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.y), p.oy), p.iy);
+		__m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.z), p.oz), p.iz);
+		__m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.z), p.oz), p.iz);
+		__m128 tMin = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2));
+		__m128 tMax = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2));
+		__m128 hit = _mm_and_ps(_mm_cmpge_ps(tMax, _mm_max_ps(tMin, _mm_setzero_ps())), _mm_cmplt_ps(tMin, p.tBest));
+		int mask = _mm_movemask_ps(hit);
+		if (mask) {
+			float entries[4];
+			_mm_storeu_ps(entries, _mm_or_ps(_mm_and_ps(hit, tMin), _mm_andnot_ps(hit, _mm_set1_ps(FLT_MAX))));
+			*tNearest = std::min(std::min(entries[0], entries[1]), std::min(entries[2], entries[3]));
+		}
+		return mask;
+	}
+
+	//Packet version of traverse(). A node is entered when any lane hits it.
+	template<typename LeafFn>
+	static void traverse4(const std::vector<BvhNode>& nodes, RayPacket* packet, LeafFn leaf) {
+		if (nodes.empty())
+			return;
+		float tRoot;
+		if (!intersectNode4(nodes[0], *packet, &tRoot))
+			return;
+		uint32_t stack[BVH_STACK_SIZE];
+		int stackSize = 0;
+		uint32_t current = 0;
+		while (true)
+		{
+			const BvhNode& node = nodes[current];
+			if (node.isLeaf()) {
+				leaf(node.leftFirst, node.count, packet);
+			}
+			else {
+				uint32_t nearChild = node.leftFirst;
+				uint32_t farChild = node.leftFirst + 1;
+				float tNear = FLT_MAX, tFar = FLT_MAX;
+				int nearChildMask = intersectNode4(nodes[nearChild], *packet, &tNear);
+				int farChildMask = intersectNode4(nodes[farChild], *packet, &tFar);
+				if (nearChildMask && farChildMask) {
+					if (tFar < tNear)
+						std::swap(nearChild, farChild);
+					stack[stackSize++] = farChild;
+					current = nearChild;
+					continue;
+				}
+				if (nearChildMask || farChildMask) {
+					current = nearChildMask ? nearChild : farChild;
+					continue;
+				}
+			}
+			if (stackSize == 0)
+				return;
+			current = stack[--stackSize];
+		}
+	}
+
+	void MeshBvh::intersect4(const Ray rays[4], RayHit hits[4]) const
+	{
+		RayPacket packet = makePacket(rays);
+		__m128i triangle = _mm_set1_epi32(-1);
+		__m128 hitU = _mm_setzero_ps(), hitV = _mm_setzero_ps();
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), epsilon = _mm_set1_ps(1e-12f);
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		traverse4(m_nodes, &packet, [&](uint32_t first, uint32_t count, RayPacket* p) {
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				//Moller-Trumbore, one triangle against 4 rays
+				const Triangle& tri = m_triangles[i];
+				__m128 e1x = _mm_set1_ps(tri.edge1.x), e1y = _mm_set1_ps(tri.edge1.y), e1z = _mm_set1_ps(tri.edge1.z);
+				__m128 e2x = _mm_set1_ps(tri.edge2.x), e2y = _mm_set1_ps(tri.edge2.y), e2z = _mm_set1_ps(tri.edge2.z);
+				//pvec = cross(dir, edge2)
+				__m128 px = _mm_sub_ps(_mm_mul_ps(p->dy, e2z), _mm_mul_ps(p->dz, e2y));
+				__m128 py = _mm_sub_ps(_mm_mul_ps(p->dz, e2x), _mm_mul_ps(p->dx, e2z));
+				__m128 pz = _mm_sub_ps(_mm_mul_ps(p->dx, e2y), _mm_mul_ps(p->dy, e2x));
+				__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				__m128 invDet = _mm_div_ps(one, det);
+				__m128 tx = _mm_sub_ps(p->ox, _mm_set1_ps(tri.v0.x));
+				__m128 ty = _mm_sub_ps(p->oy, _mm_set1_ps(tri.v0.y));
+				__m128 tz = _mm_sub_ps(p->oz, _mm_set1_ps(tri.v0.z));
+				__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+				//qvec = cross(tvec, edge1)
+				__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+				__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+				__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+				__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p->dx, qx), _mm_mul_ps(p->dy, qy)), _mm_mul_ps(p->dz, qz)), invDet);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+				__m128 accept = _mm_cmpge_ps(_mm_andnot_ps(signMask, det), epsilon);
+				accept = _mm_and_ps(accept, _mm_cmpge_ps(u, zero));
+				accept = _mm_and_ps(accept, _mm_cmpge_ps(v, zero));
+				accept = _mm_and_ps(accept, _mm_cmple_ps(_mm_add_ps(u, v), one));
+				accept = _mm_and_ps(accept, _mm_cmpgt_ps(t, zero));
+				accept = _mm_and_ps(accept, _mm_cmplt_ps(t, p->tBest));
+				if (!_mm_movemask_ps(accept))
+					continue;
+				p->tBest = _mm_or_ps(_mm_and_ps(accept, t), _mm_andnot_ps(accept, p->tBest));
+				hitU = _mm_or_ps(_mm_and_ps(accept, u), _mm_andnot_ps(accept, hitU));
+				hitV = _mm_or_ps(_mm_and_ps(accept, v), _mm_andnot_ps(accept, hitV));
+				__m128i acceptInt = _mm_castps_si128(accept);
+				triangle = _mm_or_si128(_mm_and_si128(acceptInt, _mm_set1_epi32((int)i)), _mm_andnot_si128(acceptInt, triangle));
+			}
+		});
+		float t[4], u[4], v[4];
+		int ids[4];
+		_mm_storeu_ps(t, packet.tBest);
+		_mm_storeu_ps(u, hitU);
+		_mm_storeu_ps(v, hitV);
+		_mm_storeu_si128((__m128i*)ids, triangle);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (ids[lane] < 0)
+				continue;
+			hits[lane].t = t[lane];
+			hits[lane].u = u[lane];
+			hits[lane].v = v[lane];
+			hits[lane].triangle = m_triangleIds[ids[lane]];
+			hits[lane].instance = -1;
+		}
+	}
+#else
+	void MeshBvh::intersect4(const Ray rays[4], RayHit hits[4]) const
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			intersect(rays[lane], &hits[lane]);
+		}
+	}
+#endif
+
+	void SceneBvh::build(const std::vector<BvhInstance>& instances, BvhBuildStats* stats)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::vector<AABB> bounds;
+		std::vector<glm::vec3> centroids;
+		std::vector<int> ids;
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			if (instances[i].bvh == nullptr || !instances[i].bvh->isBuilt())
+				continue;
+			AABB box = transformAABB(instances[i].bvh->getBounds(), instances[i].transform);
+			bounds.push_back(box);
+			centroids.push_back(box.center());
+			ids.push_back((int)i);
+		}
+		std::vector<uint32_t> order(ids.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = (uint32_t)i;
+		}
+		BvhBuilder builder;
+		builder.bounds = bounds.data();
+		builder.centroids = centroids.data();
+		builder.prims = order.data();
+		builder.maxLeafSize = BVH_SCENE_MAX_LEAF_SIZE;
+		buildBvh(builder, (uint32_t)order.size(), &m_nodes, stats);
+
+		m_instances.resize(order.size());
+		m_worldToModel.resize(order.size());
+		m_instanceIds.resize(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			int id = ids[order[i]];
+			m_instances[i] = instances[id];
+			m_worldToModel[i] = glm::inverse(instances[id].transform);
+			m_instanceIds[i] = id;
+		}
+		if (stats) {
+			stats->buildSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+	}
+
+	//Same parameterization in model space: t along the transformed ray is t along the world ray
+	static inline Ray toModelSpace(const Ray& ray, const glm::mat4& worldToModel, float tMax) {
+		Ray local;
+		local.origin = glm::vec3(worldToModel * glm::vec4(ray.origin, 1.0f));
+		local.direction = glm::vec3(worldToModel * glm::vec4(ray.direction, 0.0f));
+		local.tMax = tMax;
+		return local;
+	}
+
+	bool SceneBvh::intersect(const Ray& ray, RayHit* hit) const
+	{
+		bool found = false;
+		traverse(m_nodes, ray, ray.tMax, [&](uint32_t first, uint32_t count, float* tBest) {
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				RayHit instanceHit;
+				if (m_instances[i].bvh->intersect(toModelSpace(ray, m_worldToModel[i], *tBest), &instanceHit)) {
+					*tBest = instanceHit.t;
+					instanceHit.instance = m_instanceIds[i];
+					*hit = instanceHit;
+					found = true;
+				}
+			}
+			return false;
+		});
+		return found;
+	}
+
+	bool SceneBvh::occluded(const Ray& ray) const
+	{
+		bool found = false;
+		traverse(m_nodes, ray, ray.tMax, [&](uint32_t first, uint32_t count, float* tBest) {
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				if (m_instances[i].bvh->occluded(toModelSpace(ray, m_worldToModel[i], *tBest))) {
+					found = true;
+					return true;
+				}
+			}
+			return false;
+		});
+		return found;
+	}
+
+#ifdef EW_BVH_SSE2
+	void SceneBvh::intersect4(const Ray rays[4], RayHit hits[4]) const
+	{
+		RayPacket packet = makePacket(rays);
+		traverse4(m_nodes, &packet, [&](uint32_t first, uint32_t count, RayPacket* p) {
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				float tBest[4];
+				_mm_storeu_ps(tBest, p->tBest);
+				Ray local[4];
+				RayHit localHits[4];
+				for (int lane = 0; lane < 4; lane++)
+				{
+					local[lane] = toModelSpace(rays[lane], m_worldToModel[i], tBest[lane]);
+				}
+				m_instances[i].bvh->intersect4(local, localHits);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if (!localHits[lane].hit())
+						continue;
+					tBest[lane] = localHits[lane].t;
+					hits[lane] = localHits[lane];
+					hits[lane].instance = m_instanceIds[i];
+				}
+				p->tBest = _mm_loadu_ps(tBest);
+			}
+		});
+	}
+#else
+	void SceneBvh::intersect4(const Ray rays[4], RayHit hits[4]) const
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			intersect(rays[lane], &hits[lane]);
+		}
+	}
+#endif
+
+	Ray cameraRay(const Camera& camera, float ndcX, float ndcY)
+	{
+		//Same basis as Camera::viewMatrix()
+		glm::vec3 forward = glm::normalize(camera.target - camera.position);
+		glm::vec3 up = glm::vec3(0, 1, 0);
+		if (glm::abs(glm::dot(forward, up)) >= 1.0f - glm::epsilon<float>()) {
+			up = glm::vec3(0, 0, 1);
+		}
+		glm::vec3 right = glm::normalize(glm::cross(forward, up));
+		up = glm::cross(right, forward);
+
+		Ray ray;
+		if (camera.orthographic) {
+			float halfHeight = camera.orthoHeight * 0.5f;
+			ray.origin = camera.position + right * (ndcX * halfHeight * camera.aspectRatio) + up * (ndcY * halfHeight);
+			ray.direction = forward;
+		}
+		else {
+			float tanHalfFov = tanf(glm::radians(camera.fov) * 0.5f);
+			ray.origin = camera.position;
+			ray.direction = glm::normalize(forward + right * (ndcX * tanHalfFov * camera.aspectRatio) + up * (ndcY * tanHalfFov));
+		}
+		return ray;
+	}
+}
@@ -0,0 +1,106 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+#include "camera.h"
+#include <float.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ew {
+	struct Ray {
+		glm::vec3 origin = glm::vec3(0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f); //Need not be normalized. Hit distances are in units of its length.
+		float tMax = FLT_MAX;
+	};
+
+	struct RayHit {
+		float t = FLT_MAX;
+		int triangle = -1; //Index into the source triangle list (indices / 3, counted across all submeshes)
+		int instance = -1; //Set by SceneBvh
+		float u = 0.0f, v = 0.0f; //Barycentrics of vertex 1 and 2
+		inline bool hit()const { return triangle >= 0; }
+	};
+
+	/// <summary>
+	/// 32 byte node. Children of an interior node are stored next to each other at leftFirst and leftFirst + 1.
+	/// Leaves hold count primitives starting at leftFirst.
+	/// </summary>
+	struct BvhNode {
+		glm::vec3 boundsMin;
+		uint32_t leftFirst;
+		glm::vec3 boundsMax;
+		uint32_t count; //0 for interior nodes
+		inline bool isLeaf()const { return count > 0; }
+	};
+
+	struct BvhBuildStats {
+		size_t numPrimitives = 0;
+		size_t numNodes = 0;
+		int numSubtrees = 0; //Subtrees built in parallel after the top levels
+		unsigned int numThreads = 0;
+		double buildSeconds = 0.0;
+	};
+
+	/// <summary>
+	/// Binned SAH BVH over the triangles of one or more MeshData, in model space.
+	/// The top levels are split with parallel binning, then the remaining subtrees are built in parallel.
+	/// Triangles are copied out in leaf order so traversal reads them linearly.
+	/// </summary>
+	class MeshBvh {
+	public:
+		MeshBvh() {};
+		MeshBvh(const MeshData& meshData);
+		void build(const MeshData* meshes, size_t count, BvhBuildStats* stats = nullptr);
+		//Closest hit closer than ray.tMax. hit is only written on a hit.
+		bool intersect(const Ray& ray, RayHit* hit)const;
+		//Any hit closer than ray.tMax, for line of sight checks
+		bool occluded(const Ray& ray)const;
+		//Closest hits for 4 rays at once with SSE2. Rays that are close to each other (e.g. neighboring pixels) traverse fastest.
+		void intersect4(const Ray rays[4], RayHit hits[4])const;
+		inline bool isBuilt()const { return !m_nodes.empty(); }
+		inline const std::vector<BvhNode>& getNodes()const { return m_nodes; }
+		inline size_t getNumTriangles()const { return m_triangleIds.size(); }
+		AABB getBounds()const;
+	private:
+		struct Triangle {
+			glm::vec3 v0, edge1, edge2;
+		};
+		std::vector<BvhNode> m_nodes;
+		std::vector<Triangle> m_triangles; //Leaf order
+		std::vector<int> m_triangleIds; //Source index of each entry in m_triangles
+	};
+
+	struct BvhInstance {
+		const MeshBvh* bvh = nullptr;
+		glm::mat4 transform = glm::mat4(1.0f); //Model -> world
+	};
+
+	/// <summary>
+	/// Top level BVH over instances of MeshBvhs. Rays are moved into each instance's model space, so
+	/// moving an instance only needs this (cheap) level rebuilt.
+	/// </summary>
+	class SceneBvh {
+	public:
+		void build(const std::vector<BvhInstance>& instances, BvhBuildStats* stats = nullptr);
+		//Closest hit across all instances, with RayHit::instance set to the index passed to build()
+		bool intersect(const Ray& ray, RayHit* hit)const;
+		bool occluded(const Ray& ray)const;
+		void intersect4(const Ray rays[4], RayHit hits[4])const;
+		inline size_t getNumInstances()const { return m_instances.size(); }
+	private:
+		std::vector<BvhNode> m_nodes;
+		std::vector<BvhInstance> m_instances; //Leaf order
+		std::vector<glm::mat4> m_worldToModel; //Leaf order
+		std::vector<int> m_instanceIds; //Index passed to build() for each entry
+	};
+
+	/// <summary>
+	/// World space ray through a point on the camera's image, for mouse picking.
+	/// </summary>
+	/// <param name="ndcX">-1 = left edge, 1 = right edge</param>
+	/// <param name="ndcY">-1 = bottom edge, 1 = top edge</param>
+	Ray cameraRay(const Camera& camera, float ndcX, float ndcY);
+}
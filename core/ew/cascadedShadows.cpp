@@ -0,0 +1,249 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "cascadedShadows.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace ew {
+	namespace {
+		float cross2(const glm::vec2& o, const glm::vec2& a, const glm::vec2& b) {
+			return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+		}
+
+		//Area of the convex hull of points (monotone chain), in the points' units
+		float convexHullArea(std::vector<glm::vec2> points) {
+			std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b) {
+				return a.x < b.x || (a.x == b.x && a.y < b.y);
+			});
+			std::vector<glm::vec2> hull(points.size() * 2);
+			size_t k = 0;
+			for (size_t i = 0; i < points.size(); i++)
+			{
+				while (k >= 2 && cross2(hull[k - 2], hull[k - 1], points[i]) <= 0.0f) {
+					k--;
+				}
+				hull[k++] = points[i];
+			}
+			for (size_t i = points.size() - 1, lower = k + 1; i-- > 0;)
+			{
+				while (k >= lower && cross2(hull[k - 2], hull[k - 1], points[i]) <= 0.0f) {
+					k--;
+				}
+				hull[k++] = points[i];
+			}
+			float area = 0.0f;
+			for (size_t i = 0; i + 1 < k; i++)
+			{
+				area += hull[i].x * hull[i + 1].y - hull[i + 1].x * hull[i].y;
+			}
+			return fabsf(area) * 0.5f;
+		}
+	}
+
+	CascadedShadowMap::CascadedShadowMap(const CascadeSettings& settings)
+	{
+		for (int i = 0; i < SHADOW_MAX_CASCADES; i++)
+		{
+			m_lightMatrices[i] = glm::mat4(1.0f);
+		}
+		setSettings(settings);
+	}
+
+	CascadedShadowMap::~CascadedShadowMap()
+	{
+		deleteTargets();
+	}
+
+	void CascadedShadowMap::setSettings(const CascadeSettings& settings)
+	{
+		m_settings = settings;
+		m_numCascades = std::min(std::max(settings.numCascades, 1), SHADOW_MAX_CASCADES);
+		if (m_settings.resolution != m_allocatedResolution || m_numCascades != m_allocatedCascades) {
+			deleteTargets();
+			createTargets();
+		}
+	}
+
+	void CascadedShadowMap::createTargets()
+	{
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_depthTexture);
+		glTextureStorage3D(m_depthTexture, 1, GL_DEPTH_COMPONENT32F, m_settings.resolution, m_settings.resolution, m_numCascades);
+		glTextureParameteri(m_depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(m_depthTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTextureParameteri(m_depthTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		//Outside the map reads as far away, so unlit
+		float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glTextureParameterfv(m_depthTexture, GL_TEXTURE_BORDER_COLOR, borderColor);
+		glCreateFramebuffers(1, &m_fbo);
+		//Depth only
+		glNamedFramebufferDrawBuffer(m_fbo, GL_NONE);
+		glNamedFramebufferReadBuffer(m_fbo, GL_NONE);
+		m_allocatedResolution = m_settings.resolution;
+		m_allocatedCascades = m_numCascades;
+	}
+
+	void CascadedShadowMap::deleteTargets()
+	{
+		if (m_depthTexture != 0) {
+			glDeleteTextures(1, &m_depthTexture);
+			forgetTexture(m_depthTexture);
+			glDeleteFramebuffers(1, &m_fbo);
+		}
+		m_depthTexture = 0;
+		m_fbo = 0;
+		m_allocatedResolution = 0;
+		m_allocatedCascades = 0;
+	}
+
+	void CascadedShadowMap::update(const Camera& camera, const glm::vec3& lightDirection)
+	{
+		float nearPlane = camera.nearPlane;
+		float farPlane = std::max(std::min(camera.farPlane, m_settings.maxDistance), nearPlane * 2.0f);
+		glm::mat4 inverseView = glm::inverse(camera.viewMatrix());
+		m_cameraForward = glm::normalize(camera.target - camera.position);
+		//Half size of the view at depth 1 (perspective) or at any depth (orthographic)
+		float halfHeight = camera.orthographic ? camera.orthoHeight * 0.5f : tanf(glm::radians(camera.fov) * 0.5f);
+		float halfWidth = halfHeight * camera.aspectRatio;
+		float cornerOffsetSq = halfWidth * halfWidth + halfHeight * halfHeight;
+
+		//Rotation only, so light space is the same for every cascade and every frame while the light holds still
+		glm::vec3 direction = glm::normalize(lightDirection);
+		glm::vec3 up = fabsf(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+		bool changed = m_stats.numCascades != m_numCascades;
+		m_stats.numCascades = m_numCascades;
+		float sliceNear = nearPlane;
+		for (int i = 0; i < m_numCascades; i++)
+		{
+			//Practical split scheme: a blend of logarithmic and uniform
+			float t = (float)(i + 1) / m_numCascades;
+			float logSplit = nearPlane * powf(farPlane / nearPlane, t);
+			float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+			float sliceFar = m_settings.splitLambda * logSplit + (1.0f - m_settings.splitLambda) * uniformSplit;
+
+			//Slice corners in world space
+			glm::vec3 corners[8];
+			for (int c = 0; c < 8; c++)
+			{
+				float sliceDepth = (c & 4) ? sliceFar : sliceNear;
+				float scale = camera.orthographic ? 1.0f : sliceDepth;
+				glm::vec4 viewCorner = glm::vec4(((c & 1) ? 1.0f : -1.0f) * halfWidth * scale, ((c & 2) ? 1.0f : -1.0f) * halfHeight * scale, -sliceDepth, 1.0f);
+				corners[c] = glm::vec3(inverseView * viewCorner);
+			}
+
+			glm::vec3 center;
+			float radius; //Half width of the map
+			float depthRadius; //Half depth of the slice along the light
+			if (m_settings.stableFit) {
+				//Smallest sphere around the slice. Its center is on the view axis, where the near and far corners are equally far away.
+				//It only depends on the slice's depths and the field of view, so turning the camera never resizes it.
+				float nearOffsetSq = cornerOffsetSq * (camera.orthographic ? 1.0f : sliceNear * sliceNear);
+				float farOffsetSq = cornerOffsetSq * (camera.orthographic ? 1.0f : sliceFar * sliceFar);
+				float centerDepth = (sliceFar * sliceFar + farOffsetSq - sliceNear * sliceNear - nearOffsetSq) / (2.0f * (sliceFar - sliceNear));
+				centerDepth = std::min(std::max(centerDepth, sliceNear), sliceFar);
+				radius = std::max(sqrtf((centerDepth - sliceNear) * (centerDepth - sliceNear) + nearOffsetSq),
+					sqrtf((sliceFar - centerDepth) * (sliceFar - centerDepth) + farOffsetSq));
+				depthRadius = radius;
+				center = glm::vec3(lightRotation * glm::vec4(camera.position + m_cameraForward * centerDepth, 1.0f));
+			}
+			else {
+				//Square around the corners in light space. Tighter, but it resizes as the camera turns.
+				glm::vec3 minBounds = glm::vec3(FLT_MAX);
+				glm::vec3 maxBounds = glm::vec3(-FLT_MAX);
+				for (int c = 0; c < 8; c++)
+				{
+					glm::vec3 lightCorner = glm::vec3(lightRotation * glm::vec4(corners[c], 1.0f));
+					minBounds = glm::min(minBounds, lightCorner);
+					maxBounds = glm::max(maxBounds, lightCorner);
+				}
+				glm::vec3 extents = (maxBounds - minBounds) * 0.5f;
+				radius = std::max(extents.x, extents.y);
+				depthRadius = extents.z;
+				center = (minBounds + maxBounds) * 0.5f;
+			}
+			//Rounded up, so float noise in the inputs can't change the texel size
+			radius = ceilf(radius * 16.0f) / 16.0f;
+			depthRadius = ceilf(depthRadius * 16.0f) / 16.0f;
+			//Plus a texel, for what snapping below can shift out
+			radius += radius * 2.0f / m_settings.resolution;
+			float texelSize = radius * 2.0f / m_settings.resolution;
+			depthRadius += texelSize;
+
+			//Snapped to whole texels in light space: as the camera moves, the map slides by whole texels and edges stay put.
+			//Depth too, so small moves leave the matrix exactly as it was.
+			center = glm::floor(center / texelSize) * texelSize;
+			//Light space looks down -z. The near plane backs off towards the light for casters between it and the slice.
+			float depth = -center.z;
+			glm::mat4 projection = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+				depth - depthRadius - m_settings.casterDistance, depth + depthRadius);
+			glm::mat4 lightMatrix = projection * lightRotation;
+			changed |= lightMatrix != m_lightMatrices[i];
+			m_lightMatrices[i] = lightMatrix;
+
+			//Depth clamp (see beginCascade) keeps casters nearer than the near plane, so culling ignores it too
+			m_frustums[i] = extractFrustum(lightMatrix);
+			m_frustums[i].planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			float depthRange = depthRadius * 2.0f + m_settings.casterDistance;
+			m_depthBias[i] = m_settings.biasTexels * texelSize / depthRange;
+
+			//How much of the map the slice covers: its corners in light clip space, against the [-1, 1] square
+			std::vector<glm::vec2> clipCorners;
+			for (int c = 0; c < 8; c++)
+			{
+				glm::vec4 clip = lightMatrix * glm::vec4(corners[c], 1.0f);
+				clipCorners.push_back(glm::clamp(glm::vec2(clip), glm::vec2(-1.0f), glm::vec2(1.0f)));
+			}
+			m_stats.splitDistances[i] = sliceFar;
+			m_stats.texelSize[i] = texelSize;
+			m_stats.utilization[i] = std::min(convexHullArea(clipCorners) / 4.0f, 1.0f);
+			sliceNear = sliceFar;
+		}
+		if (changed) {
+			m_stats.refits++;
+		}
+	}
+
+	size_t CascadedShadowMap::cullCasters(int cascade, const CullBounds& bounds, std::vector<int>* visible)
+	{
+		size_t count = frustumCull(m_frustums[cascade], bounds, CullShape::AABB, visible);
+		m_stats.casters[cascade] = (int)count;
+		return count;
+	}
+
+	void CascadedShadowMap::beginCascade(int cascade, bool clear)
+	{
+		glNamedFramebufferTextureLayer(m_fbo, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, cascade);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		glViewport(0, 0, m_settings.resolution, m_settings.resolution);
+		//Casters in front of the near plane are flattened onto it instead of clipped, so they still shadow the slice
+		glEnable(GL_DEPTH_CLAMP);
+		if (clear) {
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+	}
+
+	void CascadedShadowMap::end()
+	{
+		glDisable(GL_DEPTH_CLAMP);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void CascadedShadowMap::getUniforms(CascadeUniforms* uniforms)const
+	{
+		for (int i = 0; i < SHADOW_MAX_CASCADES; i++)
+		{
+			uniforms->lightMatrices[i] = m_lightMatrices[i];
+			uniforms->splits[i] = i < m_numCascades ? m_stats.splitDistances[i] : 0.0f;
+			uniforms->bias[i] = m_depthBias[i];
+		}
+		uniforms->cameraForward = m_cameraForward;
+		uniforms->numCascades = m_numCascades;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "camera.h"
+#include "frustum.h"
+#include "uniformBuffer.h"
+#include <vector>
+
+namespace ew {
+	struct CascadeSettings {
+		int numCascades = 3; //1 to SHADOW_MAX_CASCADES
+		int resolution = 2048; //Width and height of every cascade
+		float maxDistance = 30.0f; //View depth where shadows end, if nearer than the camera's far plane
+		float splitLambda = 0.75f; //0 = evenly spaced splits, 1 = logarithmic. In between trades near detail for far coverage.
+		float casterDistance = 20.0f; //How far each cascade's depth range reaches towards the light past its slice, for casters outside the view
+		float biasTexels = 1.5f; //Depth bias, in texels of each cascade, so it grows with the cascade instead of being one value for all
+		//Bound each slice with a sphere, which keeps its size as the camera turns, so edges don't shimmer.
+		//Off fits a square around the slice in light space instead: more of the map is used, but texels resize while turning.
+		bool stableFit = true;
+	};
+
+	struct CascadeStats {
+		int numCascades = 0;
+		float splitDistances[SHADOW_MAX_CASCADES] = {}; //Far edge of each cascade, as view depth
+		float texelSize[SHADOW_MAX_CASCADES] = {}; //World units per shadow texel
+		//Share of each cascade's texels that land on its slice of the view frustum. The rest are spent off screen.
+		float utilization[SHADOW_MAX_CASCADES] = {};
+		int casters[SHADOW_MAX_CASCADES] = {}; //Entries cullCasters() found for each cascade
+		int refits = 0; //update() calls where any light matrix changed
+	};
+
+	/// <summary>
+	/// Directional light shadows split into cascades along the view: each cascade covers one depth slice of the camera
+	/// frustum with its own orthographic light matrix, so near geometry gets small texels and far geometry still has shadows.
+	/// Each slice is bounded by a sphere (or a tighter square, see CascadeSettings::stableFit) whose center is snapped
+	/// to whole texels in light space, so moving the camera doesn't make shadow edges shimmer.
+	/// Cascades are layers of one depth texture array, sampled by the CASCADED_SHADOWS lit variant (see assets/ew/shadows.glsl).
+	/// </summary>
+	class CascadedShadowMap {
+	public:
+		CascadedShadowMap(const CascadeSettings& settings = CascadeSettings());
+		~CascadedShadowMap();
+		CascadedShadowMap(const CascadedShadowMap&) = delete;
+		CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+		//Reallocates the depth texture if the resolution or cascade count changed
+		void setSettings(const CascadeSettings& settings);
+		inline const CascadeSettings& getSettings()const { return m_settings; }
+		//Refits every cascade to the camera. lightDirection points from the light into the scene.
+		void update(const Camera& camera, const glm::vec3& lightDirection);
+		//Entries of bounds that can cast into a cascade, counted for stats
+		size_t cullCasters(int cascade, const CullBounds& bounds, std::vector<int>* visible);
+		//Binds the cascade's layer as the depth target and sets the viewport to it.
+		//Clear is off when the layer was just filled some other way, like from a ShadowCache.
+		void beginCascade(int cascade, bool clear = true);
+		//Rebinds the default framebuffer. The viewport is left for the caller to restore.
+		void end();
+		void getUniforms(CascadeUniforms* uniforms)const;
+		inline int getNumCascades()const { return m_numCascades; }
+		inline const glm::mat4& getLightMatrix(int cascade)const { return m_lightMatrices[cascade]; }
+		inline const Frustum& getFrustum(int cascade)const { return m_frustums[cascade]; }
+		//GL_TEXTURE_2D_ARRAY, one layer per cascade
+		inline unsigned int getDepthTexture()const { return m_depthTexture; }
+		inline const CascadeStats& getStats()const { return m_stats; }
+	private:
+		void createTargets();
+		void deleteTargets();
+
+		CascadeSettings m_settings;
+		int m_numCascades = 0;
+		int m_allocatedResolution = 0;
+		int m_allocatedCascades = 0;
+		unsigned int m_depthTexture = 0;
+		unsigned int m_fbo = 0;
+		glm::mat4 m_lightMatrices[SHADOW_MAX_CASCADES];
+		Frustum m_frustums[SHADOW_MAX_CASCADES];
+		float m_depthBias[SHADOW_MAX_CASCADES] = {};
+		glm::vec3 m_cameraForward = glm::vec3(0.0f, 0.0f, -1.0f);
+		CascadeStats m_stats;
+	};
+}
@@ -0,0 +1,100 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "dynamicMesh.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <string.h>
+
+namespace ew {
+	DynamicMesh::DynamicMesh(unsigned int maxVertices, unsigned int maxIndices)
+	{
+		create(maxVertices, maxIndices);
+	}
+	/// <summary>
+	/// Allocates immutable, persistently mapped storage for DYNAMIC_MESH_FRAMES copies of the mesh
+	/// </summary>
+	/// <param name="maxVertices">Vertex capacity of a single frame</param>
+	/// <param name="maxIndices">Index capacity of a single frame</param>
+	void DynamicMesh::create(unsigned int maxVertices, unsigned int maxIndices)
+	{
+		if (m_initialized)
+			return;
+		m_maxVertices = maxVertices;
+		m_maxIndices = maxIndices;
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr vertexBytes = sizeof(Vertex) * maxVertices * DYNAMIC_MESH_FRAMES;
+		GLsizeiptr indexBytes = sizeof(unsigned int) * maxIndices * DYNAMIC_MESH_FRAMES;
+
+		glGenVertexArrays(1, &m_vao);
+		bindVertexArray(m_vao);
+
+		glGenBuffers(1, &m_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glBufferStorage(GL_ARRAY_BUFFER, vertexBytes, NULL, flags);
+		m_mappedVertices = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexBytes, flags);
+
+		glGenBuffers(1, &m_ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+		glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, flags);
+		m_mappedIndices = (unsigned int*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, flags);
+
+		setVertexAttributes();
+
+		bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+		m_segment = DYNAMIC_MESH_FRAMES - 1;
+		m_initialized = true;
+	}
+	void DynamicMesh::beginUpdate()
+	{
+		m_segment = (m_segment + 1) % DYNAMIC_MESH_FRAMES;
+		GLsync fence = (GLsync)m_fences[m_segment];
+		if (fence == NULL)
+			return;
+		//Poll first so we only count real stalls
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			m_numStalls++;
+			while (result == GL_TIMEOUT_EXPIRED) {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); //1ms
+			}
+		}
+		glDeleteSync(fence);
+		m_fences[m_segment] = NULL;
+	}
+	void DynamicMesh::endUpdate(unsigned int numVertices, unsigned int numIndices)
+	{
+		m_numVertices = numVertices < m_maxVertices ? numVertices : m_maxVertices;
+		m_numIndices = numIndices < m_maxIndices ? numIndices : m_maxIndices;
+	}
+	void DynamicMesh::load(const MeshData& meshData)
+	{
+		beginUpdate();
+		unsigned int numVertices = meshData.vertices.size() < m_maxVertices ? meshData.vertices.size() : m_maxVertices;
+		unsigned int numIndices = meshData.indices.size() < m_maxIndices ? meshData.indices.size() : m_maxIndices;
+		memcpy(getVertices(), meshData.vertices.data(), sizeof(Vertex) * numVertices);
+		memcpy(getIndices(), meshData.indices.data(), sizeof(unsigned int) * numIndices);
+		endUpdate(numVertices, numIndices);
+	}
+	void DynamicMesh::draw(ew::DrawMode drawMode)
+	{
+		bindVertexArray(m_vao);
+		if (drawMode == DrawMode::TRIANGLES) {
+			const void* firstIndex = (const void*)(sizeof(unsigned int) * m_maxIndices * m_segment);
+			glDrawElementsBaseVertex(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, firstIndex, m_maxVertices * m_segment);
+		}
+		else {
+			glDrawArrays(GL_POINTS, m_maxVertices * m_segment, m_numVertices);
+		}
+		//Replacing the fence is fine when a segment is drawn in several passes: the newest fence covers every earlier draw
+		if (m_fences[m_segment] != NULL) {
+			glDeleteSync((GLsync)m_fences[m_segment]);
+		}
+		m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
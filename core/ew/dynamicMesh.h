@@ -0,0 +1,52 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	//Number of ring segments. CPU writes one while the GPU may still be reading the other two.
+	const int DYNAMIC_MESH_FRAMES = 3;
+
+	/// <summary>
+	/// Mesh for geometry that is rewritten every frame (skinning, procedural deformation).
+	/// Storage is allocated once with glBufferStorage and stays persistently mapped, so producers write
+	/// straight into GPU-visible memory with no intermediate copy.
+	/// </summary>
+	class DynamicMesh {
+	public:
+		DynamicMesh() {};
+		DynamicMesh(unsigned int maxVertices, unsigned int maxIndices);
+		void create(unsigned int maxVertices, unsigned int maxIndices);
+		//Advances to the next ring segment, waiting on its fence if the GPU is still reading it.
+		//Write into getVertices()/getIndices() afterwards, then call endUpdate.
+		void beginUpdate();
+		void endUpdate(unsigned int numVertices, unsigned int numIndices);
+		//Convenience: beginUpdate + copy + endUpdate
+		void load(const MeshData& meshData);
+		void draw(DrawMode drawMode = DrawMode::TRIANGLES);
+		inline Vertex* getVertices()const { return m_mappedVertices + m_segment * m_maxVertices; }
+		inline unsigned int* getIndices()const { return m_mappedIndices + m_segment * m_maxIndices; }
+		inline unsigned int getMaxVertices()const { return m_maxVertices; }
+		inline unsigned int getMaxIndices()const { return m_maxIndices; }
+		inline int getNumVertices()const { return m_numVertices; }
+		inline int getNumIndices()const { return m_numIndices; }
+		//Number of times beginUpdate had to block because the ring caught up with the GPU
+		inline unsigned int getNumStalls()const { return m_numStalls; }
+	private:
+		bool m_initialized = false;
+		unsigned int m_vao = 0;
+		unsigned int m_vbo = 0;
+		unsigned int m_ebo = 0;
+		unsigned int m_maxVertices = 0;
+		unsigned int m_maxIndices = 0;
+		unsigned int m_numVertices = 0;
+		unsigned int m_numIndices = 0;
+		int m_segment = 0;
+		Vertex* m_mappedVertices = nullptr;
+		unsigned int* m_mappedIndices = nullptr;
+		void* m_fences[DYNAMIC_MESH_FRAMES] = {}; //GLsync per segment
+		unsigned int m_numStalls = 0;
+	};
+}
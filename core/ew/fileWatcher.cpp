@@ -0,0 +1,144 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "fileWatcher.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace ew {
+	double getFileModifiedTime(const std::string& filePath)
+	{
+		struct stat st;
+		if (stat(filePath.c_str(), &st) != 0)
+			return 0.0;
+#if defined(__linux__)
+		return (double)st.st_mtim.tv_sec + (double)st.st_mtim.tv_nsec * 1e-9;
+#elif defined(__APPLE__)
+		return (double)st.st_mtimespec.tv_sec + (double)st.st_mtimespec.tv_nsec * 1e-9;
+#else
+		return (double)st.st_mtime;
+#endif
+	}
+
+	double getWallClockTime()
+	{
+		return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	static double steadyTime() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static int64_t fileSize(const std::string& filePath) {
+		struct stat st;
+		if (stat(filePath.c_str(), &st) != 0)
+			return -1;
+		return (int64_t)st.st_size;
+	}
+
+	static void addChanged(std::vector<std::string>* changedFiles, const std::string& path) {
+		if (std::find(changedFiles->begin(), changedFiles->end(), path) == changedFiles->end())
+			changedFiles->push_back(path);
+	}
+
+	FileWatcher::FileWatcher()
+	{
+#ifdef __linux__
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotify < 0) {
+			printf("Failed to start inotify, falling back to polling file times");
+		}
+#endif
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+#ifdef __linux__
+		if (m_inotify >= 0)
+			close(m_inotify);
+#endif
+	}
+
+	void FileWatcher::watch(const std::string& filePath)
+	{
+		for (size_t i = 0; i < m_files.size(); i++)
+		{
+			if (m_files[i].path == filePath)
+				return;
+		}
+		WatchedFile file;
+		file.path = filePath;
+		size_t slash = filePath.find_last_of("/\\");
+		file.name = slash == std::string::npos ? filePath : filePath.substr(slash + 1);
+		file.modifiedTime = getFileModifiedTime(filePath);
+		file.size = fileSize(filePath);
+#ifdef __linux__
+		if (m_inotify >= 0) {
+			//Editors often save by renaming a new file over the old one, which a watch on the file itself would lose.
+			//Watching the folder sees both. inotify returns the same descriptor for a folder that is already watched.
+			std::string directory = slash == std::string::npos ? std::string(".") : filePath.substr(0, slash + 1);
+			file.watchDescriptor = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (file.watchDescriptor < 0) {
+				printf("Failed to watch %s, polling it instead", directory.c_str());
+			}
+		}
+#endif
+		m_files.push_back(file);
+	}
+
+	bool FileWatcher::isUsingEvents() const
+	{
+		return m_inotify >= 0;
+	}
+
+	void FileWatcher::poll(std::vector<std::string>* changedFiles)
+	{
+#ifdef __linux__
+		if (m_inotify >= 0) {
+			//Aligned for the event structs read into it
+			alignas(struct inotify_event) char buffer[4096];
+			ssize_t length;
+			while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+				for (char* ptr = buffer; ptr < buffer + length; )
+				{
+					const struct inotify_event* event = (const struct inotify_event*)ptr;
+					ptr += sizeof(struct inotify_event) + event->len;
+					if (event->len == 0)
+						continue;
+					for (size_t i = 0; i < m_files.size(); i++)
+					{
+						if (m_files[i].watchDescriptor == event->wd && m_files[i].name == event->name)
+							addChanged(changedFiles, m_files[i].path);
+					}
+				}
+			}
+		}
+#endif
+		//Files without an event watch are compared by time and size
+		double now = steadyTime();
+		if (now - m_lastPollTime < m_pollInterval)
+			return;
+		m_lastPollTime = now;
+		for (size_t i = 0; i < m_files.size(); i++)
+		{
+			WatchedFile& file = m_files[i];
+			if (file.watchDescriptor >= 0)
+				continue;
+			double modifiedTime = getFileModifiedTime(file.path);
+			int64_t size = fileSize(file.path);
+			if (modifiedTime != file.modifiedTime || size != file.size) {
+				file.modifiedTime = modifiedTime;
+				file.size = size;
+				addChanged(changedFiles, file.path);
+			}
+		}
+	}
+}
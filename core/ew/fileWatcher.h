@@ -0,0 +1,49 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ew {
+	//Last write time of a file in seconds since the Unix epoch, or 0 if it can't be read.
+	//Sub-second precision where the platform's stat has it (Linux, macOS), whole seconds elsewhere.
+	double getFileModifiedTime(const std::string& filePath);
+	//Same clock as getFileModifiedTime
+	double getWallClockTime();
+
+	/// <summary>
+	/// Reports files that were written since the last poll, without ever blocking.
+	/// Linux uses inotify on each file's folder, so files saved by writing a temp file and renaming it are caught too.
+	/// Other platforms compare stat() results, at most once per pollInterval.
+	/// </summary>
+	class FileWatcher {
+	public:
+		FileWatcher();
+		~FileWatcher();
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+		//Watching a file twice does nothing
+		void watch(const std::string& filePath);
+		//Appends each changed file once, by the path it was watched with
+		void poll(std::vector<std::string>* changedFiles);
+		//True when changes arrive as events instead of by polling
+		bool isUsingEvents()const;
+		inline size_t getNumWatched()const { return m_files.size(); }
+		inline void setPollInterval(double seconds) { m_pollInterval = seconds; }
+	private:
+		struct WatchedFile {
+			std::string path;
+			std::string name; //After the last slash
+			int watchDescriptor = -1; //inotify watch on the file's folder
+			double modifiedTime = 0.0;
+			int64_t size = -1;
+		};
+		std::vector<WatchedFile> m_files;
+		int m_inotify = -1;
+		double m_pollInterval = 0.25;
+		double m_lastPollTime = 0.0;
+	};
+}
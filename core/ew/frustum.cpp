@@ -0,0 +1,163 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "frustum.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_FRUSTUM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	Frustum extractFrustum(const glm::mat4& viewProjection)
+	{
+		//Gribb-Hartmann: rows of the matrix combine into the clip planes -w <= x, y, z <= w
+		const glm::mat4& m = viewProjection;
+		glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0;
+		frustum.planes[1] = row3 - row0;
+		frustum.planes[2] = row3 + row1;
+		frustum.planes[3] = row3 - row1;
+		frustum.planes[4] = row3 + row2;
+		frustum.planes[5] = row3 - row2;
+		for (int i = 0; i < 6; i++)
+		{
+			glm::vec4& p = frustum.planes[i];
+			float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+			if (length > 0.0f)
+				p = p * (1.0f / length);
+		}
+		return frustum;
+	}
+
+	void CullBounds::clear()
+	{
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		extentX.clear();
+		extentY.clear();
+		extentZ.clear();
+		radius.clear();
+	}
+
+	void CullBounds::reserve(size_t count)
+	{
+		centerX.reserve(count);
+		centerY.reserve(count);
+		centerZ.reserve(count);
+		extentX.reserve(count);
+		extentY.reserve(count);
+		extentZ.reserve(count);
+		radius.reserve(count);
+	}
+
+	void CullBounds::add(const AABB& worldBounds)
+	{
+		glm::vec3 c = worldBounds.center();
+		glm::vec3 e = worldBounds.extents();
+		centerX.push_back(c.x);
+		centerY.push_back(c.y);
+		centerZ.push_back(c.z);
+		extentX.push_back(e.x);
+		extentY.push_back(e.y);
+		extentZ.push_back(e.z);
+		radius.push_back(sqrtf(e.x * e.x + e.y * e.y + e.z * e.z));
+	}
+
+	void CullBounds::add(const BoundingSphere& worldSphere)
+	{
+		centerX.push_back(worldSphere.center.x);
+		centerY.push_back(worldSphere.center.y);
+		centerZ.push_back(worldSphere.center.z);
+		extentX.push_back(worldSphere.radius);
+		extentY.push_back(worldSphere.radius);
+		extentZ.push_back(worldSphere.radius);
+		radius.push_back(worldSphere.radius);
+	}
+
+	//Scalar test for one entry, also used for the tail that doesn't fill an SSE register
+	static inline bool isVisible(const Frustum& frustum, const CullBounds& b, CullShape shape, size_t i) {
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = plane.x * b.centerX[i] + plane.y * b.centerY[i] + plane.z * b.centerZ[i] + plane.w;
+			float r = shape == CullShape::SPHERE ? b.radius[i]
+				: fabsf(plane.x) * b.extentX[i] + fabsf(plane.y) * b.extentY[i] + fabsf(plane.z) * b.extentZ[i];
+			if (distance + r < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	size_t frustumCull(const Frustum& frustum, const CullBounds& bounds, CullShape shape, std::vector<int>* visible, CullStats* stats)
+	{
+		visible->clear();
+		const size_t count = bounds.size();
+		size_t i = 0;
+#ifdef EW_FRUSTUM_SSE2
+		//Plane coefficients splatted once per call
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m128 absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			planeX[p] = _mm_set1_ps(plane.x);
+			planeY[p] = _mm_set1_ps(plane.y);
+			planeZ[p] = _mm_set1_ps(plane.z);
+			planeW[p] = _mm_set1_ps(plane.w);
+			absX[p] = _mm_set1_ps(fabsf(plane.x));
+			absY[p] = _mm_set1_ps(fabsf(plane.y));
+			absZ[p] = _mm_set1_ps(fabsf(plane.z));
+		}
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+			__m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+			__m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+			__m128 ex = zero, ey = zero, ez = zero, r = zero;
+			if (shape == CullShape::SPHERE) {
+				r = _mm_loadu_ps(&bounds.radius[i]);
+			}
+			else {
+				ex = _mm_loadu_ps(&bounds.extentX[i]);
+				ey = _mm_loadu_ps(&bounds.extentY[i]);
+				ez = _mm_loadu_ps(&bounds.extentZ[i]);
+			}
+			//Lanes stay set while they are in front of every plane so far
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+				if (shape != CullShape::SPHERE) {
+					r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+				}
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+			}
+			int mask = _mm_movemask_ps(inside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (mask & (1 << lane))
+					visible->push_back((int)(i + lane));
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			if (isVisible(frustum, bounds, shape, i))
+				visible->push_back((int)i);
+		}
+		if (stats) {
+			stats->tested = (int)count;
+			stats->visible = (int)visible->size();
+		}
+		return visible->size();
+	}
+}
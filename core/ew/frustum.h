@@ -0,0 +1,59 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "bounds.h"
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Six normalized planes (xyz = normal pointing inward, w = distance). Inside when dot(normal, p) + w >= 0.
+	/// </summary>
+	struct Frustum {
+		glm::vec4 planes[6]; //Left, right, bottom, top, near, far
+	};
+
+	/// <summary>
+	/// Extracts world space planes from a combined projection * view matrix.
+	/// Works for perspective cameras (camera.projectionMatrix() * camera.viewMatrix()) and orthographic light matrices alike.
+	/// </summary>
+	Frustum extractFrustum(const glm::mat4& viewProjection);
+
+	enum class CullShape {
+		AABB = 0,
+		SPHERE = 1
+	};
+
+	/// <summary>
+	/// World space bounds stored as structure-of-arrays for SIMD culling.
+	/// Every entry has a box (center + extents) and a sphere radius, so either shape can be tested.
+	/// </summary>
+	struct CullBounds {
+		std::vector<float> centerX, centerY, centerZ;
+		std::vector<float> extentX, extentY, extentZ;
+		std::vector<float> radius;
+
+		void clear();
+		void reserve(size_t count);
+		void add(const AABB& worldBounds);
+		void add(const BoundingSphere& worldSphere);
+		inline size_t size()const { return centerX.size(); }
+	};
+
+	struct CullStats {
+		int tested = 0;
+		int visible = 0;
+	};
+
+	/// <summary>
+	/// Tests every entry in bounds against the frustum, 4 per SSE2 instruction.
+	/// </summary>
+	/// <param name="frustum">Camera or light frustum</param>
+	/// <param name="bounds">World space bounds</param>
+	/// <param name="shape">Test boxes or spheres</param>
+	/// <param name="visible">Filled with indices into bounds that are at least partly inside, in increasing order. Will be cleared.</param>
+	/// <param name="stats">Optional tested/visible counts</param>
+	/// <returns>Number of visible entries</returns>
+	size_t frustumCull(const Frustum& frustum, const CullBounds& bounds, CullShape shape, std::vector<int>* visible, CullStats* stats = nullptr);
+}
@@ -0,0 +1,172 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "glState.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	namespace {
+		//Never a valid GL name, so the next bind after invalidation is always issued
+		const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+		struct CachedState {
+			unsigned int program = UNKNOWN;
+			unsigned int vertexArray = UNKNOWN;
+			unsigned int textures[GL_STATE_MAX_TEXTURE_UNITS];
+			CachedState() {
+				for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++)
+				{
+					textures[i] = UNKNOWN;
+				}
+			}
+		};
+
+		CachedState state;
+		GLStateStats stats;
+		bool debugMode = false;
+
+		/// <summary>
+		/// Debug mode: compares a cached binding with what GL reports. Unknown bindings can't be wrong.
+		/// On a mismatch the cache takes GL's value, so the bind that follows is judged correctly.
+		/// </summary>
+		void verify(const char* what, unsigned int* cached, unsigned int actual) {
+			if (*cached == UNKNOWN || *cached == actual) {
+				return;
+			}
+			printf("GL state desync: %s cached as %u but bound to %u", what, *cached, actual);
+			stats.desyncs++;
+			*cached = actual;
+		}
+
+		unsigned int queryTexture(unsigned int unit, unsigned int cached) {
+			GLint activeTexture, binding2D, binding2DArray;
+			glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glGetIntegerv(GL_TEXTURE_BINDING_2D, &binding2D);
+			glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &binding2DArray);
+			glActiveTexture(activeTexture);
+			//A unit holds one texture per target, so either one matching the cache is in sync
+			if ((unsigned int)binding2DArray == cached) {
+				return binding2DArray;
+			}
+			return binding2D;
+		}
+	}
+
+	void useProgram(unsigned int program)
+	{
+		if (debugMode) {
+			GLint current;
+			glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+			verify("program", &state.program, current);
+		}
+		if (program == state.program) {
+			stats.programsElided++;
+			return;
+		}
+		glUseProgram(program);
+		state.program = program;
+		stats.programsIssued++;
+	}
+
+	void bindVertexArray(unsigned int vao)
+	{
+		if (debugMode) {
+			GLint current;
+			glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &current);
+			verify("vertex array", &state.vertexArray, current);
+		}
+		if (vao == state.vertexArray) {
+			stats.vertexArraysElided++;
+			return;
+		}
+		glBindVertexArray(vao);
+		state.vertexArray = vao;
+		stats.vertexArraysIssued++;
+	}
+
+	void bindTextureUnit(unsigned int unit, unsigned int texture)
+	{
+		if (unit >= GL_STATE_MAX_TEXTURE_UNITS) {
+			glBindTextureUnit(unit, texture);
+			stats.texturesIssued++;
+			return;
+		}
+		unsigned int* cached = &state.textures[unit];
+		if (debugMode) {
+			verify("texture unit", cached, queryTexture(unit, *cached));
+		}
+		if (texture == *cached) {
+			stats.texturesElided++;
+			return;
+		}
+		glBindTextureUnit(unit, texture);
+		*cached = texture;
+		stats.texturesIssued++;
+	}
+
+	void invalidateGLState()
+	{
+		state = CachedState();
+	}
+
+	void forgetProgram(unsigned int program)
+	{
+		if (state.program == program) {
+			state.program = UNKNOWN;
+		}
+	}
+
+	void forgetVertexArray(unsigned int vao)
+	{
+		if (state.vertexArray == vao) {
+			state.vertexArray = UNKNOWN;
+		}
+	}
+
+	void forgetTexture(unsigned int texture)
+	{
+		for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++)
+		{
+			if (state.textures[i] == texture) {
+				state.textures[i] = UNKNOWN;
+			}
+		}
+	}
+
+	void setGLStateDebug(bool enabled)
+	{
+		debugMode = enabled;
+	}
+
+	bool isGLStateDebug()
+	{
+		return debugMode;
+	}
+
+	const GLStateStats& getGLStateStats()
+	{
+		return stats;
+	}
+
+	void resetGLStateStats()
+	{
+		stats = GLStateStats();
+	}
+
+	bool isGLExtensionSupported(const char* name)
+	{
+		GLint numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (GLint i = 0; i < numExtensions; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension && strcmp(extension, name) == 0)
+				return true;
+		}
+		return false;
+	}
+}
@@ -0,0 +1,45 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+
+namespace ew {
+	const int GL_STATE_MAX_TEXTURE_UNITS = 32; //Units past this are always bound, never cached
+
+	struct GLStateStats {
+		//Issued = reached GL, elided = skipped because GL already had that binding
+		int programsIssued = 0;
+		int programsElided = 0;
+		int vertexArraysIssued = 0;
+		int vertexArraysElided = 0;
+		int texturesIssued = 0;
+		int texturesElided = 0;
+		int desyncs = 0; //Cache disagreed with glGet* (debug mode only)
+		inline int issued()const { return programsIssued + vertexArraysIssued + texturesIssued; }
+		inline int elided()const { return programsElided + vertexArraysElided + texturesElided; }
+	};
+
+	//Cached binds. Core code binds through these, so anything that binds directly with GL must call invalidateGLState() afterwards.
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+	//glBindTextureUnit. Tracks one texture per unit, whatever its target.
+	void bindTextureUnit(unsigned int unit, unsigned int texture);
+
+	//Forgets every cached binding, so the next bind of each kind is always issued
+	void invalidateGLState();
+	//Call when deleting a GL object. GL hands deleted names out again, so a cached binding of the old object
+	//would elide the first bind of the new one.
+	void forgetProgram(unsigned int program);
+	void forgetVertexArray(unsigned int vao);
+	void forgetTexture(unsigned int texture);
+	//Debug mode checks the cache against glGet* before every bind, reports desyncs and resyncs. Slow, since every check stalls on the driver.
+	void setGLStateDebug(bool enabled);
+	bool isGLStateDebug();
+	const GLStateStats& getGLStateStats();
+	//Call once per frame to get per-frame counts
+	void resetGLStateStats();
+
+	//Looks name up in the context's extension list (glGetStringi), e.g. "GL_EXT_texture_compression_s3tc"
+	bool isGLExtensionSupported(const char* name);
+}
@@ -0,0 +1,37 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "instanceBuffer.h"
+#include "external/glad.h"
+
+namespace ew {
+	InstanceBuffer::InstanceBuffer(size_t capacity)
+	{
+		create(capacity);
+	}
+	void InstanceBuffer::create(size_t capacity)
+	{
+		if (m_ssbo == 0) {
+			glGenBuffers(1, &m_ssbo);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ssbo);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * capacity, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_capacity = capacity;
+		m_count = 0;
+	}
+	void InstanceBuffer::update(const glm::mat4* modelMatrices, size_t count)
+	{
+		m_count = count < m_capacity ? count : m_capacity;
+		if (m_count == 0)
+			return;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ssbo);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::mat4) * m_count, modelMatrices);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	void InstanceBuffer::bind(unsigned int binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_ssbo);
+	}
+}
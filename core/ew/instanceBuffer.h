@@ -0,0 +1,32 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+#include <stddef.h>
+
+namespace ew {
+	//Shader storage binding that instanced vertex shaders read model matrices from
+	const unsigned int INSTANCE_BUFFER_BINDING = 0;
+
+	/// <summary>
+	/// GPU array of per-instance model matrices, read in the vertex shader as
+	/// layout(std430, binding = 0) readonly buffer InstanceBlock { mat4 _Models[]; }; indexed by gl_InstanceID.
+	/// </summary>
+	class InstanceBuffer {
+	public:
+		InstanceBuffer() {};
+		InstanceBuffer(size_t capacity);
+		void create(size_t capacity);
+		//Uploads count matrices starting at instance 0. Clamped to capacity.
+		void update(const glm::mat4* modelMatrices, size_t count);
+		void bind(unsigned int binding = INSTANCE_BUFFER_BINDING)const;
+		inline size_t getCapacity()const { return m_capacity; }
+		inline size_t getCount()const { return m_count; }
+	private:
+		unsigned int m_ssbo = 0;
+		size_t m_capacity = 0;
+		size_t m_count = 0;
+	};
+}
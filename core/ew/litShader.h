@@ -0,0 +1,24 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "shaderVariants.h"
+
+namespace ew {
+	//Feature bits of the shared lit shader, assets/ew/lit.vert + lit.frag
+	enum LitFeature {
+		LIT_INSTANCED = 1 << 0, //Model matrices from the InstanceBuffer, indexed by gl_InstanceID
+		LIT_SHADOWS = 1 << 1, //_ShadowMap lookup with _LightSpaceMatrix and _Bias
+		LIT_POINT_LIGHT = 1 << 2, //Light from _LightPos instead of _LightDirection
+		LIT_TEXTURE_ARRAY = 1 << 3, //_MainTex is a sampler2DArray, sampled at _Material.MainTexLayer
+		LIT_CASCADED_SHADOWS = 1 << 4, //_ShadowMap is a sampler2DArray of cascades from the ShadowData block. Replaces SHADOWS.
+		LIT_NORMAL_MAP = 1 << 5 //Tangent space _NormalMap, using the tangent attribute (location 3) from generateTangents
+	};
+
+	//Every variant of the shared lit shader. Expects FrameUniforms at UNIFORM_BLOCK_FRAME and MaterialUniforms at UNIFORM_BLOCK_MATERIAL,
+	//plus CascadeUniforms at UNIFORM_BLOCK_SHADOWS for CASCADED_SHADOWS.
+	inline ShaderVariants createLitShaderVariants() {
+		return ShaderVariants("assets/ew/lit.vert", "assets/ew/lit.frag", { "INSTANCED", "SHADOWS", "POINT_LIGHT", "TEXTURE_ARRAY", "CASCADED_SHADOWS", "NORMAL_MAP" });
+	}
+}
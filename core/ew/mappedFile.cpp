@@ -0,0 +1,82 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "mappedFile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ew {
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::open(const std::string& filePath)
+	{
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (!data) {
+			if (mapping)
+				CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		m_file = file;
+		m_mapping = mapping;
+		m_size = (size_t)size.QuadPart;
+#else
+		int file = ::open(filePath.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+		struct stat st;
+		if (fstat(file, &st) != 0 || st.st_size == 0) {
+			::close(file);
+			return false;
+		}
+		void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		//The mapping keeps the file alive on its own
+		::close(file);
+		if (data == MAP_FAILED)
+			return false;
+		m_size = (size_t)st.st_size;
+#endif
+		m_data = (const unsigned char*)data;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (!m_data)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle((HANDLE)m_mapping);
+		CloseHandle((HANDLE)m_file);
+#else
+		munmap((void*)m_data, m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+		m_file = nullptr;
+		m_mapping = nullptr;
+	}
+}
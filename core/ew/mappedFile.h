@@ -0,0 +1,30 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <stddef.h>
+#include <string>
+
+namespace ew {
+	/// <summary>
+	/// Read only memory mapping of a whole file. Pages are read from disk as they are touched, so nothing is copied up front.
+	/// </summary>
+	class MappedFile {
+	public:
+		MappedFile() {}
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		//Closes any file already open. False if the file is missing or empty.
+		bool open(const std::string& filePath);
+		void close();
+		inline const unsigned char* getData()const { return m_data; }
+		inline size_t getSize()const { return m_size; }
+	private:
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+		void* m_file = nullptr; //Windows file and mapping handles
+		void* m_mapping = nullptr;
+	};
+}
@@ -6,59 +6,155 @@
 */
 
 #include "mesh.h"
+#include "glState.h"
 #include "external/glad.h"
+#include <float.h>
+#include <stdio.h>
+#include <math.h>
 
 namespace ew {
+	void setVertexAttributes()
+	{
+		//Position attribute
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
+		glEnableVertexAttribArray(0);
+
+		//Normal attribute
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(1);
+
+		//UV attribute
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
+		glEnableVertexAttribArray(2);
+	}
+	void setTangentAttribute()
+	{
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (const void*)0);
+		glEnableVertexAttribArray(3);
+	}
+	void computeBounds(const MeshData* meshes, size_t count, AABB* aabb, BoundingSphere* sphere)
+	{
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+		for (size_t m = 0; m < count; m++)
+		{
+			const std::vector<Vertex>& vertices = meshes[m].vertices;
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				min = glm::min(min, vertices[i].pos);
+				max = glm::max(max, vertices[i].pos);
+			}
+		}
+		if (min.x > max.x) {
+			//No vertices
+			min = max = glm::vec3(0.0f);
+		}
+		aabb->min = min;
+		aabb->max = max;
+		//Tighter than the box's circumscribed sphere for round meshes
+		glm::vec3 center = aabb->center();
+		float radiusSq = 0.0f;
+		for (size_t m = 0; m < count; m++)
+		{
+			const std::vector<Vertex>& vertices = meshes[m].vertices;
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				glm::vec3 d = vertices[i].pos - center;
+				radiusSq = glm::max(radiusSq, glm::dot(d, d));
+			}
+		}
+		sphere->center = center;
+		sphere->radius = sqrtf(radiusSq);
+	}
 	Mesh::Mesh(const MeshData& meshData)
 	{
 		load(meshData);
 	}
 	void Mesh::load(const MeshData& meshData)
 	{
+		computeBounds(&meshData, 1, &m_bounds, &m_boundingSphere);
 		if (!m_initialized) {
 			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
+			bindVertexArray(m_vao);
 
 			glGenBuffers(1, &m_vbo);
 			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 
 			glGenBuffers(1, &m_ebo);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-			glEnableVertexAttribArray(0);
-
-			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-			glEnableVertexAttribArray(1);
-
-			//UV attribute
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(2);
+			setVertexAttributes();
 
 			m_initialized = true;
 		}
 
-		glBindVertexArray(m_vao);
+		bindVertexArray(m_vao);
 		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
 
+		//Reuse existing storage when the new data fits, only reallocate when it grows
 		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+			if (meshData.vertices.size() <= m_vertexCapacity) {
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data());
+			}
+			else {
+				glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+				m_vertexCapacity = meshData.vertices.size();
+			}
 		}
 		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+			if (meshData.indices.size() <= m_indexCapacity) {
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data());
+			}
+			else {
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+				m_indexCapacity = meshData.indices.size();
+			}
+		}
+		//One tangent per vertex, or the attribute would read past the end of the buffer
+		bool hasTangents = meshData.tangents.size() > 0 && meshData.tangents.size() == meshData.vertices.size();
+		if (meshData.tangents.size() > 0 && !hasTangents) {
+			printf("Failed to load tangents: %zu tangents for %zu vertices", meshData.tangents.size(), meshData.vertices.size());
+		}
+		if (hasTangents) {
+			if (m_tangentVbo == 0) {
+				glGenBuffers(1, &m_tangentVbo);
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, m_tangentVbo);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * meshData.tangents.size(), meshData.tangents.data(), GL_STATIC_DRAW);
+			m_tangentCapacity = meshData.tangents.size();
+			setTangentAttribute();
+		}
+		else if (m_tangentVbo != 0) {
+			//Falls back to the default attribute value
+			glDisableVertexAttribArray(3);
 		}
 		m_numVertices = meshData.vertices.size();
 		m_numIndices = meshData.indices.size();
 
-		glBindVertexArray(0);
+		bindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
+	void Mesh::unload()
+	{
+		if (!m_initialized) {
+			return;
+		}
+		glDeleteVertexArrays(1, &m_vao);
+		forgetVertexArray(m_vao);
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ebo);
+		if (m_tangentVbo != 0) {
+			glDeleteBuffers(1, &m_tangentVbo);
+		}
+		m_initialized = false;
+		m_vao = m_vbo = m_ebo = m_tangentVbo = 0;
+		m_numVertices = m_numIndices = 0;
+		m_vertexCapacity = m_indexCapacity = m_tangentCapacity = 0;
+	}
 	void Mesh::draw(ew::DrawMode drawMode) const
 	{
-		glBindVertexArray(m_vao);
+		bindVertexArray(m_vao);
 		if (drawMode == DrawMode::TRIANGLES) {
 			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
 		}
@@ -67,4 +163,14 @@ namespace ew {
 		}
 		
 	}
+	void Mesh::drawInstanced(int instanceCount, ew::DrawMode drawMode) const
+	{
+		bindVertexArray(m_vao);
+		if (drawMode == DrawMode::TRIANGLES) {
+			glDrawElementsInstanced(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL, instanceCount);
+		}
+		else {
+			glDrawArraysInstanced(GL_POINTS, 0, m_numVertices, instanceCount);
+		}
+	}
 }
\ No newline at end of file
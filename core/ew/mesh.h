@@ -3,6 +3,7 @@
 */
 
 #pragma once
+#include "bounds.h"
 #include <glm/glm.hpp>
 #include <vector>
 
@@ -16,6 +17,8 @@ namespace ew {
 	struct MeshData {
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
+		//Optional, one per vertex (xyz = tangent, w = bitangent sign). See generateTangents. Uploaded to attribute 3.
+		std::vector<glm::vec4> tangents;
 	};
 
 	enum class DrawMode {
@@ -23,20 +26,42 @@ namespace ew {
 		POINTS = 1
 	};
 
+	//Sets Vertex attribute layout on the currently bound VAO + GL_ARRAY_BUFFER
+	void setVertexAttributes();
+	//Sets the tangent attribute (location 3) on the currently bound VAO + GL_ARRAY_BUFFER
+	void setTangentAttribute();
+	//Model space box and sphere around every vertex in meshes[0, count). The sphere is centered on the box.
+	void computeBounds(const MeshData* meshes, size_t count, AABB* aabb, BoundingSphere* sphere);
+
 	class Mesh {
 	public:
 		Mesh() {};
 		Mesh(const MeshData& meshData);
 		void load(const MeshData& meshData);
+		//Deletes the GL objects. Copies of a Mesh share them, so every copy is unloaded too. load() works again afterwards.
+		void unload();
 		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		//Draws instanceCount copies in one call. Shaders tell them apart with gl_InstanceID (see InstanceBuffer).
+		void drawInstanced(int instanceCount, DrawMode drawMode = DrawMode::TRIANGLES)const;
 		inline int getNumVertices()const { return m_numVertices; }
 		inline int getNumIndices()const { return m_numIndices; }
+		//Allocated buffer storage, which can be more than the current data after a smaller reload
+		inline size_t getGPUBytes()const { return (size_t)m_vertexCapacity * sizeof(Vertex) + (size_t)m_indexCapacity * sizeof(unsigned int) + (size_t)m_tangentCapacity * sizeof(glm::vec4); }
+		//Model space bounds of the last loaded MeshData
+		inline const AABB& getBounds()const { return m_bounds; }
+		inline const BoundingSphere& getBoundingSphere()const { return m_boundingSphere; }
 	private:
 		bool m_initialized = false;
 		unsigned int m_vao = 0;
 		unsigned int m_vbo = 0;
 		unsigned int m_ebo = 0;
+		unsigned int m_tangentVbo = 0; //Only created once tangents are loaded
 		unsigned int m_numVertices = 0;
 		unsigned int m_numIndices = 0;
+		unsigned int m_vertexCapacity = 0; //Allocated size of m_vbo, in vertices
+		unsigned int m_indexCapacity = 0; //Allocated size of m_ebo, in indices
+		unsigned int m_tangentCapacity = 0; //Allocated size of m_tangentVbo, in tangents
+		AABB m_bounds;
+		BoundingSphere m_boundingSphere;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "meshCache.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace ew {
+	static const char COOKED_MESH_MAGIC[4] = { 'E', 'W', 'M', 'S' };
+	static const uint32_t COOKED_MESH_VERSION = 1;
+
+	struct CookedMeshHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint32_t numMeshes;
+		uint32_t vertexSize; //sizeof(Vertex) when cooked, guards against layout changes
+	};
+
+	struct CookedMeshEntry {
+		uint32_t numVertices;
+		uint32_t numIndices;
+		uint32_t hasTangents;
+	};
+
+	static bool getSourceInfo(const std::string& sourcePath, uint64_t* size, int64_t* modifiedTime) {
+		struct stat st;
+		if (stat(sourcePath.c_str(), &st) != 0)
+			return false;
+		*size = (uint64_t)st.st_size;
+		*modifiedTime = (int64_t)st.st_mtime;
+		return true;
+	}
+
+	bool saveCookedMeshes(const std::string& cookedPath, const std::string& sourcePath, const std::vector<MeshData>& meshes)
+	{
+		CookedMeshHeader header;
+		memcpy(header.magic, COOKED_MESH_MAGIC, 4);
+		header.version = COOKED_MESH_VERSION;
+		if (!getSourceInfo(sourcePath, &header.sourceSize, &header.sourceModifiedTime))
+			return false;
+		header.numMeshes = meshes.size();
+		header.vertexSize = sizeof(Vertex);
+
+		FILE* file = fopen(cookedPath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write cooked mesh %s", cookedPath.c_str());
+			return false;
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		for (size_t i = 0; i < meshes.size() && ok; i++)
+		{
+			const MeshData& mesh = meshes[i];
+			CookedMeshEntry entry;
+			entry.numVertices = mesh.vertices.size();
+			entry.numIndices = mesh.indices.size();
+			entry.hasTangents = mesh.tangents.size() == mesh.vertices.size() && !mesh.tangents.empty();
+			ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+			ok = ok && fwrite(mesh.vertices.data(), sizeof(Vertex), entry.numVertices, file) == entry.numVertices;
+			ok = ok && fwrite(mesh.indices.data(), sizeof(unsigned int), entry.numIndices, file) == entry.numIndices;
+			if (entry.hasTangents) {
+				ok = ok && fwrite(mesh.tangents.data(), sizeof(glm::vec4), entry.numVertices, file) == entry.numVertices;
+			}
+		}
+		fclose(file);
+		if (!ok) {
+			remove(cookedPath.c_str());
+		}
+		return ok;
+	}
+
+	bool loadCookedMeshes(const std::string& cookedPath, const std::string& sourcePath, std::vector<MeshData>* meshes)
+	{
+		FILE* file = fopen(cookedPath.c_str(), "rb");
+		if (file == NULL)
+			return false;
+		CookedMeshHeader header;
+		uint64_t sourceSize = 0;
+		int64_t sourceModifiedTime = 0;
+		bool ok = fread(&header, sizeof(header), 1, file) == 1
+			&& memcmp(header.magic, COOKED_MESH_MAGIC, 4) == 0
+			&& header.version == COOKED_MESH_VERSION
+			&& header.vertexSize == sizeof(Vertex)
+			&& getSourceInfo(sourcePath, &sourceSize, &sourceModifiedTime)
+			&& header.sourceSize == sourceSize
+			&& header.sourceModifiedTime == sourceModifiedTime;
+		if (ok) {
+			meshes->clear();
+			meshes->resize(header.numMeshes);
+		}
+		for (uint32_t i = 0; i < header.numMeshes && ok; i++)
+		{
+			MeshData& mesh = (*meshes)[i];
+			CookedMeshEntry entry;
+			ok = fread(&entry, sizeof(entry), 1, file) == 1;
+			if (!ok)
+				break;
+			mesh.vertices.resize(entry.numVertices);
+			mesh.indices.resize(entry.numIndices);
+			ok = fread(mesh.vertices.data(), sizeof(Vertex), entry.numVertices, file) == entry.numVertices;
+			ok = ok && fread(mesh.indices.data(), sizeof(unsigned int), entry.numIndices, file) == entry.numIndices;
+			if (ok && entry.hasTangents) {
+				mesh.tangents.resize(entry.numVertices);
+				ok = fread(mesh.tangents.data(), sizeof(glm::vec4), entry.numVertices, file) == entry.numVertices;
+			}
+		}
+		fclose(file);
+		if (!ok) {
+			meshes->clear();
+		}
+		return ok;
+	}
+}
@@ -0,0 +1,15 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+#include <string>
+#include <vector>
+
+namespace ew {
+	//Writes meshes (including tangents, if present) to a binary file tagged with the source file's size and modification time
+	bool saveCookedMeshes(const std::string& cookedPath, const std::string& sourcePath, const std::vector<MeshData>& meshes);
+	//Reads meshes written by saveCookedMeshes. Fails if the file is missing, corrupt, or the source changed since cooking.
+	bool loadCookedMeshes(const std::string& cookedPath, const std::string& sourcePath, std::vector<MeshData>* meshes);
+}
@@ -0,0 +1,280 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "mipmaps.h"
+#include "parallel.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_MIPMAPS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	namespace {
+		const float KAISER_WIDTH = 3.0f; //Output texels each side
+		const float KAISER_ALPHA = 4.0f;
+		const int LINEAR_TO_SRGB_STEPS = 4096;
+
+		struct SrgbTables {
+			float toLinear[256];
+			float unorm[256]; //i / 255
+			unsigned char toSrgb[LINEAR_TO_SRGB_STEPS + 1];
+			SrgbTables() {
+				for (int i = 0; i < 256; i++)
+				{
+					float c = i / 255.0f;
+					toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+					unorm[i] = c;
+				}
+				for (int i = 0; i <= LINEAR_TO_SRGB_STEPS; i++)
+				{
+					float l = (float)i / LINEAR_TO_SRGB_STEPS;
+					float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+					toSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+				}
+			}
+		};
+
+		const SrgbTables& srgbTables() {
+			//Built once, thread safe since C++11
+			static SrgbTables tables;
+			return tables;
+		}
+
+		unsigned char toByte(float v) {
+			v = v * 255.0f + 0.5f;
+			return (unsigned char)(v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v));
+		}
+
+		unsigned char linearToSrgb(const SrgbTables& tables, float v) {
+			v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+			return tables.toSrgb[(int)(v * LINEAR_TO_SRGB_STEPS + 0.5f)];
+		}
+
+		//Zeroth order modified Bessel function of the first kind, by its power series
+		float besselI0(float x) {
+			float sum = 1.0f, term = 1.0f;
+			for (int k = 1; k < 20; k++)
+			{
+				term *= (x * 0.5f / k) * (x * 0.5f / k);
+				sum += term;
+			}
+			return sum;
+		}
+
+		float kaiser(float t) {
+			float x = t / KAISER_WIDTH;
+			if (x <= -1.0f || x >= 1.0f)
+				return 0.0f;
+			float window = besselI0(KAISER_ALPHA * sqrtf(1.0f - x * x)) / besselI0(KAISER_ALPHA);
+			float sinc = fabsf(t) < 1e-6f ? 1.0f : sinf(3.14159265f * t) / (3.14159265f * t);
+			return sinc * window;
+		}
+
+		/// <summary>
+		/// Source taps and weights for every output texel along one axis. Taps past the edges are clamped to the edge texel.
+		/// </summary>
+		struct FilterTable {
+			std::vector<int> first; //Into taps/weights, per output texel, plus one past the end
+			std::vector<int> taps;
+			std::vector<float> weights;
+
+			FilterTable(int srcSize, int dstSize, MipFilter filter) {
+				float scale = (float)srcSize / dstSize;
+				first.reserve(dstSize + 1);
+				for (int x = 0; x < dstSize; x++)
+				{
+					first.push_back((int)taps.size());
+					float center = (x + 0.5f) * scale;
+					float radius = filter == MIP_FILTER_BOX ? scale * 0.5f : scale * KAISER_WIDTH;
+					int lo = (int)floorf(center - radius);
+					int hi = (int)ceilf(center + radius);
+					float total = 0.0f;
+					for (int i = lo; i < hi; i++)
+					{
+						float weight;
+						if (filter == MIP_FILTER_BOX) {
+							//Overlap of source texel [i, i + 1] with the output footprint
+							weight = fminf(center + radius, i + 1.0f) - fmaxf(center - radius, (float)i);
+						}
+						else {
+							weight = kaiser((i + 0.5f - center) / scale);
+						}
+						if (weight == 0.0f)
+							continue;
+						taps.push_back(i < 0 ? 0 : (i >= srcSize ? srcSize - 1 : i));
+						weights.push_back(weight);
+						total += weight;
+					}
+					for (size_t i = first.back(); i < weights.size(); i++)
+					{
+						weights[i] /= total;
+					}
+				}
+				first.push_back((int)taps.size());
+			}
+		};
+
+		//Weighted sum of float4 pixels: out = sum(weights[i] * pixels[taps[i] * stride])
+		void accumulate(const float* pixels, size_t stride, const int* taps, const float* weights, int count, float* out) {
+#ifdef EW_MIPMAPS_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int i = 0; i < count; i++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(pixels + taps[i] * stride)));
+			}
+			_mm_storeu_ps(out, sum);
+#else
+			float sum[4] = {};
+			for (int i = 0; i < count; i++)
+			{
+				const float* p = pixels + taps[i] * stride;
+				for (int c = 0; c < 4; c++)
+				{
+					sum[c] += weights[i] * p[c];
+				}
+			}
+			for (int c = 0; c < 4; c++)
+			{
+				out[c] = sum[c];
+			}
+#endif
+		}
+
+		//out += weight * row
+		void addScaledRow(const float* row, float weight, size_t count, float* out) {
+			size_t i = 0;
+#ifdef EW_MIPMAPS_SSE2
+			__m128 w = _mm_set1_ps(weight);
+			for (; i + 4 <= count; i += 4)
+			{
+				_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(w, _mm_loadu_ps(row + i))));
+			}
+#endif
+			for (; i < count; i++)
+			{
+				out[i] += weight * row[i];
+			}
+		}
+
+		void normalize(float* p) {
+			float x = p[0] * 2.0f - 1.0f, y = p[1] * 2.0f - 1.0f, z = p[2] * 2.0f - 1.0f;
+			float length = sqrtf(x * x + y * y + z * z);
+			if (length < 1e-6f) {
+				x = 0.0f; y = 0.0f; z = 1.0f;
+				length = 1.0f;
+			}
+			p[0] = x / length * 0.5f + 0.5f;
+			p[1] = y / length * 0.5f + 0.5f;
+			p[2] = z / length * 0.5f + 0.5f;
+		}
+
+		/// <summary>
+		/// One level down: horizontal pass into scratch, then vertical pass into dst. Both are split by rows across threads.
+		/// </summary>
+		void downsample(const std::vector<float>& src, int srcWidth, int srcHeight, std::vector<float>* dst, int dstWidth, int dstHeight, const MipOptions& options, std::vector<float>* scratch) {
+			FilterTable horizontal(srcWidth, dstWidth, options.filter);
+			FilterTable vertical(srcHeight, dstHeight, options.filter);
+			scratch->resize((size_t)dstWidth * srcHeight * 4);
+			dst->resize((size_t)dstWidth * dstHeight * 4);
+			float* tmp = scratch->data();
+			float* out = dst->data();
+			parallelFor((size_t)srcHeight, 32, [&](size_t begin, size_t end) {
+				for (size_t y = begin; y < end; y++)
+				{
+					const float* row = src.data() + y * srcWidth * 4;
+					for (int x = 0; x < dstWidth; x++)
+					{
+						int first = horizontal.first[x];
+						accumulate(row, 4, &horizontal.taps[first], &horizontal.weights[first], horizontal.first[x + 1] - first, tmp + (y * dstWidth + x) * 4);
+					}
+				}
+			});
+			parallelFor((size_t)dstHeight, 16, [&](size_t begin, size_t end) {
+				size_t rowFloats = (size_t)dstWidth * 4;
+				for (size_t y = begin; y < end; y++)
+				{
+					//Whole rows at a time, so every read streams through memory instead of walking down columns
+					float* row = out + y * rowFloats;
+					for (size_t i = 0; i < rowFloats; i++)
+					{
+						row[i] = 0.0f;
+					}
+					for (int t = vertical.first[y]; t < vertical.first[y + 1]; t++)
+					{
+						addScaledRow(tmp + vertical.taps[t] * rowFloats, vertical.weights[t], rowFloats, row);
+					}
+					if (options.normalMap) {
+						for (int x = 0; x < dstWidth; x++)
+						{
+							normalize(row + x * 4);
+						}
+					}
+				}
+			});
+		}
+	}
+
+	void generateMips(const unsigned char* pixels, int width, int height, int numComponents, const MipOptions& options, std::vector<MipLevel>* levels)
+	{
+		const SrgbTables& tables = srgbTables();
+		bool srgb = options.srgb && !options.normalMap && numComponents >= 3;
+		size_t numPixels = (size_t)width * height;
+		levels->clear();
+		MipLevel base;
+		base.width = width;
+		base.height = height;
+		base.pixels.assign(pixels, pixels + numPixels * numComponents);
+		levels->push_back(std::move(base));
+
+		//Every level is kept as RGBA float, in linear light for sRGB images
+		std::vector<float> current(numPixels * 4), next, scratch;
+		//Per channel byte -> float table, so the loop below has no branches per channel
+		const float* toFloat[4];
+		for (int c = 0; c < 4; c++)
+		{
+			toFloat[c] = srgb && c < 3 ? tables.toLinear : tables.unorm;
+		}
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			const unsigned char* p = pixels + i * numComponents;
+			float* f = &current[i * 4];
+			f[0] = toFloat[0][p[0]];
+			f[1] = numComponents > 1 ? toFloat[1][p[1]] : 0.0f;
+			f[2] = numComponents > 2 ? toFloat[2][p[2]] : 0.0f;
+			f[3] = numComponents > 3 ? toFloat[3][p[3]] : 1.0f;
+			if (options.normalMap && numComponents == 2) {
+				//Two channel normal maps store x and y only. Rebuild z so the vector can be renormalized.
+				float x = f[0] * 2.0f - 1.0f, y = f[1] * 2.0f - 1.0f;
+				f[2] = sqrtf(fmaxf(0.0f, 1.0f - x * x - y * y)) * 0.5f + 0.5f;
+			}
+		}
+
+		int levelWidth = width, levelHeight = height;
+		while (levelWidth > 1 || levelHeight > 1) {
+			int nextWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+			int nextHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+			downsample(current, levelWidth, levelHeight, &next, nextWidth, nextHeight, options, &scratch);
+			current.swap(next);
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+
+			MipLevel level;
+			level.width = levelWidth;
+			level.height = levelHeight;
+			level.pixels.resize((size_t)levelWidth * levelHeight * numComponents);
+			for (size_t i = 0; i < (size_t)levelWidth * levelHeight; i++)
+			{
+				const float* f = &current[i * 4];
+				unsigned char* p = &level.pixels[i * numComponents];
+				for (int c = 0; c < numComponents; c++)
+				{
+					p[c] = srgb && c < 3 ? linearToSrgb(tables, f[c]) : toByte(f[c]);
+				}
+			}
+			levels->push_back(std::move(level));
+		}
+	}
+}
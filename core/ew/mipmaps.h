@@ -0,0 +1,35 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+
+namespace ew {
+	enum MipFilter {
+		MIP_FILTER_BOX, //Area average. Cheapest, a little blurry.
+		MIP_FILTER_KAISER //Kaiser windowed sinc, 3 output texels each side. Sharper, with slight ringing on hard edges.
+	};
+
+	struct MipOptions {
+		MipFilter filter = MIP_FILTER_KAISER;
+		bool srgb = true; //RGB is sRGB encoded: filtered in linear light. Alpha and 1-2 channel images are always linear.
+		bool normalMap = false; //RGB (or RG with z rebuilt) is a [0,1] encoded unit vector, renormalized after filtering
+	};
+
+	struct MipLevel {
+		int width;
+		int height;
+		std::vector<unsigned char> pixels; //Same channel count as the source, rows tightly packed
+	};
+
+	/// <summary>
+	/// Builds the full mip chain of an 8 bit image on the CPU, down to 1x1. Any size works: each level halves (rounding down)
+	/// and samples the level above with a separable filter whose weights are computed per output row and column.
+	/// Levels are filtered in 32 bit float from the previous float level, so rounding never accumulates,
+	/// 4 channels at a time with SSE where available. Rows of each level are split across threads.
+	/// Safe to call from several threads at once, e.g. one per image.
+	/// </summary>
+	/// <param name="levels">Level 0 (a copy of pixels) first</param>
+	void generateMips(const unsigned char* pixels, int width, int height, int numComponents, const MipOptions& options, std::vector<MipLevel>* levels);
+}
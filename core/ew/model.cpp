@@ -3,31 +3,317 @@
 */
 
 #include "model.h"
+#include "objLoader.h"
+#include "tangents.h"
+#include "meshCache.h"
+#include "glState.h"
+#include "external/glad.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <ctype.h>
+#include <stdio.h>
+#include <chrono>
 
 namespace ew {
-	ew::Mesh processAiMesh(aiMesh* aiMesh);
+	ew::MeshData processAiMesh(aiMesh* aiMesh);
 
-	Model::Model(const std::string& filePath)
+	static bool hasObjExtension(const std::string& filePath) {
+		if (filePath.size() < 4)
+			return false;
+		std::string ext = filePath.substr(filePath.size() - 4);
+		for (size_t i = 0; i < ext.size(); i++)
+		{
+			ext[i] = tolower(ext[i]);
+		}
+		return ext == ".obj";
+	}
+
+	Model::Model(const std::string& filePath, bool mergeMeshes)
+	{
+		ModelOptions options;
+		options.mergeMeshes = mergeMeshes;
+		load(filePath, options);
+	}
+
+	Model::Model(const std::string& filePath, const ModelOptions& options)
+	{
+		load(filePath, options);
+	}
+
+	//Imports submeshes from a source file. Plain OBJ skips Assimp entirely.
+	static std::vector<ew::MeshData> importMeshes(const std::string& filePath)
 	{
+		std::vector<ew::MeshData> meshes;
+		if (hasObjExtension(filePath)) {
+			ew::MeshData meshData;
+			if (ew::loadObj(filePath, &meshData)) {
+				meshes.push_back(std::move(meshData));
+			}
+		}
+		if (meshes.empty()) {
+			Assimp::Importer importer;
+			const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
+			meshes.reserve(aiScene->mNumMeshes);
+			for (size_t i = 0; i < aiScene->mNumMeshes; i++)
+			{
+				aiMesh* aiMesh = aiScene->mMeshes[i];
+				meshes.push_back(processAiMesh(aiMesh));
+			}
+		}
+		return meshes;
+	}
+
+	bool benchmarkObjImport(const std::string& filePath, ObjImportBenchmark* result)
+	{
+		*result = ObjImportBenchmark();
+		ew::MeshData meshData;
+		if (!ew::loadObj(filePath, &meshData, &result->obj)) {
+			return false;
+		}
+		//Same work as importMeshes: read, triangulate and convert to MeshData
+		auto startTime = std::chrono::high_resolution_clock::now();
 		Assimp::Importer importer;
 		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
+		if (!aiScene) {
+			printf("Failed to import %s with Assimp", filePath.c_str());
+			return false;
+		}
+		std::vector<ew::MeshData> meshes;
 		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
 		{
-			aiMesh* aiMesh = aiScene->mMeshes[i];
-			m_meshes.push_back(processAiMesh(aiMesh));
+			meshes.push_back(processAiMesh(aiScene->mMeshes[i]));
+		}
+		result->assimpSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return true;
+	}
+
+	void Model::load(const std::string& filePath, const ModelOptions& options)
+	{
+		std::vector<ew::MeshData> meshes;
+		const std::string cookedPath = filePath + ".ewmesh";
+		bool cooked = options.useCookedCache && ew::loadCookedMeshes(cookedPath, filePath, &meshes);
+		//A cache cooked without tangents can't satisfy a request for them
+		for (size_t i = 0; i < meshes.size() && cooked && options.generateTangents; i++)
+		{
+			cooked = meshes[i].tangents.size() == meshes[i].vertices.size();
+		}
+		if (!cooked) {
+			meshes = importMeshes(filePath);
+			if (options.generateTangents) {
+				for (size_t i = 0; i < meshes.size(); i++)
+				{
+					ew::TangentStats tangentStats = ew::generateTangents(&meshes[i]);
+					m_tangentStats.triangles += tangentStats.triangles;
+					m_tangentStats.splitVertices += tangentStats.splitVertices;
+					m_tangentStats.seconds += tangentStats.seconds;
+				}
+			}
+			if (options.useCookedCache) {
+				ew::saveCookedMeshes(cookedPath, filePath, meshes);
+			}
+		}
+
+		ew::computeBounds(meshes.data(), meshes.size(), &m_bounds, &m_boundingSphere);
+		if (options.buildBvh) {
+			m_bvh.build(meshes.data(), meshes.size(), &m_bvhStats);
+		}
+		m_meshVisible.assign(meshes.size(), true);
+		if (options.mergeMeshes) {
+			loadMerged(meshes);
+		}
+		else {
+			m_meshes.reserve(meshes.size());
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				m_meshes.push_back(ew::Mesh(meshes[i]));
+			}
 		}
 	}
 
+	/// <summary>
+	/// Packs every submesh into one shared VBO/EBO behind a single VAO, and builds one indirect command per submesh.
+	/// </summary>
+	/// <param name="meshes">Submeshes in model order</param>
+	void Model::loadMerged(const std::vector<ew::MeshData>& meshes)
+	{
+		m_merged = true;
+		size_t totalVertices = 0;
+		size_t totalIndices = 0;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			totalVertices += meshes[i].vertices.size();
+			totalIndices += meshes[i].indices.size();
+		}
+
+		glGenVertexArrays(1, &m_vao);
+		bindVertexArray(m_vao);
+
+		glGenBuffers(1, &m_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * totalVertices, NULL, GL_STATIC_DRAW);
+
+		glGenBuffers(1, &m_ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * totalIndices, NULL, GL_STATIC_DRAW);
+
+		ew::setVertexAttributes();
+
+		//Indices stay local to each submesh, baseVertex offsets them into the shared vertex buffer
+		m_drawCommands.resize(meshes.size());
+		size_t vertexOffset = 0;
+		size_t indexOffset = 0;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			const ew::MeshData& mesh = meshes[i];
+			if (mesh.vertices.size() > 0) {
+				glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertexOffset, sizeof(Vertex) * mesh.vertices.size(), mesh.vertices.data());
+			}
+			if (mesh.indices.size() > 0) {
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indexOffset, sizeof(unsigned int) * mesh.indices.size(), mesh.indices.data());
+			}
+			DrawElementsIndirectCommand& command = m_drawCommands[i];
+			command.count = mesh.indices.size();
+			command.instanceCount = 1;
+			command.firstIndex = indexOffset;
+			command.baseVertex = vertexOffset;
+			command.baseInstance = 0;
+			vertexOffset += mesh.vertices.size();
+			indexOffset += mesh.indices.size();
+		}
+
+		//Tangents are only kept when every submesh has them
+		bool hasTangents = !meshes.empty();
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			hasTangents = hasTangents && meshes[i].tangents.size() == meshes[i].vertices.size();
+		}
+		if (hasTangents) {
+			glGenBuffers(1, &m_tangentVbo);
+			glBindBuffer(GL_ARRAY_BUFFER, m_tangentVbo);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * totalVertices, NULL, GL_STATIC_DRAW);
+			vertexOffset = 0;
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				if (meshes[i].tangents.size() > 0) {
+					glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * vertexOffset, sizeof(glm::vec4) * meshes[i].tangents.size(), meshes[i].tangents.data());
+				}
+				vertexOffset += meshes[i].vertices.size();
+			}
+			ew::setTangentAttribute();
+		}
+
+		m_mergedBytes = sizeof(Vertex) * totalVertices + sizeof(unsigned int) * totalIndices + sizeof(DrawElementsIndirectCommand) * m_drawCommands.size();
+		if (hasTangents) {
+			m_mergedBytes += sizeof(glm::vec4) * totalVertices;
+		}
+		glGenBuffers(1, &m_indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * m_drawCommands.size(), m_drawCommands.data(), GL_DYNAMIC_DRAW);
+
+		bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	void Model::unload()
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].unload();
+		}
+		m_meshes.clear();
+		if (m_merged) {
+			glDeleteVertexArrays(1, &m_vao);
+			forgetVertexArray(m_vao);
+			unsigned int buffers[3] = { m_vbo, m_ebo, m_indirectBuffer };
+			glDeleteBuffers(3, buffers);
+			if (m_tangentVbo != 0) {
+				glDeleteBuffers(1, &m_tangentVbo);
+			}
+			m_vao = m_vbo = m_ebo = m_tangentVbo = m_indirectBuffer = 0;
+			m_mergedBytes = 0;
+			m_drawCommands.clear();
+			m_merged = false;
+		}
+		m_meshVisible.clear();
+		m_numDrawCalls = 0;
+	}
+
+	size_t Model::getGPUBytes()const
+	{
+		size_t bytes = m_mergedBytes;
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			bytes += m_meshes[i].getGPUBytes();
+		}
+		return bytes;
+	}
+
 	void Model::draw()
 	{
+		if (m_merged) {
+			drawMerged(1);
+			return;
+		}
+		m_numDrawCalls = 0;
 		for (size_t i = 0; i < m_meshes.size(); i++)
 		{
+			if (!m_meshVisible[i])
+				continue;
 			m_meshes[i].draw();
+			m_numDrawCalls++;
+		}
+	}
+
+	void Model::drawInstanced(int instanceCount)
+	{
+		if (m_merged) {
+			drawMerged(instanceCount);
+			return;
+		}
+		m_numDrawCalls = 0;
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			if (!m_meshVisible[i])
+				continue;
+			m_meshes[i].drawInstanced(instanceCount);
+			m_numDrawCalls++;
+		}
+	}
+
+	void Model::drawMerged(int instanceCount)
+	{
+		//Instance count lives in the command buffer, so only rewrite it when it changes
+		if (instanceCount != m_commandInstanceCount) {
+			m_commandInstanceCount = instanceCount;
+			for (size_t i = 0; i < m_drawCommands.size(); i++)
+			{
+				m_drawCommands[i].instanceCount = m_meshVisible[i] ? instanceCount : 0;
+			}
+			m_commandsDirty = true;
+		}
+		bindVertexArray(m_vao);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+		//Visibility changes only rewrite the command buffer, never the geometry
+		if (m_commandsDirty) {
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * m_drawCommands.size(), m_drawCommands.data());
+			m_commandsDirty = false;
+		}
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, m_drawCommands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		m_numDrawCalls = 1;
+	}
+
+	void Model::setMeshVisible(int meshIndex, bool visible)
+	{
+		m_meshVisible[meshIndex] = visible;
+		if (m_merged) {
+			m_drawCommands[meshIndex].instanceCount = visible ? m_commandInstanceCount : 0;
+			m_commandsDirty = true;
 		}
 	}
 
@@ -36,8 +322,10 @@ namespace ew {
 	}
 
 	//Utility functions local to this file
-	ew::Mesh processAiMesh(aiMesh* aiMesh) {
+	ew::MeshData processAiMesh(aiMesh* aiMesh) {
 		ew::MeshData meshData;
+		meshData.vertices.reserve(aiMesh->mNumVertices);
+		meshData.indices.reserve(aiMesh->mNumFaces * 3);
 		for (size_t i = 0; i < aiMesh->mNumVertices; i++)
 		{
 			ew::Vertex vertex;
@@ -58,7 +346,7 @@ namespace ew {
 				meshData.indices.push_back(aiMesh->mFaces[i].mIndices[j]);
 			}
 		}
-		return ew::Mesh(meshData);
+		return meshData;
 	}
 
 }
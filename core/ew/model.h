@@ -5,14 +5,87 @@
 #pragma once
 #include "mesh.h"
 #include "shader.h"
+#include "bvh.h"
+#include "objLoader.h"
+#include "tangents.h"
 #include <vector>
 
 namespace ew {
+	//Layout expected by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand {
+		unsigned int count; //Number of indices for this submesh
+		unsigned int instanceCount; //0 = hidden, otherwise the number of instances drawn
+		unsigned int firstIndex; //Offset into the shared index buffer
+		int baseVertex; //Offset into the shared vertex buffer
+		unsigned int baseInstance;
+	};
+
+	struct ModelOptions {
+		bool mergeMeshes = false; //Pack all submeshes into one VBO/EBO and draw them with a single glMultiDrawElementsIndirect
+		bool generateTangents = false; //Run generateTangents on every submesh at import
+		bool useCookedCache = false; //Read/write imported meshes as <filePath>.ewmesh, skipping import when it is up to date
+		bool buildBvh = false; //Keep a MeshBvh over every submesh for raycasts and picking
+	};
+
+	//loadObj against Assimp on one file, CPU side only (file to MeshData, no GPU upload)
+	struct ObjImportBenchmark {
+		ObjLoadStats obj;
+		double assimpSeconds = 0.0;
+		inline double objMegabytesPerSecond()const { return obj.megabytesPerSecond(); }
+		inline double assimpMegabytesPerSecond()const { return assimpSeconds > 0.0 ? (obj.fileBytes / (1024.0 * 1024.0)) / assimpSeconds : 0.0; }
+	};
+	//Imports filePath with both loaders. False if either failed.
+	bool benchmarkObjImport(const std::string& filePath, ObjImportBenchmark* result);
+
 	class Model {
 	public:
-		Model(const std::string& filePath);
+		Model(const std::string& filePath, bool mergeMeshes = false);
+		Model(const std::string& filePath, const ModelOptions& options);
+		//Deletes every GL object. Models are copied by value and copies share them, so only unload the last one in use.
+		//Afterwards the model draws nothing.
+		void unload();
 		void draw();
+		//Draws every visible mesh instanceCount times. Still one draw call when merged.
+		void drawInstanced(int instanceCount);
+		void setMeshVisible(int meshIndex, bool visible);
+		inline bool isMeshVisible(int meshIndex)const { return m_meshVisible[meshIndex]; }
+		inline int getNumMeshes()const { return m_meshVisible.size(); }
+		inline bool isMerged()const { return m_merged; }
+		//Vertex, index, tangent and indirect buffer storage
+		size_t getGPUBytes()const;
+		//Number of GL draw calls issued by the last call to draw()
+		inline int getNumDrawCalls()const { return m_numDrawCalls; }
+		//Model space bounds around every submesh
+		inline const AABB& getBounds()const { return m_bounds; }
+		inline const BoundingSphere& getBoundingSphere()const { return m_boundingSphere; }
+		//Model space BVH. Empty unless ModelOptions::buildBvh was set.
+		inline const MeshBvh& getBvh()const { return m_bvh; }
+		inline const BvhBuildStats& getBvhBuildStats()const { return m_bvhStats; }
+		//Every submesh's tangent generation. Empty when tangents were off or came from the cooked cache.
+		inline const TangentStats& getTangentStats()const { return m_tangentStats; }
 	private:
+		void load(const std::string& filePath, const ModelOptions& options);
+		void loadMerged(const std::vector<ew::MeshData>& meshes);
+		void drawMerged(int instanceCount);
 		std::vector<ew::Mesh> m_meshes;
+		std::vector<bool> m_meshVisible;
+		int m_numDrawCalls = 0;
+		AABB m_bounds;
+		BoundingSphere m_boundingSphere;
+		MeshBvh m_bvh;
+		BvhBuildStats m_bvhStats;
+		TangentStats m_tangentStats;
+
+		//Merged mode
+		bool m_merged = false;
+		bool m_commandsDirty = false;
+		int m_commandInstanceCount = 1; //instanceCount currently written to visible commands
+		unsigned int m_vao = 0;
+		unsigned int m_vbo = 0;
+		unsigned int m_ebo = 0;
+		unsigned int m_tangentVbo = 0;
+		unsigned int m_indirectBuffer = 0;
+		size_t m_mergedBytes = 0;
+		std::vector<DrawElementsIndirectCommand> m_drawCommands;
 	};
-}
\ No newline at end of file
+}
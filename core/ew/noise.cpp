@@ -0,0 +1,138 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "noise.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_NOISE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	//Lattice hash built only from float ops ("hash without sine"), so the SSE2 and scalar paths agree exactly
+	static inline float hashLattice(float x, float y) {
+		float px = x * 0.1031f, py = y * 0.1031f;
+		px -= floorf(px);
+		py -= floorf(py);
+		float pz = px;
+		float d = px * (py + 33.33f) + py * (pz + 33.33f) + pz * (px + 33.33f);
+		px += d;
+		py += d;
+		pz += d;
+		float h = (px + py) * pz;
+		return h - floorf(h);
+	}
+
+	//Each seed shifts the lattice to a different region
+	static inline float seedOffset(unsigned int seed) {
+		return (float)((seed * 131u) % 4096u) * 1.618f;
+	}
+
+	float valueNoise2D(float x, float y, unsigned int seed) {
+		float offset = seedOffset(seed);
+		x += offset;
+		y += offset;
+		float ix = floorf(x), iy = floorf(y);
+		float fx = x - ix, fy = y - iy;
+		//Smoothstep fade
+		float ux = fx * fx * (3.0f - 2.0f * fx);
+		float uy = fy * fy * (3.0f - 2.0f * fy);
+		float a = hashLattice(ix, iy);
+		float b = hashLattice(ix + 1.0f, iy);
+		float c = hashLattice(ix, iy + 1.0f);
+		float d = hashLattice(ix + 1.0f, iy + 1.0f);
+		float bottom = a + (b - a) * ux;
+		float top = c + (d - c) * ux;
+		return (bottom + (top - bottom) * uy) * 2.0f - 1.0f;
+	}
+
+	float fbm2D(float x, float y, const FbmSettings& settings) {
+		float sum = 0.0f, amplitude = 1.0f, frequency = settings.frequency, norm = 0.0f;
+		for (int o = 0; o < settings.octaves; o++)
+		{
+			sum += valueNoise2D(x * frequency, y * frequency, settings.seed + o) * amplitude;
+			norm += amplitude;
+			amplitude *= settings.gain;
+			frequency *= settings.lacunarity;
+		}
+		return norm > 0.0f ? sum / norm : 0.0f;
+	}
+
+#ifdef EW_NOISE_SSE2
+	static inline __m128 floor4(__m128 v) {
+		//Truncate, then subtract 1 where truncation rounded up (negative non-integers)
+		__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+		return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));
+	}
+	static inline __m128 fract4(__m128 v) {
+		return _mm_sub_ps(v, floor4(v));
+	}
+	static inline __m128 hashLattice4(__m128 x, __m128 y) {
+		const __m128 k = _mm_set1_ps(0.1031f);
+		const __m128 c = _mm_set1_ps(33.33f);
+		__m128 px = fract4(_mm_mul_ps(x, k));
+		__m128 py = fract4(_mm_mul_ps(y, k));
+		__m128 pz = px;
+		__m128 d = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(px, _mm_add_ps(py, c)),
+			_mm_mul_ps(py, _mm_add_ps(pz, c))),
+			_mm_mul_ps(pz, _mm_add_ps(px, c)));
+		px = _mm_add_ps(px, d);
+		py = _mm_add_ps(py, d);
+		pz = _mm_add_ps(pz, d);
+		return fract4(_mm_mul_ps(_mm_add_ps(px, py), pz));
+	}
+	static inline __m128 valueNoise4(__m128 x, __m128 y, float offset) {
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 three = _mm_set1_ps(3.0f);
+		x = _mm_add_ps(x, _mm_set1_ps(offset));
+		y = _mm_add_ps(y, _mm_set1_ps(offset));
+		__m128 ix = floor4(x), iy = floor4(y);
+		__m128 fx = _mm_sub_ps(x, ix), fy = _mm_sub_ps(y, iy);
+		__m128 ux = _mm_mul_ps(_mm_mul_ps(fx, fx), _mm_sub_ps(three, _mm_mul_ps(two, fx)));
+		__m128 uy = _mm_mul_ps(_mm_mul_ps(fy, fy), _mm_sub_ps(three, _mm_mul_ps(two, fy)));
+		__m128 ix1 = _mm_add_ps(ix, one), iy1 = _mm_add_ps(iy, one);
+		__m128 a = hashLattice4(ix, iy);
+		__m128 b = hashLattice4(ix1, iy);
+		__m128 c = hashLattice4(ix, iy1);
+		__m128 d = hashLattice4(ix1, iy1);
+		__m128 bottom = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), ux));
+		__m128 top = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), ux));
+		__m128 v = _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), uy));
+		return _mm_sub_ps(_mm_mul_ps(v, two), one);
+	}
+#endif
+
+	void fbm2D(const float* xs, const float* ys, float* out, size_t count, const FbmSettings& settings) {
+		size_t i = 0;
+#ifdef EW_NOISE_SSE2
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(xs + i);
+			__m128 y = _mm_loadu_ps(ys + i);
+			__m128 sum = _mm_setzero_ps();
+			float amplitude = 1.0f, frequency = settings.frequency, norm = 0.0f;
+			for (int o = 0; o < settings.octaves; o++)
+			{
+				__m128 f = _mm_set1_ps(frequency);
+				__m128 n = valueNoise4(_mm_mul_ps(x, f), _mm_mul_ps(y, f), seedOffset(settings.seed + o));
+				sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+				norm += amplitude;
+				amplitude *= settings.gain;
+				frequency *= settings.lacunarity;
+			}
+			if (norm > 0.0f) {
+				sum = _mm_div_ps(sum, _mm_set1_ps(norm));
+			}
+			_mm_storeu_ps(out + i, sum);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			out[i] = fbm2D(xs[i], ys[i], settings);
+		}
+	}
+}
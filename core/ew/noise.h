@@ -0,0 +1,29 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <stddef.h>
+
+namespace ew {
+	struct FbmSettings {
+		float frequency = 0.02f; //Lattice cells per world unit for the first octave
+		int octaves = 5;
+		float lacunarity = 2.0f; //Frequency multiplier per octave
+		float gain = 0.5f; //Amplitude multiplier per octave
+		unsigned int seed = 1337;
+	};
+
+	//2D value noise in [-1, 1]
+	float valueNoise2D(float x, float y, unsigned int seed);
+	//Fractal (fBm) sum of value noise octaves, normalized to roughly [-1, 1]
+	float fbm2D(float x, float y, const FbmSettings& settings);
+	/// <summary>
+	/// Batched fBm. Evaluates 4 points per SSE2 instruction where available, with a matching scalar path.
+	/// Results are identical to calling fbm2D per point.
+	/// </summary>
+	/// <param name="xs">Input x coordinates</param>
+	/// <param name="ys">Input y coordinates</param>
+	/// <param name="out">count results</param>
+	void fbm2D(const float* xs, const float* ys, float* out, size_t count, const FbmSettings& settings);
+}
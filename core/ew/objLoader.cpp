@@ -0,0 +1,346 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "objLoader.h"
+#include "mappedFile.h"
+#include "parallel.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+namespace ew {
+	//Smallest chunk worth parsing on its own thread
+	static const size_t OBJ_MIN_CHUNK_BYTES = 256 * 1024;
+
+	//Index encoding for a face corner before chunks are merged:
+	//>= 0 absolute 0-based index, -1 missing, below -OBJ_RELATIVE_BIAS/2 relative to the chunk's own element count
+	static const int OBJ_INDEX_MISSING = -1;
+	static const int OBJ_RELATIVE_BIAS = 1 << 30;
+
+	struct ObjCorner {
+		int v, vt, vn;
+	};
+
+	struct ObjChunk {
+		const char* begin;
+		const char* end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		std::vector<ObjCorner> corners; //3 per triangle
+		bool hasRelative = false;
+	};
+
+	static inline bool isSpace(char c) {
+		return c == ' ' || c == '\t';
+	}
+
+	static inline const char* skipSpaces(const char* p, const char* end) {
+		while (p < end && isSpace(*p))
+			p++;
+		return p;
+	}
+
+	static inline const char* skipLine(const char* p, const char* end) {
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	/// <summary>
+	/// Parses a decimal float. Digits accumulate into an integer mantissa and are scaled once at the end
+	/// with a power-of-ten table, instead of the per-digit multiplies/branches of strtof.
+	/// </summary>
+	static const char* parseFloat(const char* p, const char* end, float* out) {
+		static const double POW10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+			1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+		};
+		p = skipSpaces(p, end);
+		bool negative = p < end && *p == '-';
+		p += (p < end && (*p == '-' || *p == '+'));
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		while (p < end && (unsigned)(*p - '0') < 10) {
+			//Past 18 significant digits further digits only shift the decimal point
+			if (digits < 18) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += (mantissa != 0);
+			}
+			else {
+				exponent++;
+			}
+			p++;
+		}
+		if (p < end && *p == '.') {
+			p++;
+			while (p < end && (unsigned)(*p - '0') < 10) {
+				if (digits < 18) {
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += (mantissa != 0);
+					exponent--;
+				}
+				p++;
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			p++;
+			bool negativeExp = p < end && *p == '-';
+			p += (p < end && (*p == '-' || *p == '+'));
+			int e = 0;
+			while (p < end && (unsigned)(*p - '0') < 10) {
+				e = e * 10 + (*p - '0');
+				p++;
+			}
+			exponent += negativeExp ? -e : e;
+		}
+		double value = (double)mantissa;
+		while (exponent < -18) {
+			value /= 1e18;
+			exponent += 18;
+		}
+		while (exponent > 18) {
+			value *= 1e18;
+			exponent -= 18;
+		}
+		value = exponent < 0 ? value / POW10[-exponent] : value * POW10[exponent];
+		*out = (float)(negative ? -value : value);
+		return p;
+	}
+
+	static inline const char* parseInt(const char* p, const char* end, int* out) {
+		bool negative = p < end && *p == '-';
+		p += (p < end && (*p == '-' || *p == '+'));
+		int value = 0;
+		while (p < end && (unsigned)(*p - '0') < 10) {
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+		*out = negative ? -value : value;
+		return p;
+	}
+
+	//Converts an OBJ index (1-based, or negative = relative to the end) to the pre-merge encoding
+	static inline int encodeIndex(int objIndex, size_t localCount, bool* hasRelative) {
+		if (objIndex > 0)
+			return objIndex - 1;
+		if (objIndex == 0)
+			return OBJ_INDEX_MISSING;
+		//May reference an element from an earlier chunk, so the local index can be negative
+		*hasRelative = true;
+		return ((int)localCount + objIndex) - OBJ_RELATIVE_BIAS;
+	}
+
+	static const char* parseFace(const char* p, const char* end, ObjChunk* chunk) {
+		ObjCorner first = {}, previous = {};
+		int numCorners = 0;
+		while (true) {
+			p = skipSpaces(p, end);
+			if (p >= end || *p == '\n' || *p == '\r' || *p == '#')
+				break;
+			int v = 0, vt = 0, vn = 0;
+			p = parseInt(p, end, &v);
+			if (p < end && *p == '/') {
+				p++;
+				if (p < end && *p != '/')
+					p = parseInt(p, end, &vt);
+				if (p < end && *p == '/') {
+					p++;
+					p = parseInt(p, end, &vn);
+				}
+			}
+			ObjCorner corner;
+			corner.v = encodeIndex(v, chunk->positions.size(), &chunk->hasRelative);
+			corner.vt = encodeIndex(vt, chunk->uvs.size(), &chunk->hasRelative);
+			corner.vn = encodeIndex(vn, chunk->normals.size(), &chunk->hasRelative);
+			//Fan triangulation
+			if (numCorners == 0) {
+				first = corner;
+			}
+			else if (numCorners >= 2) {
+				chunk->corners.push_back(first);
+				chunk->corners.push_back(previous);
+				chunk->corners.push_back(corner);
+			}
+			previous = corner;
+			numCorners++;
+			//Skip anything unexpected so a malformed token can't stall the loop
+			while (p < end && !isSpace(*p) && *p != '\n' && *p != '\r')
+				p++;
+		}
+		return p;
+	}
+
+	static void parseChunk(ObjChunk* chunk) {
+		//Rough reservation from chunk size, avoids most regrowth on typical files
+		size_t estimatedLines = (chunk->end - chunk->begin) / 32;
+		chunk->positions.reserve(estimatedLines / 3);
+		chunk->corners.reserve(estimatedLines);
+
+		const char* p = chunk->begin;
+		const char* end = chunk->end;
+		while (p < end) {
+			p = skipSpaces(p, end);
+			if (p + 1 < end && p[0] == 'v' && isSpace(p[1])) {
+				glm::vec3 v;
+				p = parseFloat(p + 2, end, &v.x);
+				p = parseFloat(p, end, &v.y);
+				p = parseFloat(p, end, &v.z);
+				chunk->positions.push_back(v);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+				glm::vec2 uv;
+				p = parseFloat(p + 3, end, &uv.x);
+				p = parseFloat(p, end, &uv.y);
+				chunk->uvs.push_back(uv);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+				glm::vec3 n;
+				p = parseFloat(p + 3, end, &n.x);
+				p = parseFloat(p, end, &n.y);
+				p = parseFloat(p, end, &n.z);
+				chunk->normals.push_back(n);
+			}
+			else if (p + 1 < end && p[0] == 'f' && isSpace(p[1])) {
+				p = parseFace(p + 2, end, chunk);
+			}
+			p = skipLine(p, end);
+		}
+	}
+
+	static inline int resolveIndex(int index, size_t base) {
+		return index < -OBJ_RELATIVE_BIAS / 2 ? (int)base + (index + OBJ_RELATIVE_BIAS) : index;
+	}
+
+	static inline uint64_t hashCorner(const ObjCorner& c) {
+		uint64_t h = (uint64_t)(uint32_t)c.v * 0x9E3779B97F4A7C15ull;
+		h ^= (uint64_t)(uint32_t)c.vt * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+		h ^= (uint64_t)(uint32_t)c.vn * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+		return h ^ (h >> 29);
+	}
+
+	bool loadObj(const std::string& filePath, MeshData* meshData, ObjLoadStats* stats) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		meshData->vertices.clear();
+		meshData->indices.clear();
+		meshData->tangents.clear();
+
+		MappedFile file;
+		if (!file.open(filePath)) {
+			printf("Failed to open OBJ %s", filePath.c_str());
+			return false;
+		}
+		const char* data = (const char*)file.getData();
+		size_t size = file.getSize();
+
+		//Split on line boundaries
+		size_t numChunks = size / OBJ_MIN_CHUNK_BYTES;
+		if (numChunks > getNumWorkerThreads())
+			numChunks = getNumWorkerThreads();
+		if (numChunks < 1)
+			numChunks = 1;
+		std::vector<ObjChunk> chunks(numChunks);
+		const char* chunkBegin = data;
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			const char* chunkEnd = (i == numChunks - 1) ? data + size : data + (size * (i + 1)) / numChunks;
+			if (chunkEnd < chunkBegin)
+				chunkEnd = chunkBegin;
+			chunkEnd = skipLine(chunkEnd, data + size);
+			chunks[i].begin = chunkBegin;
+			chunks[i].end = chunkEnd;
+			chunkBegin = chunkEnd;
+		}
+
+		parallelFor(numChunks, 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				parseChunk(&chunks[i]);
+		});
+
+		//Concatenate attribute streams and make every index absolute
+		std::vector<glm::vec3> positions, normals;
+		std::vector<glm::vec2> uvs;
+		size_t numCorners = 0;
+		{
+			size_t numPositions = 0, numUvs = 0, numNormals = 0;
+			for (size_t i = 0; i < numChunks; i++)
+			{
+				numPositions += chunks[i].positions.size();
+				numUvs += chunks[i].uvs.size();
+				numNormals += chunks[i].normals.size();
+				numCorners += chunks[i].corners.size();
+			}
+			positions.reserve(numPositions);
+			uvs.reserve(numUvs);
+			normals.reserve(numNormals);
+		}
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			ObjChunk& chunk = chunks[i];
+			if (chunk.hasRelative) {
+				for (size_t j = 0; j < chunk.corners.size(); j++)
+				{
+					ObjCorner& c = chunk.corners[j];
+					c.v = resolveIndex(c.v, positions.size());
+					c.vt = resolveIndex(c.vt, uvs.size());
+					c.vn = resolveIndex(c.vn, normals.size());
+				}
+			}
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		}
+		file.close();
+
+		if (numCorners == 0) {
+			printf("OBJ %s has no faces", filePath.c_str());
+			return false;
+		}
+
+		//Deduplicate v/vt/vn triplets with an open addressing table (power of 2, load factor <= 0.5)
+		size_t tableSize = 1;
+		while (tableSize < numCorners * 2)
+			tableSize <<= 1;
+		const size_t tableMask = tableSize - 1;
+		std::vector<ObjCorner> tableKeys(tableSize);
+		std::vector<unsigned int> tableValues(tableSize, UINT32_MAX);
+
+		meshData->vertices.reserve(positions.size());
+		meshData->indices.resize(numCorners);
+		size_t indexOut = 0;
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			const std::vector<ObjCorner>& corners = chunks[i].corners;
+			for (size_t j = 0; j < corners.size(); j++)
+			{
+				const ObjCorner& c = corners[j];
+				size_t slot = hashCorner(c) & tableMask;
+				while (tableValues[slot] != UINT32_MAX &&
+					(tableKeys[slot].v != c.v || tableKeys[slot].vt != c.vt || tableKeys[slot].vn != c.vn)) {
+					slot = (slot + 1) & tableMask;
+				}
+				if (tableValues[slot] == UINT32_MAX) {
+					Vertex vertex;
+					vertex.pos = (c.v >= 0 && (size_t)c.v < positions.size()) ? positions[c.v] : glm::vec3(0);
+					vertex.uv = (c.vt >= 0 && (size_t)c.vt < uvs.size()) ? uvs[c.vt] : glm::vec2(0);
+					vertex.normal = (c.vn >= 0 && (size_t)c.vn < normals.size()) ? normals[c.vn] : glm::vec3(0);
+					tableKeys[slot] = c;
+					tableValues[slot] = meshData->vertices.size();
+					meshData->vertices.push_back(vertex);
+				}
+				meshData->indices[indexOut++] = tableValues[slot];
+			}
+		}
+
+		if (stats != nullptr) {
+			stats->fileBytes = size;
+			stats->numThreads = numChunks;
+			stats->parseSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+		return true;
+	}
+}
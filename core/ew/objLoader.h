@@ -0,0 +1,27 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+#include <string>
+
+namespace ew {
+	struct ObjLoadStats {
+		size_t fileBytes = 0;
+		double parseSeconds = 0.0; //Map + parse + deduplicate, excludes GPU upload
+		unsigned int numThreads = 0;
+		inline double megabytesPerSecond()const { return parseSeconds > 0.0 ? (fileBytes / (1024.0 * 1024.0)) / parseSeconds : 0.0; }
+	};
+
+	/// <summary>
+	/// Loads a Wavefront OBJ directly into MeshData without Assimp.
+	/// The file is memory mapped and parsed in parallel chunks. v/vt/vn triplets are deduplicated into shared vertices.
+	/// Polygons are fan triangulated. All groups/objects are merged into a single mesh; materials are ignored.
+	/// </summary>
+	/// <param name="filePath">Path to .obj file</param>
+	/// <param name="meshData">MeshData to fill. Will be cleared.</param>
+	/// <param name="stats">Optional timing info</param>
+	/// <returns>False if the file could not be opened or contained no faces</returns>
+	bool loadObj(const std::string& filePath, MeshData* meshData, ObjLoadStats* stats = nullptr);
+}
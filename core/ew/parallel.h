@@ -0,0 +1,50 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <thread>
+#include <vector>
+
+namespace ew {
+	//Threads used for CPU-side jobs (mesh generation, parsing). Always at least 1.
+	inline unsigned int getNumWorkerThreads() {
+		unsigned int n = std::thread::hardware_concurrency();
+		return n > 0 ? n : 1;
+	}
+
+	/// <summary>
+	/// Splits [0, count) into contiguous ranges and runs fn(begin, end) on each range in its own thread.
+	/// Runs inline on the calling thread when there is not enough work to split.
+	/// </summary>
+	/// <param name="count">Total number of items</param>
+	/// <param name="minPerThread">Smallest range worth handing to a thread</param>
+	/// <param name="fn">Callable taking (size_t begin, size_t end)</param>
+	template<typename Fn>
+	void parallelFor(size_t count, size_t minPerThread, Fn fn) {
+		size_t numThreads = getNumWorkerThreads();
+		if (minPerThread > 0 && count / minPerThread < numThreads) {
+			numThreads = count / minPerThread;
+		}
+		if (numThreads <= 1) {
+			fn((size_t)0, count);
+			return;
+		}
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads - 1);
+		size_t perThread = count / numThreads;
+		size_t begin = 0;
+		for (size_t i = 0; i < numThreads - 1; i++)
+		{
+			size_t end = begin + perThread;
+			threads.emplace_back(fn, begin, end);
+			begin = end;
+		}
+		//Calling thread takes the last (and possibly largest) range
+		fn(begin, count);
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+}
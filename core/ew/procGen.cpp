@@ -3,7 +3,11 @@
 */
 
 #include "procGen.h"
+#include "parallel.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
@@ -60,181 +64,493 @@ namespace ew {
 		createCubeFace(vec3{ +0.0f,+0.0f,-1.0f }, size, &mesh); //Back
 		return mesh;
 	}
+	//Generators split rows across threads once a thread would get at least this many vertices
+	static const size_t PROCGEN_MIN_VERTICES_PER_THREAD = 32768;
+
+	static size_t minRowsPerThread(size_t columns) {
+		size_t rows = PROCGEN_MIN_VERTICES_PER_THREAD / columns;
+		return rows > 0 ? rows : 1;
+	}
+
 	MeshData createPlane(float width, float height, int subdivisions)
 	{
-		//VERTICES
 		MeshData mesh;
-		int columns = subdivisions + 1;
-		for (size_t row = 0; row <= subdivisions; row++)
-		{
-			for (size_t col = 0; col <= subdivisions; col++)
+		const size_t columns = subdivisions + 1;
+		mesh.vertices.resize(columns * columns);
+		mesh.indices.resize((size_t)subdivisions * subdivisions * 6);
+		Vertex* vertices = mesh.vertices.data();
+		unsigned int* indices = mesh.indices.data();
+
+		//VERTICES
+		parallelFor(columns, minRowsPerThread(columns), [=](size_t rowBegin, size_t rowEnd) {
+			for (size_t row = rowBegin; row < rowEnd; row++)
 			{
-				Vertex v;                                                                                                                                                                                                                                                                                                                                                                                                    
-				v.uv.x = ((float)col / subdivisions);
-				v.uv.y = ((float)row / subdivisions);
-				v.pos.x = -width/2 + width * v.uv.x;
-				v.pos.y = 0;
-				v.pos.z = height/2 -height * v.uv.y;
-				v.normal = vec3(0, 1, 0);
-				mesh.vertices.push_back(v);
+				Vertex* v = vertices + row * columns;
+				float uvY = ((float)row / subdivisions);
+				float posZ = height / 2 - height * uvY;
+				for (size_t col = 0; col <= subdivisions; col++, v++)
+				{
+					v->uv.x = ((float)col / subdivisions);
+					v->uv.y = uvY;
+					v->pos.x = -width / 2 + width * v->uv.x;
+					v->pos.y = 0;
+					v->pos.z = posZ;
+					v->normal = vec3(0, 1, 0);
+				}
 			}
-		}
+		});
 		//INDICES
-		for (size_t row = 0; row < subdivisions; row++)
-		{
-			for (size_t col = 0; col < subdivisions; col++)
+		parallelFor(subdivisions, minRowsPerThread(columns), [=](size_t rowBegin, size_t rowEnd) {
+			unsigned int* i = indices + rowBegin * subdivisions * 6;
+			for (size_t row = rowBegin; row < rowEnd; row++)
 			{
-				int start = row * columns + col;
-				mesh.indices.push_back(start);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns + 1);
-				mesh.indices.push_back(start + columns + 1);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start);
+				for (size_t col = 0; col < subdivisions; col++)
+				{
+					unsigned int start = row * columns + col;
+					*i++ = start;
+					*i++ = start + 1;
+					*i++ = start + columns + 1;
+					*i++ = start + columns + 1;
+					*i++ = start + columns;
+					*i++ = start;
+				}
 			}
-		}
+		});
 		return mesh;
 	}
 	MeshData createSphere(float radius, int subdivisions)
 	{
 		MeshData mesh;
-		//VERTICES
+		const size_t columns = subdivisions + 1;
+		const size_t numSideRows = subdivisions > 2 ? subdivisions - 2 : 0;
+		mesh.vertices.resize(columns * columns);
+		//Top cap + side quads + bottom cap
+		mesh.indices.resize((size_t)subdivisions * 3 + numSideRows * subdivisions * 6 + (size_t)subdivisions * 3);
+		Vertex* vertices = mesh.vertices.data();
+		unsigned int* indices = mesh.indices.data();
+
+		//Trig only depends on row (phi) or column (theta), so compute each once
 		float thetaStep = glm::two_pi<float>() / subdivisions;
 		float phiStep = glm::pi<float>() / subdivisions;
-		for (size_t row = 0; row <= subdivisions; row++)
+		std::vector<float> cosTheta(columns), sinTheta(columns), cosPhi(columns), sinPhi(columns);
+		for (size_t i = 0; i <= subdivisions; i++)
 		{
-			float phi = row * phiStep;
-			for (size_t col = 0; col <= subdivisions; col++)
+			float theta = thetaStep * i;
+			float phi = i * phiStep;
+			cosTheta[i] = cosf(theta);
+			sinTheta[i] = sinf(theta);
+			cosPhi[i] = cosf(phi);
+			sinPhi[i] = sinf(phi);
+		}
+
+		//VERTICES
+		parallelFor(columns, minRowsPerThread(columns), [&](size_t rowBegin, size_t rowEnd) {
+			for (size_t row = rowBegin; row < rowEnd; row++)
 			{
-				float theta = thetaStep * col;
-				Vertex v;
-				v.normal.x = cosf(theta) * sinf(phi);
-				v.normal.y = cosf(phi);
-				v.normal.z = sinf(theta) * sinf(phi);
-				v.pos = v.normal * radius;
-				v.uv.x = (float)col / subdivisions;
-				v.uv.y = 1.0 - ((float)row / subdivisions);
-				mesh.vertices.push_back(v);
+				Vertex* v = vertices + row * columns;
+				float uvY = 1.0 - ((float)row / subdivisions);
+				for (size_t col = 0; col <= subdivisions; col++, v++)
+				{
+					v->normal.x = cosTheta[col] * sinPhi[row];
+					v->normal.y = cosPhi[row];
+					v->normal.z = sinTheta[col] * sinPhi[row];
+					v->pos = v->normal * radius;
+					v->uv.x = (float)col / subdivisions;
+					v->uv.y = uvY;
+				}
 			}
-		}
-		
+		});
+
 		//INDICES
-		unsigned int columns = subdivisions + 1;
 		unsigned int sideStart = columns;
 		unsigned int poleStart = 0;
+		unsigned int* i = indices;
 		//Top cap
-		for (size_t i = 0; i < subdivisions; i++)
+		for (size_t col = 0; col < subdivisions; col++)
 		{
-			mesh.indices.push_back(sideStart + i);
-			mesh.indices.push_back(poleStart + i);
-			mesh.indices.push_back(sideStart +i+1);
+			*i++ = sideStart + col;
+			*i++ = poleStart + col;
+			*i++ = sideStart + col + 1;
 		}
 		//Rows of quads for sides
-		for (size_t row = 1; row < subdivisions - 1; row++)
-		{
-			for (size_t col = 0; col < subdivisions; col++)
+		unsigned int* sideIndices = i;
+		parallelFor(numSideRows, minRowsPerThread(columns), [=](size_t rowBegin, size_t rowEnd) {
+			unsigned int* i = sideIndices + rowBegin * subdivisions * 6;
+			for (size_t row = rowBegin + 1; row < rowEnd + 1; row++)
 			{
-				unsigned int start = row * columns + col;
-				mesh.indices.push_back(start);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns + 1);
+				for (size_t col = 0; col < subdivisions; col++)
+				{
+					unsigned int start = row * columns + col;
+					*i++ = start;
+					*i++ = start + 1;
+					*i++ = start + columns;
+					*i++ = start + columns;
+					*i++ = start + 1;
+					*i++ = start + columns + 1;
+				}
 			}
-		}
+		});
+		i += numSideRows * subdivisions * 6;
 		//Bottom cap
 		poleStart = (columns * columns) - columns;
 		sideStart = poleStart - columns;
-		for (size_t i = 0; i < subdivisions; i++)
+		for (size_t col = 0; col < subdivisions; col++)
 		{
-			mesh.indices.push_back(sideStart + i);
-			mesh.indices.push_back(sideStart + i + 1);
-			mesh.indices.push_back(poleStart + i);
+			*i++ = sideStart + col;
+			*i++ = sideStart + col + 1;
+			*i++ = poleStart + col;
 		}
 		return mesh;
 	}
-	void createCylinderRing(MeshData* meshData, float radius, int subdivisions, float y, bool sideFacing) {
-		float thetaStep = two_pi<float>() / subdivisions;
-		for (size_t i = 0; i <= subdivisions; i++)
+	/// <summary>
+	/// Helper function for createCylinder. Writes subdivisions+1 vertices starting at v.
+	/// </summary>
+	static void createCylinderRing(Vertex* v, const float* cosTable, const float* sinTable, float radius, int subdivisions, float y, bool sideFacing) {
+		for (size_t i = 0; i <= subdivisions; i++, v++)
 		{
-			float theta = i * thetaStep;
-			float cosA = cosf(theta);
-			float sinA = sinf(theta);
-			Vertex v;
-			v.pos = vec3(cosA * radius, y, sinA * radius);
+			float cosA = cosTable[i];
+			float sinA = sinTable[i];
+			v->pos = vec3(cosA * radius, y, sinA * radius);
 			if (sideFacing) {
-				v.normal = vec3(cosA, 0, sinA);
-				v.uv = vec2((float)i / subdivisions, y > 0 ? 1 : 0);
+				v->normal = vec3(cosA, 0, sinA);
+				v->uv = vec2((float)i / subdivisions, y > 0 ? 1 : 0);
 			}
 			else {
-				v.normal = vec3(0, sign(y), 0);
-				v.uv = vec2(cosA * 0.5f + 0.5f, sinA * 0.5f + 0.5f);
+				v->normal = vec3(0, sign(y), 0);
+				v->uv = vec2(cosA * 0.5f + 0.5f, sinA * 0.5f + 0.5f);
 			}
-
-			meshData->vertices.push_back(v);
 		}
 	}
 	MeshData createCylinder(float radius, float height, int subdivisions)
 	{
 		MeshData mesh;
+		const size_t columns = subdivisions + 1;
+		//Top center + 4 rings + bottom center
+		mesh.vertices.resize(columns * 4 + 2);
+		//Top cap + sides + bottom cap
+		mesh.indices.resize(columns * 3 + columns * 6 + columns * 3);
 
 		//VERTICES
 		{
 			const float topY = height * 0.5;
 			const float bottomY = -topY;
 
-			Vertex topVertex;
+			//All four rings share the same angles
+			float thetaStep = two_pi<float>() / subdivisions;
+			std::vector<float> cosTable(columns), sinTable(columns);
+			for (size_t i = 0; i <= subdivisions; i++)
+			{
+				float theta = i * thetaStep;
+				cosTable[i] = cosf(theta);
+				sinTable[i] = sinf(theta);
+			}
+
+			Vertex& topVertex = mesh.vertices[0];
 			topVertex.pos = vec3(0, topY, 0);
 			topVertex.normal = vec3(0, 1, 0);
 			topVertex.uv = vec2(0.5f);
-			mesh.vertices.push_back(topVertex);
 
-			createCylinderRing(&mesh, radius, subdivisions, topY, false);
-			createCylinderRing(&mesh, radius, subdivisions, topY, true);
-			createCylinderRing(&mesh, radius, subdivisions, bottomY, true);
-			createCylinderRing(&mesh, radius, subdivisions, bottomY, false);
+			Vertex* ring = mesh.vertices.data() + 1;
+			createCylinderRing(ring, cosTable.data(), sinTable.data(), radius, subdivisions, topY, false);
+			createCylinderRing(ring + columns, cosTable.data(), sinTable.data(), radius, subdivisions, topY, true);
+			createCylinderRing(ring + columns * 2, cosTable.data(), sinTable.data(), radius, subdivisions, bottomY, true);
+			createCylinderRing(ring + columns * 3, cosTable.data(), sinTable.data(), radius, subdivisions, bottomY, false);
 
-			Vertex bottomVertex;
+			Vertex& bottomVertex = mesh.vertices.back();
 			bottomVertex.pos = vec3(0, bottomY, 0);
 			bottomVertex.normal = vec3(0, -1, 0);
 			bottomVertex.uv = vec2(0.5f);
-			mesh.vertices.push_back(bottomVertex);
 		}
-		
 
 		//INDICES
 		{
-			int columns = subdivisions + 1;
+			unsigned int* index = mesh.indices.data();
 			//Top cap
 			for (size_t i = 0; i < columns; i++)
 			{
-				mesh.indices.push_back(0);
-				mesh.indices.push_back(i + 1);
-				mesh.indices.push_back(i);
+				*index++ = 0;
+				*index++ = i + 1;
+				*index++ = i;
 			}
 			int sideStart = columns;
 			//Sides
 			for (size_t i = 0; i < columns; i++)
 			{
 				unsigned int start = sideStart + i;
-				mesh.indices.push_back(start);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns + 1);
+				*index++ = start;
+				*index++ = start + 1;
+				*index++ = start + columns;
+				*index++ = start + columns;
+				*index++ = start + 1;
+				*index++ = start + columns + 1;
 			}
 			//Bottom cap
 			unsigned int bottomIndex = mesh.vertices.size() - 1;
 			sideStart = bottomIndex - columns;
 			for (size_t i = 0; i < columns; i++)
 			{
-				mesh.indices.push_back(bottomIndex);
-				mesh.indices.push_back(sideStart + i);
-				mesh.indices.push_back(sideStart + i + 1);
+				*index++ = bottomIndex;
+				*index++ = sideStart + i;
+				*index++ = sideStart + i + 1;
 			}
 		}
 		return mesh;
 	}
-}
\ No newline at end of file
+
+	//Builds icosphere geometry on the unit sphere. Midpoints are cached per edge so neighboring faces share them.
+	class IcosphereBuilder {
+	public:
+		std::vector<vec3> positions;
+		std::vector<unsigned int> indices;
+
+		IcosphereBuilder() {
+			const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+			const vec3 corners[12] = {
+				vec3(-1, t, 0), vec3(1, t, 0), vec3(-1, -t, 0), vec3(1, -t, 0),
+				vec3(0, -1, t), vec3(0, 1, t), vec3(0, -1, -t), vec3(0, 1, -t),
+				vec3(t, 0, -1), vec3(t, 0, 1), vec3(-t, 0, -1), vec3(-t, 0, 1)
+			};
+			for (int i = 0; i < 12; i++)
+			{
+				positions.push_back(normalize(corners[i]));
+			}
+		}
+		unsigned int midpoint(unsigned int a, unsigned int b) {
+			uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+			auto it = m_edgeCache.find(key);
+			if (it != m_edgeCache.end())
+				return it->second;
+			unsigned int index = positions.size();
+			positions.push_back(normalize(positions[a] + positions[b]));
+			m_edgeCache.emplace(key, index);
+			return index;
+		}
+		void reserve(size_t numVertices, size_t numIndices) {
+			positions.reserve(numVertices);
+			indices.reserve(numIndices);
+			m_edgeCache.reserve(numVertices);
+		}
+	private:
+		std::unordered_map<uint64_t, unsigned int> m_edgeCache;
+	};
+
+	static const unsigned int ICOSAHEDRON_FACES[20][3] = {
+		{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+		{1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+		{3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+		{4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+	};
+
+	/// <summary>
+	/// Converts unit sphere positions to a MeshData with the same UV convention as createSphere.
+	/// Triangles that straddle the u = 0/1 seam get duplicated seam vertices so UVs don't wrap across the whole texture.
+	/// </summary>
+	static MeshData finishIcosphere(const IcosphereBuilder& builder, float radius) {
+		MeshData mesh;
+		mesh.vertices.resize(builder.positions.size());
+		for (size_t i = 0; i < builder.positions.size(); i++)
+		{
+			Vertex& v = mesh.vertices[i];
+			v.normal = builder.positions[i];
+			v.pos = v.normal * radius;
+			float u = atan2f(v.normal.z, v.normal.x) / two_pi<float>();
+			v.uv.x = u < 0.0f ? u + 1.0f : u;
+			v.uv.y = 1.0f - acosf(clamp(v.normal.y, -1.0f, 1.0f)) / pi<float>();
+		}
+		mesh.indices = builder.indices;
+		size_t numShared = mesh.vertices.size();
+		std::unordered_map<unsigned int, unsigned int> seamCopies;
+		for (size_t t = 0; t < mesh.indices.size(); t += 3)
+		{
+			unsigned int* tri = &mesh.indices[t];
+			float minU = 1.0f, maxU = 0.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				minU = min(minU, mesh.vertices[tri[i]].uv.x);
+				maxU = max(maxU, mesh.vertices[tri[i]].uv.x);
+			}
+			if (maxU - minU <= 0.5f)
+				continue;
+			for (int i = 0; i < 3; i++)
+			{
+				if (tri[i] >= numShared || mesh.vertices[tri[i]].uv.x >= 0.5f)
+					continue;
+				auto it = seamCopies.find(tri[i]);
+				if (it == seamCopies.end()) {
+					Vertex copy = mesh.vertices[tri[i]];
+					copy.uv.x += 1.0f;
+					it = seamCopies.emplace(tri[i], (unsigned int)mesh.vertices.size()).first;
+					mesh.vertices.push_back(copy);
+				}
+				tri[i] = it->second;
+			}
+		}
+		return mesh;
+	}
+
+	MeshData createIcosphere(float radius, int subdivisions)
+	{
+		IcosphereBuilder builder;
+		//Each level: faces x4, vertices = 10 * 4^n + 2
+		size_t numFaces = 20;
+		for (int i = 0; i < subdivisions; i++)
+		{
+			numFaces *= 4;
+		}
+		builder.reserve(numFaces / 2 + 2, numFaces * 3);
+		std::vector<unsigned int> faces(&ICOSAHEDRON_FACES[0][0], &ICOSAHEDRON_FACES[0][0] + 60);
+		std::vector<unsigned int> nextFaces;
+		for (int level = 0; level < subdivisions; level++)
+		{
+			nextFaces.clear();
+			nextFaces.reserve(faces.size() * 4);
+			for (size_t f = 0; f < faces.size(); f += 3)
+			{
+				unsigned int a = faces[f], b = faces[f + 1], c = faces[f + 2];
+				unsigned int ab = builder.midpoint(a, b);
+				unsigned int bc = builder.midpoint(b, c);
+				unsigned int ca = builder.midpoint(c, a);
+				const unsigned int children[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+				nextFaces.insert(nextFaces.end(), children, children + 12);
+			}
+			faces.swap(nextFaces);
+		}
+		builder.indices = faces;
+		return finishIcosphere(builder, radius);
+	}
+
+	//Pixels per world unit at a given distance from the camera
+	static float pixelsPerUnit(const ew::Camera& camera, float screenHeight, float distance) {
+		if (camera.orthographic)
+			return screenHeight / camera.orthoHeight;
+		return screenHeight / (2.0f * tanf(radians(camera.fov) * 0.5f) * max(distance, camera.nearPlane));
+	}
+
+	//Distance from a chord to the sphere surface for an edge spanning angle theta
+	static float chordError(float radius, float theta) {
+		return radius * (1.0f - cosf(theta * 0.5f));
+	}
+
+	int icosphereSubdivisionsForError(float radius, const glm::vec3& center, const ew::Camera& camera, float screenHeight, float maxPixelError, int maxSubdivisions)
+	{
+		//Closest surface point to the camera has the largest projected error
+		float distance = max(glm::length(camera.position - center) - radius, camera.nearPlane);
+		float scale = pixelsPerUnit(camera, screenHeight, distance);
+		//Icosahedron edge angle, halves every level
+		float theta = 1.10714872f;
+		for (int level = 0; level < maxSubdivisions; level++, theta *= 0.5f)
+		{
+			if (chordError(radius, theta) * scale <= maxPixelError)
+				return level;
+		}
+		return maxSubdivisions;
+	}
+
+	struct AdaptiveIcosphereContext {
+		IcosphereBuilder* builder;
+		float radius;
+		vec3 center;
+		const ew::Camera* camera;
+		float screenHeight;
+		float maxPixelError;
+		float minEdgeDot; //Edges shorter than the maxSubdivisions edge are never split
+	};
+
+	//Split decision depends only on the edge's endpoints, so both faces sharing an edge always agree (no T-junctions)
+	static bool shouldSplitEdge(const AdaptiveIcosphereContext& ctx, unsigned int a, unsigned int b) {
+		const vec3& pa = ctx.builder->positions[a];
+		const vec3& pb = ctx.builder->positions[b];
+		float cosTheta = dot(pa, pb);
+		if (cosTheta >= ctx.minEdgeDot)
+			return false;
+		float theta = acosf(clamp(cosTheta, -1.0f, 1.0f));
+		vec3 mid = ctx.center + normalize(pa + pb) * ctx.radius;
+		float distance = glm::length(ctx.camera->position - mid);
+		return chordError(ctx.radius, theta) * pixelsPerUnit(*ctx.camera, ctx.screenHeight, distance) > ctx.maxPixelError;
+	}
+
+	static void refineAdaptive(const AdaptiveIcosphereContext& ctx, unsigned int a, unsigned int b, unsigned int c) {
+		bool splitAB = shouldSplitEdge(ctx, a, b);
+		bool splitBC = shouldSplitEdge(ctx, b, c);
+		bool splitCA = shouldSplitEdge(ctx, c, a);
+		int numSplits = splitAB + splitBC + splitCA;
+		if (numSplits == 0) {
+			ctx.builder->indices.push_back(a);
+			ctx.builder->indices.push_back(b);
+			ctx.builder->indices.push_back(c);
+			return;
+		}
+		//Rotate so the split pattern starts at edge ab (1 split) or leaves ca unsplit (2 splits)
+		if (numSplits == 1 && !splitAB) {
+			if (splitBC)
+				refineAdaptive(ctx, b, c, a);
+			else
+				refineAdaptive(ctx, c, a, b);
+			return;
+		}
+		if (numSplits == 2 && splitCA) {
+			if (!splitAB)
+				refineAdaptive(ctx, b, c, a);
+			else
+				refineAdaptive(ctx, c, a, b);
+			return;
+		}
+		unsigned int ab = ctx.builder->midpoint(a, b);
+		if (numSplits == 1) {
+			refineAdaptive(ctx, a, ab, c);
+			refineAdaptive(ctx, ab, b, c);
+			return;
+		}
+		unsigned int bc = ctx.builder->midpoint(b, c);
+		if (numSplits == 2) {
+			refineAdaptive(ctx, ab, b, bc);
+			refineAdaptive(ctx, a, ab, bc);
+			refineAdaptive(ctx, a, bc, c);
+			return;
+		}
+		unsigned int ca = ctx.builder->midpoint(c, a);
+		refineAdaptive(ctx, a, ab, ca);
+		refineAdaptive(ctx, b, bc, ab);
+		refineAdaptive(ctx, c, ca, bc);
+		refineAdaptive(ctx, ab, bc, ca);
+	}
+
+	MeshData createAdaptiveIcosphere(float radius, const glm::vec3& center, const ew::Camera& camera, float screenHeight, float maxPixelError, int maxSubdivisions)
+	{
+		IcosphereBuilder builder;
+		AdaptiveIcosphereContext ctx;
+		ctx.builder = &builder;
+		ctx.radius = radius;
+		ctx.center = center;
+		ctx.camera = &camera;
+		ctx.screenHeight = screenHeight;
+		ctx.maxPixelError = maxPixelError;
+		//Slightly above the level-maxSubdivisions edge so float noise can't allow one extra level
+		float minTheta = 1.10714872f / (float)(1 << maxSubdivisions);
+		ctx.minEdgeDot = cosf(minTheta * 1.5f);
+		for (int f = 0; f < 20; f++)
+		{
+			refineAdaptive(ctx, ICOSAHEDRON_FACES[f][0], ICOSAHEDRON_FACES[f][1], ICOSAHEDRON_FACES[f][2]);
+		}
+		return finishIcosphere(builder, radius);
+	}
+
+	float sphereMaxGeometricError(const MeshData& mesh, float radius)
+	{
+		//For a triangle inscribed in the sphere, the deepest point is where the plane is closest to the center
+		float maxError = 0.0f;
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+		{
+			vec3 a = mesh.vertices[mesh.indices[t]].pos;
+			vec3 b = mesh.vertices[mesh.indices[t + 1]].pos;
+			vec3 c = mesh.vertices[mesh.indices[t + 2]].pos;
+			vec3 n = cross(b - a, c - a);
+			float area = glm::length(n);
+			if (area <= 0.0f)
+				continue;
+			float planeDistance = fabsf(dot(n / area, a));
+			maxError = max(maxError, radius - planeDistance);
+		}
+		return maxError;
+	}
+}
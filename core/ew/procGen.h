@@ -4,10 +4,20 @@
 
 #pragma once
 #include "mesh.h"
+#include "camera.h"
 
 namespace ew {
 	MeshData createCube(float size);
 	MeshData createPlane(float width, float height, int subdivisions);
 	MeshData createSphere(float radius, int subdivisions);
 	MeshData createCylinder(float radius, float height, int subdivisions);
+
+	//Icosahedron with each face split into 4, subdivisions times. Edge midpoints are shared between faces.
+	MeshData createIcosphere(float radius, int subdivisions);
+	//Icosphere refined per edge until each edge's projected error is under maxPixelError. Crack free.
+	MeshData createAdaptiveIcosphere(float radius, const glm::vec3& center, const ew::Camera& camera, float screenHeight, float maxPixelError, int maxSubdivisions = 7);
+	//Uniform icosphere level that meets maxPixelError for a sphere at the given center
+	int icosphereSubdivisionsForError(float radius, const glm::vec3& center, const ew::Camera& camera, float screenHeight, float maxPixelError, int maxSubdivisions = 7);
+	//Largest distance between a triangle and the true sphere surface, for comparing sphere tessellations
+	float sphereMaxGeometricError(const MeshData& mesh, float radius);
 }
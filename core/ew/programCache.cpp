@@ -0,0 +1,167 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "programCache.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace ew {
+	static const char PROGRAM_CACHE_MAGIC[4] = { 'E', 'W', 'P', 'B' };
+	static const uint32_t PROGRAM_CACHE_VERSION = 1;
+	static std::string programCacheDirectory = "shadercache";
+
+	struct ProgramCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key; //Guards against hash collisions in the file name
+		uint32_t binaryFormat;
+		uint32_t binaryLength;
+	};
+
+	static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+	static const uint64_t FNV_PRIME = 1099511628211ull;
+
+	static uint64_t hashBytes(uint64_t hash, const char* data, size_t length) {
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= FNV_PRIME;
+		}
+		//Separator, so "ab" + "c" and "a" + "bc" hash differently
+		hash ^= 0xFF;
+		hash *= FNV_PRIME;
+		return hash;
+	}
+
+	static std::string cachePath(uint64_t key) {
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx.ewprog", (unsigned long long)key);
+		return programCacheDirectory + name;
+	}
+
+	static bool binariesSupported() {
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		return numFormats > 0;
+	}
+
+	void setProgramCacheDirectory(const std::string& directory)
+	{
+		programCacheDirectory = directory;
+	}
+
+	const std::string& getProgramCacheDirectory()
+	{
+		return programCacheDirectory;
+	}
+
+	uint64_t hashProgramSources(const char* vertexShaderSource, const char* fragmentShaderSource)
+	{
+		uint64_t hash = FNV_OFFSET;
+		hash = hashBytes(hash, vertexShaderSource, strlen(vertexShaderSource));
+		hash = hashBytes(hash, fragmentShaderSource, strlen(fragmentShaderSource));
+		//Binaries are only valid for the driver that made them
+		const GLenum driverStrings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (int i = 0; i < 3; i++)
+		{
+			const char* str = (const char*)glGetString(driverStrings[i]);
+			if (str) {
+				hash = hashBytes(hash, str, strlen(str));
+			}
+		}
+		return hash;
+	}
+
+	unsigned int loadProgramBinary(uint64_t key, bool* rejected)
+	{
+		if (rejected)
+			*rejected = false;
+		if (programCacheDirectory.empty() || !binariesSupported())
+			return 0;
+		FILE* file = fopen(cachePath(key).c_str(), "rb");
+		if (file == NULL)
+			return 0;
+		ProgramCacheHeader header;
+		std::vector<char> binary;
+		bool ok = fread(&header, sizeof(header), 1, file) == 1
+			&& memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) == 0
+			&& header.version == PROGRAM_CACHE_VERSION
+			&& header.key == key;
+		if (ok) {
+			//A truncated or corrupt file must not size the allocation
+			long binaryStart = ftell(file);
+			ok = binaryStart >= 0 && fseek(file, 0, SEEK_END) == 0;
+			long fileEnd = ok ? ftell(file) : -1;
+			ok = ok && fileEnd >= binaryStart && (uint64_t)(fileEnd - binaryStart) >= header.binaryLength
+				&& header.binaryLength > 0 && fseek(file, binaryStart, SEEK_SET) == 0;
+		}
+		if (ok) {
+			binary.resize(header.binaryLength);
+			ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+		}
+		fclose(file);
+		if (!ok)
+			return 0;
+
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+		int success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			//Drivers may refuse binaries from other versions. The caller recompiles and overwrites the entry.
+			glDeleteProgram(program);
+			if (rejected)
+				*rejected = true;
+			return 0;
+		}
+		return program;
+	}
+
+	bool saveProgramBinary(uint64_t key, unsigned int program)
+	{
+		if (programCacheDirectory.empty() || !binariesSupported())
+			return false;
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return false;
+		std::vector<char> binary(length);
+		GLenum format;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		ProgramCacheHeader header;
+		memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+		header.version = PROGRAM_CACHE_VERSION;
+		header.key = key;
+		header.binaryFormat = format;
+		header.binaryLength = (uint32_t)length;
+
+		//Fails harmlessly if it already exists
+#ifdef _WIN32
+		_mkdir(programCacheDirectory.c_str());
+#else
+		mkdir(programCacheDirectory.c_str(), 0755);
+#endif
+		std::string path = cachePath(key);
+		FILE* file = fopen(path.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write program cache %s", path.c_str());
+			return false;
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(binary.data(), 1, length, file) == (size_t)length;
+		fclose(file);
+		if (!ok) {
+			remove(path.c_str());
+		}
+		return ok;
+	}
+}
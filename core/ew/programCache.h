@@ -0,0 +1,25 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <stdint.h>
+#include <string>
+
+namespace ew {
+	struct ProgramLoadStats {
+		bool fromCache = false; //Warm: linked from a cached binary instead of compiling
+		bool binaryRejected = false; //A cached binary existed but the driver refused it (e.g. after a driver update)
+		double milliseconds = 0.0; //Reading sources through to a linked program
+	};
+
+	//Folder cached program binaries are kept in, relative to the working directory. Empty disables the cache. Default "shadercache".
+	void setProgramCacheDirectory(const std::string& directory);
+	const std::string& getProgramCacheDirectory();
+	//64 bit FNV-1a over every stage's source (after any define injection) and the GL vendor, renderer and version strings
+	uint64_t hashProgramSources(const char* vertexShaderSource, const char* fragmentShaderSource);
+	//Linked program from the binary cached under key, or 0 if there is none or the driver rejected it
+	unsigned int loadProgramBinary(uint64_t key, bool* rejected = nullptr);
+	//Caches a linked program under key. Best created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+	bool saveProgramBinary(uint64_t key, unsigned int program);
+}
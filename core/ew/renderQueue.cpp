@@ -0,0 +1,244 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "renderQueue.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	namespace {
+		const int PASS_BITS = 4;
+		const int SHADER_BITS = 10;
+		const int MATERIAL_BITS = 14;
+		const int MESH_BITS = 16;
+		const int DEPTH_BITS = 20;
+		const int MESH_SHIFT = DEPTH_BITS;
+		const int MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+		const int SHADER_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+		const int PASS_SHIFT = SHADER_SHIFT + SHADER_BITS;
+		static_assert(PASS_SHIFT + PASS_BITS == 64, "Sort key fields must fill 64 bits");
+		static_assert(RENDER_MAX_PASSES <= (1 << PASS_BITS), "Pass does not fit in the sort key");
+
+		//State left behind by the previous packet
+		struct BoundState {
+			const Shader* shader = nullptr;
+			const RenderMaterial* material = nullptr;
+			const void* mesh = nullptr;
+			unsigned int textures[RENDER_MAX_TEXTURE_UNITS] = {};
+		};
+
+		struct StateChanges {
+			int programs = 0;
+			int textures = 0;
+			int meshes = 0;
+		};
+
+		/// <summary>
+		/// Moves state to what packet needs, counting each change. Only issues GL calls when issue is set.
+		/// </summary>
+		void applyState(BoundState* state, const DrawPacket& packet, StateChanges* changes, bool issue) {
+			bool programChanged = packet.shader != state->shader;
+			if (programChanged) {
+				state->shader = packet.shader;
+				changes->programs++;
+				if (issue) {
+					packet.shader->use();
+				}
+			}
+			//Material uniforms live in the program, so they need setting again after a program change
+			if (packet.material && (programChanged || packet.material != state->material)) {
+				const RenderMaterial* material = packet.material;
+				for (int unit = 0; unit < RENDER_MAX_TEXTURE_UNITS; unit++)
+				{
+					unsigned int texture = material->textures[unit];
+					if (texture == 0 || texture == state->textures[unit]) {
+						continue;
+					}
+					state->textures[unit] = texture;
+					changes->textures++;
+					if (issue) {
+						bindTextureUnit(unit, texture);
+					}
+				}
+				if (issue && material->uniformBuffer) {
+					//Buffer bindings are not per program, so only a material change needs a rebind
+					if (material != state->material) {
+						material->uniformBuffer->bind(UNIFORM_BLOCK_MATERIAL);
+					}
+				}
+				else if (issue) {
+					packet.shader->setFloat("_Material.Ka", material->Ka);
+					packet.shader->setFloat("_Material.Kd", material->Kd);
+					packet.shader->setFloat("_Material.Ks", material->Ks);
+					packet.shader->setFloat("_Material.Shininess", material->Shininess);
+				}
+			}
+			state->material = packet.material;
+			const void* mesh = packet.mesh ? (const void*)packet.mesh : (const void*)packet.model;
+			if (mesh != state->mesh) {
+				state->mesh = mesh;
+				changes->meshes++;
+			}
+		}
+
+		uint32_t numberFor(std::unordered_map<const void*, uint32_t>* ids, const void* ptr, int bits) {
+			if (!ptr) {
+				return 0;
+			}
+			auto it = ids->find(ptr);
+			if (it != ids->end()) {
+				return it->second;
+			}
+			//0 is kept for null. Past the limit everything shares the last number, which only costs sort quality.
+			uint32_t id = std::min((uint32_t)ids->size() + 1, (1u << bits) - 1);
+			ids->emplace(ptr, id);
+			return id;
+		}
+	}
+
+	void RenderQueue::clear()
+	{
+		m_packets.clear();
+		m_items.clear();
+		m_shaderIds.clear();
+		m_materialIds.clear();
+		m_meshIds.clear();
+		m_usedPasses = 0;
+		m_sorted = false;
+		m_stats = RenderQueueStats();
+	}
+
+	void RenderQueue::submit(const DrawPacket& packet)
+	{
+		if ((!packet.mesh && !packet.model) || !packet.shader || packet.pass < 0 || packet.pass >= RENDER_MAX_PASSES) {
+			printf("Failed to submit draw packet: needs a mesh or model, a shader and a pass in [0, %d)", RENDER_MAX_PASSES);
+			return;
+		}
+		SortItem item;
+		item.key = makeKey(packet);
+		item.packet = (uint32_t)m_packets.size();
+		m_items.push_back(item);
+		m_packets.push_back(packet);
+		m_usedPasses |= 1u << packet.pass;
+		m_sorted = false;
+	}
+
+	uint64_t RenderQueue::makeKey(const DrawPacket& packet)
+	{
+		uint64_t shader = numberFor(&m_shaderIds, packet.shader, SHADER_BITS);
+		uint64_t material = numberFor(&m_materialIds, packet.material, MATERIAL_BITS);
+		uint64_t mesh = numberFor(&m_meshIds, packet.mesh ? (const void*)packet.mesh : (const void*)packet.model, MESH_BITS);
+		//Bit patterns of non-negative floats sort the same as their values, so the top bits make an ordered depth
+		float depth = std::max(packet.depth, 0.0f);
+		uint32_t depthBits;
+		memcpy(&depthBits, &depth, sizeof(depthBits));
+		depthBits >>= 32 - DEPTH_BITS;
+		return ((uint64_t)packet.pass << PASS_SHIFT) | (shader << SHADER_SHIFT) | (material << MATERIAL_SHIFT) | (mesh << MESH_SHIFT) | depthBits;
+	}
+
+	/// <summary>
+	/// LSD radix sort, 8 bits per pass. All 8 histograms are built in one read, and digits every key shares are skipped,
+	/// so a frame with few passes/shaders/materials usually needs about half the passes.
+	/// </summary>
+	void RenderQueue::sort()
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		size_t count = m_items.size();
+		uint32_t histograms[8][256] = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			uint64_t key = m_items[i].key;
+			for (int digit = 0; digit < 8; digit++)
+			{
+				histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+			}
+		}
+		m_scratch.resize(count);
+		for (int digit = 0; digit < 8; digit++)
+		{
+			uint32_t* histogram = histograms[digit];
+			if (count == 0 || histogram[(m_items[0].key >> (digit * 8)) & 0xFF] == count) {
+				continue;
+			}
+			//Histogram -> start offset of each bucket
+			uint32_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++)
+			{
+				uint32_t bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				const SortItem& item = m_items[i];
+				m_scratch[histogram[(item.key >> (digit * 8)) & 0xFF]++] = item;
+			}
+			m_items.swap(m_scratch);
+		}
+		m_sorted = true;
+		m_stats.packets = (int)count;
+		m_stats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		countUnsortedChanges();
+	}
+
+	void RenderQueue::countUnsortedChanges()
+	{
+		StateChanges changes;
+		for (int pass = 0; pass < RENDER_MAX_PASSES; pass++)
+		{
+			if (!(m_usedPasses & (1u << pass))) {
+				continue;
+			}
+			//State is unknown at the start of each pass, same as execute()
+			BoundState state;
+			for (size_t i = 0; i < m_packets.size(); i++)
+			{
+				if (m_packets[i].pass == pass) {
+					applyState(&state, m_packets[i], &changes, false);
+				}
+			}
+		}
+		m_stats.unsortedProgramChanges = changes.programs;
+		m_stats.unsortedTextureBinds = changes.textures;
+		m_stats.unsortedMeshChanges = changes.meshes;
+	}
+
+	void RenderQueue::execute(int pass, const std::string& modelUniform)
+	{
+		if (!m_sorted) {
+			sort();
+		}
+		auto startTime = std::chrono::high_resolution_clock::now();
+		//Pass is the top of the key, so its packets are one contiguous run
+		uint64_t passKey = (uint64_t)pass << PASS_SHIFT;
+		auto first = std::lower_bound(m_items.begin(), m_items.end(), passKey,
+			[](const SortItem& item, uint64_t key) { return item.key < key; });
+		BoundState state;
+		StateChanges changes;
+		UniformHandle modelHandle;
+		for (auto it = first; it != m_items.end() && (it->key >> PASS_SHIFT) == (uint64_t)pass; ++it)
+		{
+			const DrawPacket& packet = m_packets[it->packet];
+			if (packet.shader != state.shader) {
+				modelHandle = packet.shader->getUniformHandle(modelUniform);
+			}
+			applyState(&state, packet, &changes, true);
+			packet.shader->setMat4(modelHandle, packet.transform);
+			if (packet.mesh) {
+				packet.mesh->draw();
+			}
+			else {
+				packet.model->draw();
+			}
+		}
+		m_stats.programChanges += changes.programs;
+		m_stats.textureBinds += changes.textures;
+		m_stats.meshChanges += changes.meshes;
+		m_stats.executeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+}
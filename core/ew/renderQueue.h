@@ -0,0 +1,99 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+#include "model.h"
+#include "shader.h"
+#include "uniformBuffer.h"
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ew {
+	const int RENDER_MAX_TEXTURE_UNITS = 4;
+	const int RENDER_MAX_PASSES = 16;
+
+	/// <summary>
+	/// Textures and _Material uniforms shared by every packet that points at it.
+	/// </summary>
+	struct RenderMaterial {
+		unsigned int textures[RENDER_MAX_TEXTURE_UNITS] = {}; //Texture bound to each unit. 0 = leave the unit alone.
+		//Optional std140 block bound at UNIFORM_BLOCK_MATERIAL. When set, the values below are not uploaded as uniforms.
+		const UniformBuffer* uniformBuffer = nullptr;
+		float Ka = 1.0f;
+		float Kd = 0.5f;
+		float Ks = 0.5f;
+		float Shininess = 128.0f;
+	};
+
+	/// <summary>
+	/// One draw. Set either mesh or model. Pointed-to objects must outlive the frame the packet is executed in.
+	/// </summary>
+	struct DrawPacket {
+		const Mesh* mesh = nullptr;
+		Model* model = nullptr;
+		const Shader* shader = nullptr;
+		const RenderMaterial* material = nullptr; //Optional, e.g. depth only passes
+		glm::mat4 transform = glm::mat4(1.0f); //Model -> world
+		int pass = 0; //[0, RENDER_MAX_PASSES)
+		float depth = 0.0f; //Non-negative. Lower draws first within the same state (e.g. view distance for front to back).
+	};
+
+	struct RenderQueueStats {
+		int packets = 0;
+		//State changes issued by execute() in sorted order
+		int programChanges = 0;
+		int textureBinds = 0;
+		int meshChanges = 0;
+		//State changes the same packets would have needed drawn in submission order, like a direct draw loop
+		int unsortedProgramChanges = 0;
+		int unsortedTextureBinds = 0;
+		int unsortedMeshChanges = 0;
+		double sortMs = 0.0;
+		double executeMs = 0.0; //CPU time, summed over every pass executed this frame
+	};
+
+	/// <summary>
+	/// Collects draw packets for a frame, sorts them by a packed 64 bit key and draws them with as few program,
+	/// texture and mesh changes as possible.
+	/// Key, high to low bits: pass (4) | shader (10) | material (14) | mesh (16) | depth (20).
+	/// Shaders, materials and meshes are numbered in order of first submission each frame.
+	/// Per-frame uniforms (view projection, lights...) must be set on each shader before execute(); only the model
+	/// matrix and material uniforms are set by the queue.
+	/// </summary>
+	class RenderQueue {
+	public:
+		//Starts a new frame. Keeps allocations.
+		void clear();
+		void submit(const DrawPacket& packet);
+		//Radix sorts the packets submitted since clear(). Call once, before the first execute().
+		void sort();
+		//Draws every packet of one pass in key order
+		/// <param name="modelUniform">Name of the model matrix uniform in this pass's shaders</param>
+		void execute(int pass, const std::string& modelUniform);
+		inline size_t getNumPackets()const { return m_packets.size(); }
+		//Stats for the frame since the last clear()
+		inline const RenderQueueStats& getStats()const { return m_stats; }
+	private:
+		struct SortItem {
+			uint64_t key;
+			uint32_t packet;
+		};
+		uint64_t makeKey(const DrawPacket& packet);
+		void countUnsortedChanges();
+
+		std::vector<DrawPacket> m_packets;
+		std::vector<SortItem> m_items; //Sorted after sort()
+		std::vector<SortItem> m_scratch;
+		//Pointer -> number in order of first submission, for the key
+		std::unordered_map<const void*, uint32_t> m_shaderIds;
+		std::unordered_map<const void*, uint32_t> m_materialIds;
+		std::unordered_map<const void*, uint32_t> m_meshIds;
+		uint32_t m_usedPasses = 0; //Bit per pass with at least one packet
+		bool m_sorted = false;
+		RenderQueueStats m_stats;
+	};
+}
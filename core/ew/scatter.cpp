@@ -0,0 +1,261 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "scatter.h"
+#include "parallel.h"
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+
+namespace ew {
+	//Tiles are this many grid cells wide. Must be at least 2 so same-phase tiles never read each other's cells.
+	static const int SCATTER_TILE_CELLS = 32;
+
+	//xorshift32, seeded per tile so results do not depend on which thread runs the tile
+	struct ScatterRandom {
+		uint32_t state;
+		ScatterRandom(uint32_t seed) : state(seed != 0 ? seed : 0x9E3779B9u) {}
+		inline uint32_t next() {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+		//[0, 1)
+		inline float nextFloat() {
+			return (next() >> 8) * (1.0f / 16777216.0f);
+		}
+	};
+
+	static uint32_t hashTile(uint32_t seed, int tileX, int tileZ, uint32_t stream) {
+		uint32_t h = seed * 0x9E3779B1u ^ (uint32_t)tileX * 0x85EBCA77u ^ (uint32_t)tileZ * 0xC2B2AE3Du ^ stream * 0x27D4EB2Fu;
+		h ^= h >> 15;
+		h *= 0x2C1B3C6Du;
+		h ^= h >> 12;
+		h *= 0x297A2D39u;
+		h ^= h >> 15;
+		return h;
+	}
+
+	//Background grid with cells small enough (minDistance / sqrt(2)) to hold at most one point each
+	struct ScatterGrid {
+		glm::vec2 origin;
+		float cellSize;
+		float minDistanceSq;
+		int width, height;
+		std::vector<glm::vec2> cells; //Empty cells hold FLT_MAX, which is never within minDistance of anything
+
+		inline int cellX(float x)const { return (int)((x - origin.x) / cellSize); }
+		inline int cellZ(float z)const { return (int)((z - origin.y) / cellSize); }
+
+		bool fits(glm::vec2 p, int cx, int cz)const {
+			int x0 = cx - 2 < 0 ? 0 : cx - 2;
+			int x1 = cx + 2 >= width ? width - 1 : cx + 2;
+			int z0 = cz - 2 < 0 ? 0 : cz - 2;
+			int z1 = cz + 2 >= height ? height - 1 : cz + 2;
+			for (int z = z0; z <= z1; z++)
+			{
+				const glm::vec2* row = cells.data() + (size_t)z * width;
+				for (int x = x0; x <= x1; x++)
+				{
+					//Corner cells of the 5x5 block are at least minDistance away
+					if ((x - cx) * (x - cx) + (z - cz) * (z - cz) == 8)
+						continue;
+					glm::vec2 d = row[x] - p;
+					if (d.x * d.x + d.y * d.y < minDistanceSq)
+						return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	struct ScatterTile {
+		int x, z;
+		int cellX0, cellZ0, cellX1, cellZ1; //Cell range owned by this tile, exclusive end
+		std::vector<glm::vec2> points;
+		size_t numKept = 0;
+		size_t outputOffset = 0;
+	};
+
+	/// <summary>
+	/// Bridson's algorithm restricted to one tile. Reads neighboring cells from tiles sampled in earlier phases,
+	/// writes only cells owned by this tile.
+	/// </summary>
+	static void sampleTile(ScatterTile* tile, ScatterGrid* grid, const ScatterSettings& settings) {
+		ScatterRandom random(hashTile(settings.seed, tile->x, tile->z, 0));
+		const float r = settings.minDistance;
+		//World bounds of the owned cells, clipped to the scatter area
+		glm::vec2 bMin = grid->origin + glm::vec2(tile->cellX0, tile->cellZ0) * grid->cellSize;
+		glm::vec2 bMax = glm::min(grid->origin + glm::vec2(tile->cellX1, tile->cellZ1) * grid->cellSize, settings.max);
+		glm::vec2 bSize = bMax - bMin;
+
+		const float candidateRadius = r * 1.0001f;
+		const float stepCos = cosf(6.28318531f / settings.attempts);
+		const float stepSin = sinf(6.28318531f / settings.attempts);
+
+		std::vector<int> active;
+		auto tryInsert = [&](glm::vec2 p) {
+			if (p.x < bMin.x || p.y < bMin.y || p.x >= bMax.x || p.y >= bMax.y)
+				return false;
+			int cx = grid->cellX(p.x);
+			int cz = grid->cellZ(p.y);
+			//Guard against rounding at the tile edge
+			cx = cx < tile->cellX0 ? tile->cellX0 : (cx >= tile->cellX1 ? tile->cellX1 - 1 : cx);
+			cz = cz < tile->cellZ0 ? tile->cellZ0 : (cz >= tile->cellZ1 ? tile->cellZ1 - 1 : cz);
+			if (!grid->fits(p, cx, cz))
+				return false;
+			grid->cells[(size_t)cz * grid->width + cx] = p;
+			active.push_back((int)tile->points.size());
+			tile->points.push_back(p);
+			return true;
+		};
+
+		//Random throws (re)start the front. Once they stop landing the tile is full.
+		int throwsLeft = settings.attempts;
+		while (true)
+		{
+			if (active.empty()) {
+				if (throwsLeft-- <= 0)
+					break;
+				tryInsert(bMin + glm::vec2(random.nextFloat(), random.nextFloat()) * bSize);
+				continue;
+			}
+			size_t activeIndex = random.next() % active.size();
+			glm::vec2 center = tile->points[active[activeIndex]];
+			//Candidates evenly spaced on a circle just outside r, from a random start angle.
+			//Packs about as densely as random annulus samples with far fewer attempts.
+			float angle = random.nextFloat() * 6.28318531f;
+			glm::vec2 offset = glm::vec2(cosf(angle), sinf(angle)) * candidateRadius;
+			bool found = false;
+			for (int i = 0; i < settings.attempts; i++)
+			{
+				if (tryInsert(center + offset)) {
+					found = true;
+					break;
+				}
+				offset = glm::vec2(offset.x * stepCos - offset.y * stepSin, offset.x * stepSin + offset.y * stepCos);
+			}
+			if (!found) {
+				active[activeIndex] = active.back();
+				active.pop_back();
+			}
+		}
+	}
+
+	size_t scatterInstances(const ScatterSettings& settings, std::vector<glm::mat4>* modelMatrices,
+		const ScatterDensityFn& density, const ScatterHeightFn& height, ScatterStats* stats)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		modelMatrices->clear();
+		glm::vec2 size = settings.max - settings.min;
+		if (settings.minDistance <= 0.0f || size.x <= 0.0f || size.y <= 0.0f) {
+			printf("Failed to scatter: minDistance and area must be positive");
+			return 0;
+		}
+
+		ScatterGrid grid;
+		grid.origin = settings.min;
+		grid.cellSize = settings.minDistance / sqrtf(2.0f);
+		grid.minDistanceSq = settings.minDistance * settings.minDistance;
+		grid.width = (int)ceilf(size.x / grid.cellSize);
+		grid.height = (int)ceilf(size.y / grid.cellSize);
+		grid.cells.assign((size_t)grid.width * grid.height, glm::vec2(FLT_MAX));
+
+		int tilesX = (grid.width + SCATTER_TILE_CELLS - 1) / SCATTER_TILE_CELLS;
+		int tilesZ = (grid.height + SCATTER_TILE_CELLS - 1) / SCATTER_TILE_CELLS;
+		std::vector<ScatterTile> tiles(tilesX * tilesZ);
+		//Tiles with the same (x & 1, z & 1) are at least one tile apart and can be sampled at the same time
+		std::vector<ScatterTile*> phases[4];
+		for (int z = 0; z < tilesZ; z++)
+		{
+			for (int x = 0; x < tilesX; x++)
+			{
+				ScatterTile* tile = &tiles[z * tilesX + x];
+				tile->x = x;
+				tile->z = z;
+				tile->cellX0 = x * SCATTER_TILE_CELLS;
+				tile->cellZ0 = z * SCATTER_TILE_CELLS;
+				tile->cellX1 = tile->cellX0 + SCATTER_TILE_CELLS < grid.width ? tile->cellX0 + SCATTER_TILE_CELLS : grid.width;
+				tile->cellZ1 = tile->cellZ0 + SCATTER_TILE_CELLS < grid.height ? tile->cellZ0 + SCATTER_TILE_CELLS : grid.height;
+				phases[(x & 1) | ((z & 1) << 1)].push_back(tile);
+			}
+		}
+		for (int phase = 0; phase < 4; phase++)
+		{
+			std::vector<ScatterTile*>& phaseTiles = phases[phase];
+			parallelFor(phaseTiles.size(), 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+				{
+					sampleTile(phaseTiles[i], &grid, settings);
+				}
+			});
+		}
+
+		//Thin by density in place, then give every tile its slice of the output
+		parallelFor(tiles.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				ScatterTile& tile = tiles[i];
+				if (!density) {
+					tile.numKept = tile.points.size();
+					continue;
+				}
+				ScatterRandom random(hashTile(settings.seed, tile.x, tile.z, 1));
+				size_t kept = 0;
+				for (size_t j = 0; j < tile.points.size(); j++)
+				{
+					glm::vec2 p = tile.points[j];
+					if (random.nextFloat() < density(p.x, p.y))
+						tile.points[kept++] = p;
+				}
+				tile.numKept = kept;
+			}
+		});
+		size_t numSampled = 0;
+		size_t numPoints = 0;
+		for (size_t i = 0; i < tiles.size(); i++)
+		{
+			numSampled += tiles[i].points.size();
+			tiles[i].outputOffset = numPoints;
+			numPoints += tiles[i].numKept;
+		}
+		modelMatrices->resize(numPoints);
+		glm::mat4* output = modelMatrices->data();
+
+		parallelFor(tiles.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				const ScatterTile& tile = tiles[i];
+				ScatterRandom random(hashTile(settings.seed, tile.x, tile.z, 2));
+				glm::mat4* m = output + tile.outputOffset;
+				for (size_t j = 0; j < tile.numKept; j++, m++)
+				{
+					glm::vec2 p = tile.points[j];
+					float yaw = settings.randomYaw ? random.nextFloat() * 6.28318531f : 0.0f;
+					float scale = settings.minScale + (settings.maxScale - settings.minScale) * random.nextFloat();
+					float y = height ? height(p.x, p.y) : 0.0f;
+					//translate * rotate(yaw, +Y) * scale
+					float c = cosf(yaw) * scale;
+					float s = sinf(yaw) * scale;
+					(*m)[0] = glm::vec4(c, 0.0f, -s, 0.0f);
+					(*m)[1] = glm::vec4(0.0f, scale, 0.0f, 0.0f);
+					(*m)[2] = glm::vec4(s, 0.0f, c, 0.0f);
+					(*m)[3] = glm::vec4(p.x, y, p.y, 1.0f);
+				}
+			}
+		});
+
+		if (stats) {
+			stats->numSampled = numSampled;
+			stats->numPoints = numPoints;
+			stats->numTiles = (int)tiles.size();
+			stats->numThreads = getNumWorkerThreads();
+			stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+		return numPoints;
+	}
+}
@@ -0,0 +1,49 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+
+namespace ew {
+	struct ScatterSettings {
+		glm::vec2 min = glm::vec2(-50.0f); //XZ bounds of the scattered area. createPlane(w, h, ...) covers (-w/2, -h/2) to (w/2, h/2)
+		glm::vec2 max = glm::vec2(50.0f);
+		float minDistance = 1.0f; //No two points are closer than this
+		int attempts = 12; //Candidates tried around each point before it is retired
+		float minScale = 0.8f; //Uniform scale is picked in [minScale, maxScale]
+		float maxScale = 1.2f;
+		bool randomYaw = true; //Random rotation around +Y
+		unsigned int seed = 1;
+	};
+
+	struct ScatterStats {
+		size_t numSampled = 0; //Poisson-disk points before the density mask
+		size_t numPoints = 0; //Instances written
+		int numTiles = 0;
+		unsigned int numThreads = 0;
+		double seconds = 0.0;
+		inline double pointsPerSecond()const { return seconds > 0.0 ? numSampled / seconds : 0.0; }
+	};
+
+	//Returns a value in [0, 1]: the chance that a sampled point at (x, z) is kept
+	typedef std::function<float(float x, float z)> ScatterDensityFn;
+	//Returns the surface height at (x, z), e.g. Terrain::sampleHeight. Both callbacks run on worker threads.
+	typedef std::function<float(float x, float z)> ScatterHeightFn;
+
+	/// <summary>
+	/// Scatters instances over the XZ plane with a grid-accelerated Poisson-disk sampler.
+	/// The area is split into tiles that are sampled in parallel, four phases of non-adjacent tiles at a time,
+	/// so the output for a given seed is the same regardless of thread count.
+	/// </summary>
+	/// <param name="settings">Area, spacing, random scale/rotation and seed</param>
+	/// <param name="modelMatrices">Filled with one model matrix per instance, ready for InstanceBuffer::update. Will be cleared.</param>
+	/// <param name="density">Optional density mask. Points are thinned after sampling, so masked areas keep the spacing guarantee.</param>
+	/// <param name="height">Optional surface height. Defaults to y = 0.</param>
+	/// <param name="stats">Optional timing info</param>
+	/// <returns>Number of instances written</returns>
+	size_t scatterInstances(const ScatterSettings& settings, std::vector<glm::mat4>* modelMatrices,
+		const ScatterDensityFn& density = nullptr, const ScatterHeightFn& height = nullptr, ScatterStats* stats = nullptr);
+}
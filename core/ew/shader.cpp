@@ -3,51 +3,35 @@
 */
 
 #include "shader.h"
+#include "programCache.h"
+#include "glState.h"
 #include <fstream>
-#include <sstream>
+#include <chrono>
 #include "external/glad.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 
 namespace ew {
+	static UniformStats uniformStats;
+
 	/// <summary>
 	/// Loads shader source code from a file.
 	/// </summary>
 	/// <param name="filePath"></param>
 	/// <returns></returns>
 	std::string loadShaderSourceFromFile(const std::string& filePath) {
-		std::ifstream fstream(filePath);
+		std::ifstream fstream(filePath, std::ios::binary | std::ios::ate);
 		if (!fstream.is_open()) {
 			printf("Failed to load file %s", filePath.c_str());
 			return {};
 		}
-		std::stringstream buffer;
-		buffer << fstream.rdbuf();
-		return buffer.str();
-	}
-
-	/// <summary>
-	/// Creates and compiles a shader object of a given type
-	/// </summary>
-	/// <param name="shaderType">Expects GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, etc.</param>
-	/// <param name="sourceCode">GLSL source code for the shader stage</param>
-	/// <returns></returns>
-	static unsigned int createShader(GLenum shaderType, const char* sourceCode) {
-		//Create a new vertex shader object
-		unsigned int shader = glCreateShader(shaderType);
-		//Supply the shader object with source code
-		glShaderSource(shader, 1, &sourceCode, NULL);
-		//Compile the shader object
-		glCompileShader(shader);
-		int success;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			//512 is an arbitrary length, but should be plenty of characters for our error message.
-			char infoLog[512];
-			glGetShaderInfoLog(shader, 512, NULL, infoLog);
-			printf("Failed to compile shader: %s", infoLog);
-		}
-		return shader;
+		//Read straight into the string instead of copying through a stringstream
+		std::string source;
+		source.resize((size_t)fstream.tellg());
+		fstream.seekg(0);
+		fstream.read(&source[0], source.size());
+		return source;
 	}
 
 	/// <summary>
@@ -57,26 +41,63 @@ namespace ew {
 	/// <param name="fragmentShaderSource">GLSL source code for the fragment shader</param>
 	/// <returns></returns>
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
-		unsigned int vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
-		unsigned int fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+		unsigned int shaderProgram = beginShaderProgram(vertexShaderSource, fragmentShaderSource);
+		finishShaderProgram(shaderProgram);
+		return shaderProgram;
+	}
+	unsigned int beginShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
+		//Compile status is not checked here, since asking would wait for the compile to finish
+		unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+		glCompileShader(vertexShader);
+		unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+		glCompileShader(fragmentShader);
 
 		unsigned int shaderProgram = glCreateProgram();
 		//Attach each stage
 		glAttachShader(shaderProgram, vertexShader);
 		glAttachShader(shaderProgram, fragmentShader);
+		//Lets the program binary cache read the linked program back
+		glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		//Link all the stages together
 		glLinkProgram(shaderProgram);
+		return shaderProgram;
+	}
+	bool finishShaderProgram(unsigned int shaderProgram, std::string* errorLog) {
+		//Stages stay attached until now so their compile errors can be reported
+		unsigned int shaders[2];
+		GLsizei numShaders = 0;
+		glGetAttachedShaders(shaderProgram, 2, &numShaders, shaders);
+		for (GLsizei i = 0; i < numShaders; i++)
+		{
+			int success;
+			glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &success);
+			if (!success) {
+				//512 is an arbitrary length, but should be plenty of characters for our error message.
+				char infoLog[512];
+				glGetShaderInfoLog(shaders[i], 512, NULL, infoLog);
+				printf("Failed to compile shader: %s", infoLog);
+				if (errorLog)
+					*errorLog += infoLog;
+			}
+		}
 		int success;
 		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
 		if (!success) {
 			char infoLog[512];
 			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
 			printf("Failed to link shader program: %s", infoLog);
+			if (errorLog)
+				*errorLog += infoLog;
 		}
 		//The linked program now contains our compiled code, so we can delete these intermediate objects
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
-		return shaderProgram;
+		for (GLsizei i = 0; i < numShaders; i++)
+		{
+			glDetachShader(shaderProgram, shaders[i]);
+			glDeleteShader(shaders[i]);
+		}
+		return success != 0;
 	}
 	/// <summary>
 	/// Creates a shader instance with vertex + fragment stages
@@ -85,49 +106,213 @@ namespace ew {
 	/// <param name="fragmentShader">File path to fragment shader</param>
 	Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader)
 	{
-		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader.c_str());
-		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader.c_str());
-		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader);
+		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader);
+		//Reuse the driver's compiled binary when these exact sources were linked before
+		uint64_t key = ew::hashProgramSources(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		m_id = ew::loadProgramBinary(key, &m_loadStats.binaryRejected);
+		m_loadStats.fromCache = m_id != 0;
+		if (!m_loadStats.fromCache) {
+			m_id = ew::beginShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+			if (ew::finishShaderProgram(m_id)) {
+				ew::saveProgramBinary(key, m_id);
+			}
+		}
+		reflectUniforms();
+		m_loadStats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+	Shader::Shader(unsigned int program)
+		: m_id(program)
+	{
+		reflectUniforms();
+	}
+	/// <summary>
+	/// Copies one non-array uniform's current value between programs. Types not listed are left at their default.
+	/// </summary>
+	static void copyUniformValue(unsigned int from, int fromLocation, unsigned int to, int toLocation, unsigned int type) {
+		float f[16];
+		int n[4];
+		switch (type) {
+		case GL_FLOAT: glGetUniformfv(from, fromLocation, f); glProgramUniform1fv(to, toLocation, 1, f); break;
+		case GL_FLOAT_VEC2: glGetUniformfv(from, fromLocation, f); glProgramUniform2fv(to, toLocation, 1, f); break;
+		case GL_FLOAT_VEC3: glGetUniformfv(from, fromLocation, f); glProgramUniform3fv(to, toLocation, 1, f); break;
+		case GL_FLOAT_VEC4: glGetUniformfv(from, fromLocation, f); glProgramUniform4fv(to, toLocation, 1, f); break;
+		case GL_FLOAT_MAT3: glGetUniformfv(from, fromLocation, f); glProgramUniformMatrix3fv(to, toLocation, 1, GL_FALSE, f); break;
+		case GL_FLOAT_MAT4: glGetUniformfv(from, fromLocation, f); glProgramUniformMatrix4fv(to, toLocation, 1, GL_FALSE, f); break;
+		case GL_INT_VEC2: glGetUniformiv(from, fromLocation, n); glProgramUniform2iv(to, toLocation, 1, n); break;
+		case GL_INT_VEC3: glGetUniformiv(from, fromLocation, n); glProgramUniform3iv(to, toLocation, 1, n); break;
+		case GL_INT_VEC4: glGetUniformiv(from, fromLocation, n); glProgramUniform4iv(to, toLocation, 1, n); break;
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+			glGetUniformiv(from, fromLocation, n);
+			glProgramUniform1iv(to, toLocation, 1, n);
+			break;
+		default:
+			break;
+		}
+	}
+	void Shader::swapProgram(unsigned int program)
+	{
+		std::vector<UniformInfo> oldUniforms;
+		oldUniforms.swap(m_uniforms);
+		unsigned int oldProgram = m_id;
+		m_id = program;
+		reflectUniforms();
+		//Values set once (samplers, constants) carry over, so callers don't have to notice the swap
+		for (size_t i = 0; i < m_uniforms.size(); i++)
+		{
+			const UniformInfo& uniform = m_uniforms[i];
+			if (uniform.size != 1)
+				continue;
+			auto it = std::lower_bound(oldUniforms.begin(), oldUniforms.end(), uniform.name, [](const UniformInfo& info, const std::string& n) { return info.name < n; });
+			if (it != oldUniforms.end() && it->name == uniform.name && it->type == uniform.type && it->size == 1) {
+				copyUniformValue(oldProgram, it->location, m_id, uniform.location, uniform.type);
+			}
+		}
+		//If the old program is current, GL keeps it alive until something else is used
+		if (oldProgram != 0) {
+			glDeleteProgram(oldProgram);
+			forgetProgram(oldProgram);
+		}
 	}
 	void Shader::use()const
 	{
-		glUseProgram(m_id);
+		useProgram(m_id);
+	}
+	/// <summary>
+	/// Builds the uniform table for the linked program, so setters never have to ask GL for a location
+	/// </summary>
+	void Shader::reflectUniforms()
+	{
+		m_uniforms.clear();
+		int numUniforms = 0, maxNameLength = 0;
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &numUniforms);
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+		std::vector<char> nameBuffer(maxNameLength + 1);
+		for (int i = 0; i < numUniforms; i++)
+		{
+			UniformInfo info;
+			GLsizei nameLength = 0;
+			GLenum type;
+			glGetActiveUniform(m_id, i, (GLsizei)nameBuffer.size(), &nameLength, &info.size, &type, nameBuffer.data());
+			info.name.assign(nameBuffer.data(), nameLength);
+			info.type = type;
+			info.location = glGetUniformLocation(m_id, info.name.c_str());
+			uniformStats.locationQueries++;
+			//Uniform block members have no location
+			if (info.location < 0) {
+				continue;
+			}
+			m_uniforms.push_back(info);
+			//Arrays are reported as "name[0]". Also list them by the bare name, which GL accepts too.
+			size_t bracket = info.name.size() >= 3 ? info.name.size() - 3 : std::string::npos;
+			if (bracket != std::string::npos && info.name.compare(bracket, 3, "[0]") == 0) {
+				info.name.resize(bracket);
+				m_uniforms.push_back(info);
+			}
+		}
+		std::sort(m_uniforms.begin(), m_uniforms.end(), [](const UniformInfo& a, const UniformInfo& b) { return a.name < b.name; });
+	}
+	UniformHandle Shader::getUniformHandle(const std::string& name) const
+	{
+		UniformHandle handle;
+		auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), name, [](const UniformInfo& info, const std::string& n) { return info.name < n; });
+		if (it != m_uniforms.end() && it->name == name) {
+			handle.index = (int)(it - m_uniforms.begin());
+		}
+		return handle;
 	}
 	void Shader::setInt(const std::string& name, int v) const
 	{
-		glUniform1i(glGetUniformLocation(m_id, name.c_str()), v);
+		setInt(getUniformHandle(name), v);
 	}
 	void Shader::setFloat(const std::string& name, float v) const
 	{
-		glUniform1f(glGetUniformLocation(m_id, name.c_str()), v);
+		setFloat(getUniformHandle(name), v);
 	}
 	void Shader::setVec2(const std::string& name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_id, name.c_str()), x, y);
+		setVec2(getUniformHandle(name), glm::vec2(x, y));
 	}
 	void Shader::setVec2(const std::string& name, const glm::vec2& v) const
 	{
-		setVec2(name, v.x, v.y);
+		setVec2(getUniformHandle(name), v);
 	}
 	void Shader::setVec3(const std::string& name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(m_id, name.c_str()), x, y, z);
+		setVec3(getUniformHandle(name), glm::vec3(x, y, z));
 	}
 	void Shader::setVec3(const std::string& name, const glm::vec3& v) const
 	{
-		setVec3(name, v.x, v.y, v.z);
+		setVec3(getUniformHandle(name), v);
 	}
 	void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(m_id, name.c_str()), x, y, z, w);
+		setVec4(getUniformHandle(name), glm::vec4(x, y, z, w));
 	}
 	void Shader::setVec4(const std::string& name, const glm::vec4& v) const
 	{
-		setVec4(name, v.x, v.y, v.z, v.w);
+		setVec4(getUniformHandle(name), v);
 	}
 	void Shader::setMat4(const std::string& name, const glm::mat4& m) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
+		setMat4(getUniformHandle(name), m);
+	}
+	void Shader::setInt(UniformHandle handle, int v) const
+	{
+		if (!handle.isValid())
+			return;
+		glUniform1i(m_uniforms[handle.index].location, v);
+		uniformStats.uniformCalls++;
+	}
+	void Shader::setFloat(UniformHandle handle, float v) const
+	{
+		if (!handle.isValid())
+			return;
+		glUniform1f(m_uniforms[handle.index].location, v);
+		uniformStats.uniformCalls++;
+	}
+	void Shader::setVec2(UniformHandle handle, const glm::vec2& v) const
+	{
+		if (!handle.isValid())
+			return;
+		glUniform2f(m_uniforms[handle.index].location, v.x, v.y);
+		uniformStats.uniformCalls++;
+	}
+	void Shader::setVec3(UniformHandle handle, const glm::vec3& v) const
+	{
+		if (!handle.isValid())
+			return;
+		glUniform3f(m_uniforms[handle.index].location, v.x, v.y, v.z);
+		uniformStats.uniformCalls++;
+	}
+	void Shader::setVec4(UniformHandle handle, const glm::vec4& v) const
+	{
+		if (!handle.isValid())
+			return;
+		glUniform4f(m_uniforms[handle.index].location, v.x, v.y, v.z, v.w);
+		uniformStats.uniformCalls++;
+	}
+	void Shader::setMat4(UniformHandle handle, const glm::mat4& m) const
+	{
+		if (!handle.isValid())
+			return;
+		glUniformMatrix4fv(m_uniforms[handle.index].location, 1, GL_FALSE, glm::value_ptr(m));
+		uniformStats.uniformCalls++;
+	}
+	const UniformStats& getUniformStats()
+	{
+		return uniformStats;
+	}
+	void resetUniformStats()
+	{
+		uniformStats = UniformStats();
 	}
 }
-
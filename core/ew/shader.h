@@ -3,16 +3,56 @@
 */
 
 #pragma once
+#include "programCache.h"
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 namespace ew {
 	std::string loadShaderSourceFromFile(const std::string& filePath);
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	//Compiles and links without waiting for the driver, so several programs can build at once. Finish with finishShaderProgram.
+	unsigned int beginShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	//Waits for a program from beginShaderProgram, prints any compile/link errors and frees its shader objects. False if it failed.
+	/// <param name="errorLog">Optional. Compile and link errors are appended to it.</param>
+	bool finishShaderProgram(unsigned int program, std::string* errorLog = nullptr);
+
+	//Active uniform found at link time. Uniform block members are not listed, they are set through their buffer.
+	struct UniformInfo {
+		std::string name; //Arrays are listed by both "name" and "name[0]"
+		int location;
+		unsigned int type; //e.g. GL_FLOAT_VEC3
+		int size; //Array length, 1 for non-arrays
+	};
+
+	/// <summary>
+	/// Pre-resolved uniform, from Shader::getUniformHandle. Only valid for the shader that made it.
+	/// Handles of uniforms that are not active (e.g. optimized out) are invalid, and setting them does nothing.
+	/// </summary>
+	struct UniformHandle {
+		int index = -1; //Into Shader::getUniforms()
+		inline bool isValid()const { return index >= 0; }
+	};
+
+	struct UniformStats {
+		int uniformCalls = 0; //glUniform* calls made by Shader setters
+		int locationQueries = 0; //glGetUniformLocation calls. Only made while reflecting a newly linked program.
+	};
+	const UniformStats& getUniformStats();
+	//Call once per frame to get per-frame counts
+	void resetUniformStats();
+
 	class Shader {
 	public:
+		//Links from the program binary cache when possible, otherwise compiles and fills the cache
 		Shader(const std::string& vertexShader, const std::string& fragmentShader);
+		Shader() {};
+		//Wraps a program that is already linked, e.g. a ShaderVariants variant
+		explicit Shader(unsigned int program);
 		void use()const;
+		//Looks the name up in the uniform table. Do this once up front for uniforms set every draw.
+		UniformHandle getUniformHandle(const std::string& name)const;
+		//Setters by name look the handle up each call (no GL query)
 		void setInt(const std::string& name, int v) const;
 		void setFloat(const std::string& name, float v) const;
 		void setVec2(const std::string& name, float x, float y) const;
@@ -22,7 +62,25 @@ namespace ew {
 		void setVec4(const std::string& name, float x, float y, float z, float w) const;
 		void setVec4(const std::string& name, const glm::vec4& v) const;
 		void setMat4(const std::string& name, const glm::mat4& m) const;
+		void setInt(UniformHandle handle, int v) const;
+		void setFloat(UniformHandle handle, float v) const;
+		void setVec2(UniformHandle handle, const glm::vec2& v) const;
+		void setVec3(UniformHandle handle, const glm::vec3& v) const;
+		void setVec4(UniformHandle handle, const glm::vec4& v) const;
+		void setMat4(UniformHandle handle, const glm::mat4& m) const;
+		//Replaces the program in place (e.g. after a hot reload), so pointers and references to this shader stay valid.
+		//Uniform values with the same name and type are copied over, then the old program is deleted.
+		//Copies of this Shader made before the swap still hold the deleted program.
+		void swapProgram(unsigned int program);
+		inline unsigned int getId()const { return m_id; }
+		//How the constructor got its program, and how long it took
+		inline const ProgramLoadStats& getLoadStats()const { return m_loadStats; }
+		//Sorted by name
+		inline const std::vector<UniformInfo>& getUniforms()const { return m_uniforms; }
 	private:
-		unsigned int m_id; //Shader program handle
+		void reflectUniforms();
+		unsigned int m_id = 0; //Shader program handle
+		std::vector<UniformInfo> m_uniforms; //Sorted by name
+		ProgramLoadStats m_loadStats;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,196 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "shaderReloader.h"
+#include "programCache.h"
+#include <algorithm>
+#include <chrono>
+
+namespace ew {
+	//Prefix of every path the build copied from a source assets folder
+	static const std::string BUILD_ASSETS_DIR = "assets/";
+
+	ShaderReloader::ShaderReloader()
+	{
+#ifdef EW_CORE_ASSETS_SOURCE_DIR
+		addSourceDirectory(EW_CORE_ASSETS_SOURCE_DIR);
+#endif
+	}
+
+	void ShaderReloader::addSourceDirectory(const std::string& directory)
+	{
+		std::string path = directory;
+		if (!path.empty() && path.back() != '/' && path.back() != '\\')
+			path += '/';
+		m_sourceDirectories.push_back(path);
+	}
+
+	std::string ShaderReloader::findSource(const std::string& filePath)const
+	{
+		if (filePath.compare(0, BUILD_ASSETS_DIR.size(), BUILD_ASSETS_DIR) != 0)
+			return filePath;
+		std::string relativePath = filePath.substr(BUILD_ASSETS_DIR.size());
+		for (size_t i = 0; i < m_sourceDirectories.size(); i++)
+		{
+			std::string sourcePath = m_sourceDirectories[i] + relativePath;
+			if (getFileModifiedTime(sourcePath) != 0.0)
+				return sourcePath;
+		}
+		return filePath;
+	}
+
+	void ShaderReloader::watch(Shader* shader, const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines)
+	{
+		Entry* entry = nullptr;
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			if (m_entries[i].shader == shader)
+				entry = &m_entries[i];
+		}
+		if (!entry) {
+			m_entries.push_back(Entry());
+			entry = &m_entries.back();
+			entry->shader = shader;
+		}
+		//Includes resolve next to the including file, so they follow the sources too
+		entry->vertexShader = findSource(vertexShader);
+		entry->fragmentShader = findSource(fragmentShader);
+		entry->defines = defines;
+		//Only the file list is needed here, the program is already built
+		std::string source;
+		std::vector<std::string> vertexFiles, fragmentFiles;
+		preprocessShader(entry->vertexShader, defines, &source, &vertexFiles);
+		preprocessShader(entry->fragmentShader, defines, &source, &fragmentFiles);
+		vertexFiles.insert(vertexFiles.end(), fragmentFiles.begin(), fragmentFiles.end());
+		watchFiles(entry, vertexFiles);
+	}
+
+	void ShaderReloader::watch(ShaderVariants* variants)
+	{
+		variants->setReloader(this);
+	}
+
+	void ShaderReloader::unwatch(Shader* shader)
+	{
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			if (m_entries[i].shader != shader)
+				continue;
+			if (m_entries[i].program != 0)
+				glDeleteProgram(m_entries[i].program);
+			m_entries.erase(m_entries.begin() + i);
+			return;
+		}
+	}
+
+	void ShaderReloader::watchFiles(Entry* entry, const std::vector<std::string>& files)
+	{
+		entry->files.clear();
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (std::find(entry->files.begin(), entry->files.end(), files[i]) != entry->files.end())
+				continue;
+			entry->files.push_back(files[i]);
+			m_watcher.watch(files[i]);
+		}
+	}
+
+	void ShaderReloader::start(Entry* entry)
+	{
+		entry->changed = false;
+		std::string vertexSource, fragmentSource;
+		std::vector<std::string> vertexFiles, fragmentFiles;
+		bool ok = preprocessShader(entry->vertexShader, entry->defines, &vertexSource, &vertexFiles);
+		ok = preprocessShader(entry->fragmentShader, entry->defines, &fragmentSource, &fragmentFiles) && ok;
+		//An edit can add or remove includes
+		vertexFiles.insert(vertexFiles.end(), fragmentFiles.begin(), fragmentFiles.end());
+		watchFiles(entry, vertexFiles);
+		if (!ok) {
+			//Often a save caught halfway. The next change tries again.
+			m_stats.failures++;
+			m_stats.lastError = "Failed to read sources or includes";
+			m_stats.lastErrorFile = entry->fragmentShader;
+			return;
+		}
+		entry->cacheKey = hashProgramSources(vertexSource.c_str(), fragmentSource.c_str());
+		entry->program = beginShaderProgram(vertexSource.c_str(), fragmentSource.c_str());
+		entry->startedThisUpdate = true;
+		entry->buildSaveTime = entry->saveTime;
+	}
+
+	void ShaderReloader::finish(Entry* entry)
+	{
+		unsigned int program = entry->program;
+		entry->program = 0;
+		std::string errorLog;
+		if (!finishShaderProgram(program, &errorLog)) {
+			glDeleteProgram(program);
+			m_stats.failures++;
+			m_stats.lastError = errorLog;
+			m_stats.lastErrorFile = entry->vertexShader + " + " + entry->fragmentShader;
+			return;
+		}
+		//Next launch links these sources from the cache instead of compiling them again
+		saveProgramBinary(entry->cacheKey, program);
+		entry->shader->swapProgram(program);
+		m_stats.reloads++;
+		m_stats.lastError.clear();
+		m_stats.lastErrorFile.clear();
+		m_stats.lastLatencyMs = std::max(getWallClockTime() - entry->buildSaveTime, 0.0) * 1000.0;
+		m_stats.maxLatencyMs = std::max(m_stats.maxLatencyMs, m_stats.lastLatencyMs);
+	}
+
+	void ShaderReloader::update()
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::vector<std::string> changedFiles;
+		m_watcher.poll(&changedFiles);
+		for (size_t i = 0; i < changedFiles.size(); i++)
+		{
+			//Save time comes from the file itself, so polling and event delays count towards the latency
+			double saveTime = getFileModifiedTime(changedFiles[i]);
+			if (saveTime == 0.0)
+				saveTime = getWallClockTime();
+			for (size_t j = 0; j < m_entries.size(); j++)
+			{
+				Entry& entry = m_entries[j];
+				if (std::find(entry.files.begin(), entry.files.end(), changedFiles[i]) == entry.files.end())
+					continue;
+				entry.changed = true;
+				entry.saveTime = std::max(entry.saveTime, saveTime);
+			}
+		}
+
+		m_stats.compiling = 0;
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			Entry& entry = m_entries[i];
+			entry.startedThisUpdate = false;
+			//A program still building from older sources finishes first. The change is picked up once it is done.
+			if (entry.changed && entry.program == 0) {
+				start(&entry);
+			}
+			if (entry.program == 0) {
+				continue;
+			}
+			bool ready;
+			if (isParallelShaderCompileSupported()) {
+				GLint complete = GL_FALSE;
+				glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &complete);
+				ready = complete != GL_FALSE;
+			}
+			else {
+				//No way to ask without blocking, so give the driver until the next frame
+				ready = !entry.startedThisUpdate;
+			}
+			if (ready) {
+				finish(&entry);
+			}
+			else {
+				m_stats.compiling++;
+			}
+		}
+		m_stats.lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+}
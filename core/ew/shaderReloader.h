@@ -0,0 +1,76 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "fileWatcher.h"
+#include "shader.h"
+#include "shaderVariants.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ew {
+	struct ShaderReloadStats {
+		int reloads = 0; //Programs swapped in
+		int failures = 0; //Edits that didn't compile or link. The old program kept running.
+		int compiling = 0; //Programs building right now
+		double lastLatencyMs = 0.0; //File save to swap, for the latest reload
+		double maxLatencyMs = 0.0;
+		double lastUpdateMs = 0.0; //CPU time of the latest update()
+		std::string lastError; //Compile/link log of the latest failure. Cleared by the next successful reload.
+		std::string lastErrorFile; //Top level file of the program that failed
+	};
+
+	/// <summary>
+	/// Hot reload: watches shader sources and everything they #include, rebuilds programs whose files changed and swaps
+	/// each one into its existing Shader only once it links. Until then, and for good if it fails, the old program keeps drawing.
+	/// With GL_KHR_parallel_shader_compile the driver builds in the background and update() only picks up finished programs.
+	/// Without it, a program is started in one update() and finished in the next, so at worst one frame waits on the driver.
+	/// Sources are re-read through preprocessShader, so watched shaders get the same #include handling as variants.
+	/// Paths under assets/ are copies made by the build, so they are mapped back to the source tree (see addSourceDirectory) and watched there.
+	/// </summary>
+	class ShaderReloader {
+	public:
+		//Adds core's source assets folder when the build defines EW_CORE_ASSETS_SOURCE_DIR
+		ShaderReloader();
+		//A source folder the build copies to assets/, e.g. an assignment's ASSETS_SOURCE_DIR. Searched in the order added.
+		//Only affects shaders watched after the call. Files missing from every folder are watched where they are.
+		void addSourceDirectory(const std::string& directory);
+		//Reloads shader from these files. shader must stay at the same address while watched.
+		void watch(Shader* shader, const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines = {});
+		//Watches every variant of variants, including ones built later
+		void watch(ShaderVariants* variants);
+		//Stops reloading shader, e.g. before it is destroyed. A program still building for it is deleted.
+		void unwatch(Shader* shader);
+		//Call once per frame, on the GL thread
+		void update();
+		inline const ShaderReloadStats& getStats()const { return m_stats; }
+		inline size_t getNumWatchedShaders()const { return m_entries.size(); }
+		inline size_t getNumWatchedFiles()const { return m_watcher.getNumWatched(); }
+		inline bool isUsingFileEvents()const { return m_watcher.isUsingEvents(); }
+	private:
+		struct Entry {
+			Shader* shader = nullptr;
+			std::string vertexShader;
+			std::string fragmentShader;
+			std::vector<std::string> defines;
+			std::vector<std::string> files; //Both stages and all their includes
+			unsigned int program = 0; //Building, 0 when idle
+			uint64_t cacheKey = 0;
+			bool changed = false; //A file changed since the last build started
+			bool startedThisUpdate = false;
+			double saveTime = 0.0; //Wall clock seconds of the newest change, see getFileModifiedTime
+			double buildSaveTime = 0.0; //saveTime when the program being built was started
+		};
+		void start(Entry* entry);
+		void finish(Entry* entry);
+		void watchFiles(Entry* entry, const std::vector<std::string>& files);
+		std::string findSource(const std::string& filePath)const;
+
+		std::vector<std::string> m_sourceDirectories; //Each ends in a slash
+		FileWatcher m_watcher;
+		std::vector<Entry> m_entries;
+		ShaderReloadStats m_stats;
+	};
+}
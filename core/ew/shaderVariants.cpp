@@ -0,0 +1,262 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "shaderVariants.h"
+#include "programCache.h"
+#include "glState.h"
+#include "shaderReloader.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	typedef void (GLAD_API_PTR* PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+	static bool parallelShaderCompile = false;
+
+	bool initParallelShaderCompile(GLADloadfunc load)
+	{
+		const char* entryPoint = nullptr;
+		if (isGLExtensionSupported("GL_KHR_parallel_shader_compile"))
+			entryPoint = "glMaxShaderCompilerThreadsKHR";
+		else if (isGLExtensionSupported("GL_ARB_parallel_shader_compile"))
+			entryPoint = "glMaxShaderCompilerThreadsARB";
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = entryPoint ? (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load(entryPoint) : nullptr;
+		parallelShaderCompile = maxShaderCompilerThreads != nullptr;
+		if (parallelShaderCompile) {
+			//Implementation chosen thread count
+			maxShaderCompilerThreads(0xFFFFFFFF);
+		}
+		return parallelShaderCompile;
+	}
+
+	bool isParallelShaderCompileSupported()
+	{
+		return parallelShaderCompile;
+	}
+
+	static std::string directoryOf(const std::string& filePath) {
+		size_t slash = filePath.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : filePath.substr(0, slash + 1);
+	}
+
+	static bool startsWithDirective(const std::string& line, const char* directive, size_t* after) {
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, strlen(directive), directive) != 0)
+			return false;
+		*after = start + strlen(directive);
+		return true;
+	}
+
+	static bool appendFile(const std::string& filePath, const std::vector<std::string>& defines, std::string* output, std::vector<std::string>* files) {
+		std::string source = loadShaderSourceFromFile(filePath);
+		if (source.empty())
+			return false;
+		int fileIndex = (int)files->size();
+		files->push_back(filePath);
+		bool ok = true;
+		int lineNumber = 0;
+		size_t lineStart = 0;
+		while (lineStart < source.size()) {
+			size_t lineEnd = source.find('\n', lineStart);
+			if (lineEnd == std::string::npos)
+				lineEnd = source.size();
+			std::string line = source.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd + 1;
+			lineNumber++;
+
+			size_t after;
+			if (startsWithDirective(line, "#version", &after)) {
+				//Only the top level file keeps its #version, and the defines have to come straight after it
+				if (fileIndex == 0) {
+					*output += line + "\n";
+					for (size_t i = 0; i < defines.size(); i++)
+					{
+						*output += "#define " + defines[i] + "\n";
+					}
+					*output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+				}
+				continue;
+			}
+			if (startsWithDirective(line, "#include", &after)) {
+				size_t open = line.find('"', after);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if (close == std::string::npos) {
+					printf("Failed to parse %s line %d: %s", filePath.c_str(), lineNumber, line.c_str());
+					ok = false;
+					continue;
+				}
+				std::string includePath = directoryOf(filePath) + line.substr(open + 1, close - open - 1);
+				//Include once, which also stops include cycles
+				if (std::find(files->begin(), files->end(), includePath) == files->end()) {
+					*output += "#line 1 " + std::to_string(files->size()) + "\n";
+					if (!appendFile(includePath, defines, output, files)) {
+						printf("Failed to include %s from %s", includePath.c_str(), filePath.c_str());
+						ok = false;
+					}
+				}
+				*output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+				continue;
+			}
+			*output += line + "\n";
+		}
+		return ok;
+	}
+
+	bool preprocessShader(const std::string& filePath, const std::vector<std::string>& defines, std::string* output, std::vector<std::string>* includedFiles)
+	{
+		std::vector<std::string> files;
+		output->clear();
+		bool ok = appendFile(filePath, defines, output, &files);
+		if (includedFiles)
+			*includedFiles = files;
+		return ok;
+	}
+
+	ShaderVariants::ShaderVariants(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& features)
+		: m_vertexShader(vertexShader), m_fragmentShader(fragmentShader), m_features(features)
+	{
+	}
+
+	ShaderVariants::ShaderVariants(ShaderVariants&& other)
+		: m_vertexShader(std::move(other.m_vertexShader)), m_fragmentShader(std::move(other.m_fragmentShader)), m_features(std::move(other.m_features)),
+		m_variants(std::move(other.m_variants)), m_stats(other.m_stats), m_reloader(other.m_reloader)
+	{
+		//The variants belong to this object now, so the old one must not delete them
+		other.m_variants.clear();
+		other.m_reloader = nullptr;
+	}
+
+	ShaderVariants::~ShaderVariants()
+	{
+		bool deleted = false;
+		for (auto it = m_variants.begin(); it != m_variants.end(); ++it)
+		{
+			Variant& variant = it->second;
+			if (m_reloader)
+				m_reloader->unwatch(&variant.shader);
+			//Hot reload swaps newer programs into the shader, so once built it holds the current one
+			unsigned int program = variant.pending ? variant.program : variant.shader.getId();
+			if (program != 0) {
+				glDeleteProgram(program);
+				deleted = true;
+			}
+		}
+		//A deleted program's name can be reused, so the cache must not think it is still bound
+		if (deleted)
+			invalidateGLState();
+	}
+
+	ShaderVariants::Variant& ShaderVariants::start(uint32_t features)
+	{
+		auto it = m_variants.find(features);
+		if (it != m_variants.end())
+			return it->second;
+		Variant& variant = m_variants[features];
+		variant.features = features;
+
+		std::vector<std::string> defines = getDefines(features);
+		std::string vertexSource, fragmentSource;
+		if (!preprocessShader(m_vertexShader, defines, &vertexSource) || !preprocessShader(m_fragmentShader, defines, &fragmentSource)) {
+			m_stats.failed++;
+			return variant;
+		}
+		//Defines are part of the preprocessed source, so each variant gets its own cache entry
+		variant.cacheKey = hashProgramSources(vertexSource.c_str(), fragmentSource.c_str());
+		variant.program = loadProgramBinary(variant.cacheKey);
+		if (variant.program != 0) {
+			m_stats.fromCache++;
+			variant.shader = Shader(variant.program);
+			watch(&variant);
+			return variant;
+		}
+		variant.program = beginShaderProgram(vertexSource.c_str(), fragmentSource.c_str());
+		variant.pending = true;
+		return variant;
+	}
+
+	void ShaderVariants::finish(Variant* variant)
+	{
+		variant->pending = false;
+		if (!finishShaderProgram(variant->program)) {
+			m_stats.failed++;
+			glDeleteProgram(variant->program);
+			variant->program = 0;
+			return;
+		}
+		m_stats.compiled++;
+		saveProgramBinary(variant->cacheKey, variant->program);
+		variant->shader = Shader(variant->program);
+		watch(variant);
+	}
+
+	void ShaderVariants::watch(Variant* variant)
+	{
+		if (m_reloader)
+			m_reloader->watch(&variant->shader, m_vertexShader, m_fragmentShader, getDefines(variant->features));
+	}
+
+	void ShaderVariants::setReloader(ShaderReloader* reloader)
+	{
+		m_reloader = reloader;
+		for (auto it = m_variants.begin(); it != m_variants.end(); ++it)
+		{
+			if (!it->second.pending && it->second.program != 0)
+				watch(&it->second);
+		}
+	}
+
+	std::vector<std::string> ShaderVariants::getDefines(uint32_t features) const
+	{
+		std::vector<std::string> defines;
+		for (size_t i = 0; i < m_features.size(); i++)
+		{
+			if (features & (1u << i))
+				defines.push_back(m_features[i]);
+		}
+		return defines;
+	}
+
+	void ShaderVariants::request(uint32_t features)
+	{
+		start(features);
+	}
+
+	bool ShaderVariants::isReady(uint32_t features)
+	{
+		auto it = m_variants.find(features);
+		if (it == m_variants.end())
+			return false;
+		Variant& variant = it->second;
+		if (!variant.pending)
+			return true;
+		//Without the extension there is no way to ask without blocking
+		if (!parallelShaderCompile)
+			return false;
+		GLint complete = GL_FALSE;
+		glGetProgramiv(variant.program, GL_COMPLETION_STATUS_KHR, &complete);
+		if (complete) {
+			finish(&variant);
+		}
+		return complete != GL_FALSE;
+	}
+
+	const Shader& ShaderVariants::get(uint32_t features)
+	{
+		auto it = m_variants.find(features);
+		if (it != m_variants.end() && !it->second.pending) {
+			if (it->second.program != 0)
+				m_stats.hits++;
+			return it->second.shader;
+		}
+		m_stats.misses++;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		Variant& variant = start(features);
+		if (variant.pending) {
+			finish(&variant);
+		}
+		m_stats.blockedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return variant.shader;
+	}
+}
@@ -0,0 +1,93 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "shader.h"
+#include "external/glad.h"
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//GL_KHR_parallel_shader_compile. glad is generated without extensions, so the enums are declared here.
+//The ARB extension uses the same values.
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace ew {
+	class ShaderReloader;
+
+	/// <summary>
+	/// Reads a GLSL file, pasting in every #include "file" (relative to the including file, each file once)
+	/// and adding #define NAME after #version for each define. #line directives keep error line numbers pointing
+	/// at the original files: the source string number is the file's index in includedFiles.
+	/// </summary>
+	/// <param name="includedFiles">Optional. Every file read, the top level file first.</param>
+	/// <returns>False if any file could not be read</returns>
+	bool preprocessShader(const std::string& filePath, const std::vector<std::string>& defines, std::string* output, std::vector<std::string>* includedFiles = nullptr);
+
+	//Lets the driver compile on its own threads through GL_KHR_parallel_shader_compile (or the ARB version), if supported.
+	//Call once after gladLoadGL, with the same loader. Returns false when neither extension is available.
+	bool initParallelShaderCompile(GLADloadfunc load);
+	bool isParallelShaderCompileSupported();
+
+	struct ShaderVariantStats {
+		int hits = 0; //get() calls whose variant was ready. Variants that failed to build count as neither.
+		int misses = 0; //get() calls that had to compile, or wait for, their variant
+		int compiled = 0; //Variants built from source
+		int fromCache = 0; //Variants linked from the program binary cache
+		int failed = 0;
+		double blockedMs = 0.0; //Time spent waiting inside get()
+	};
+
+	/// <summary>
+	/// Every specialization of one vertex + fragment shader pair. Bit i of a feature mask adds #define features[i]
+	/// to both stages. Variants are built on first use and kept; request() starts several at once ahead of time.
+	/// </summary>
+	class ShaderVariants {
+	public:
+		ShaderVariants(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& features);
+		//Deletes every program it built, including ones still building and ones hot reload swapped in
+		~ShaderVariants();
+		//Moving keeps every variant at the same address, so shaders handed out stay valid
+		ShaderVariants(ShaderVariants&& other);
+		ShaderVariants(const ShaderVariants&) = delete;
+		ShaderVariants& operator=(const ShaderVariants&) = delete;
+		//Starts building a variant without waiting for it
+		void request(uint32_t features);
+		//True once get() would return without stalling. False for variants that were never requested.
+		bool isReady(uint32_t features);
+		//The variant for a feature mask, built first if needed. Returns a shader with program 0 if it failed to build.
+		const Shader& get(uint32_t features);
+		inline const ShaderVariantStats& getStats()const { return m_stats; }
+		inline size_t getNumVariants()const { return m_variants.size(); }
+		inline const std::vector<std::string>& getFeatures()const { return m_features; }
+		//Hands every variant, built now or later, to reloader for hot reload. The reloader must outlive this object.
+		void setReloader(ShaderReloader* reloader);
+		//#defines for a feature mask
+		std::vector<std::string> getDefines(uint32_t features)const;
+	private:
+		struct Variant {
+			Shader shader;
+			unsigned int program = 0;
+			bool pending = false; //Linking, not yet finished
+			uint64_t cacheKey = 0;
+			uint32_t features = 0;
+		};
+		Variant& start(uint32_t features);
+		void finish(Variant* variant);
+		void watch(Variant* variant);
+
+		std::string m_vertexShader;
+		std::string m_fragmentShader;
+		std::vector<std::string> m_features;
+		std::unordered_map<uint32_t, Variant> m_variants; //Feature mask -> variant. Node based, so references stay valid.
+		ShaderVariantStats m_stats;
+		ShaderReloader* m_reloader = nullptr;
+	};
+}
@@ -0,0 +1,120 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "shadowCache.h"
+#include "glState.h"
+#include "external/glad.h"
+
+namespace ew {
+	namespace {
+		const uint64_t FNV_OFFSET = 14695981039346656037ull;
+		const uint64_t FNV_PRIME = 1099511628211ull;
+
+		uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= FNV_PRIME;
+			}
+			return hash;
+		}
+	}
+
+	ShadowCache::~ShadowCache()
+	{
+		if (m_depthTexture != 0) {
+			glDeleteTextures(1, &m_depthTexture);
+			forgetTexture(m_depthTexture);
+			glDeleteFramebuffers(1, &m_fbo);
+		}
+	}
+
+	void ShadowCache::setSize(int width, int height, int layers)
+	{
+		if (width == m_width && height == m_height && layers == (int)m_layers.size()) {
+			return;
+		}
+		if (m_depthTexture != 0) {
+			glDeleteTextures(1, &m_depthTexture);
+			forgetTexture(m_depthTexture);
+			glDeleteFramebuffers(1, &m_fbo);
+		}
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_depthTexture);
+		glTextureStorage3D(m_depthTexture, 1, GL_DEPTH_COMPONENT32F, width, height, layers);
+		glCreateFramebuffers(1, &m_fbo);
+		glNamedFramebufferDrawBuffer(m_fbo, GL_NONE);
+		glNamedFramebufferReadBuffer(m_fbo, GL_NONE);
+		m_width = width;
+		m_height = height;
+		m_layers.assign(layers, Layer());
+		m_stats.bytes = (size_t)width * height * layers * sizeof(float);
+	}
+
+	void ShadowCache::beginFrame()
+	{
+		m_stats.refreshes = 0;
+		m_stats.hits = 0;
+		m_stats.drawsSaved = 0;
+		m_frameHash = FNV_OFFSET;
+		m_hashChecked = false;
+	}
+
+	void ShadowCache::addStaticCaster(const glm::mat4& transform, const void* geometry)
+	{
+		m_frameHash = hashBytes(m_frameHash, &transform, sizeof(glm::mat4));
+		m_frameHash = hashBytes(m_frameHash, &geometry, sizeof(geometry));
+	}
+
+	void ShadowCache::checkStaticCasters()
+	{
+		m_hashChecked = true;
+		if (m_frameHash != m_staticHash) {
+			m_staticHash = m_frameHash;
+			invalidate();
+			m_stats.invalidations++;
+		}
+	}
+
+	bool ShadowCache::needsRefresh(int layer, const glm::mat4& lightMatrix, int staticDraws)
+	{
+		if (!m_hashChecked) {
+			checkStaticCasters();
+		}
+		Layer& cached = m_layers[layer];
+		if (cached.valid && cached.lightMatrix == lightMatrix) {
+			m_stats.hits++;
+			m_stats.drawsSaved += staticDraws;
+			return false;
+		}
+		cached.valid = true;
+		cached.lightMatrix = lightMatrix;
+		m_stats.refreshes++;
+		m_stats.totalRefreshes++;
+		return true;
+	}
+
+	void ShadowCache::beginStatic(int layer)
+	{
+		glNamedFramebufferTextureLayer(m_fbo, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, layer);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		glViewport(0, 0, m_width, m_height);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	void ShadowCache::restore(int layer, unsigned int targetTexture, unsigned int targetType)
+	{
+		int targetLayer = targetType == GL_TEXTURE_2D_ARRAY ? layer : 0;
+		glCopyImageSubData(m_depthTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer,
+			targetTexture, targetType, 0, 0, 0, targetLayer, m_width, m_height, 1);
+	}
+
+	void ShadowCache::invalidate()
+	{
+		for (size_t i = 0; i < m_layers.size(); i++)
+		{
+			m_layers[i].valid = false;
+		}
+	}
+}
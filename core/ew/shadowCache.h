@@ -0,0 +1,68 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace ew {
+	struct ShadowCacheStats {
+		int refreshes = 0; //Layers whose static casters were redrawn this frame
+		int hits = 0; //Layers restored from the cache this frame
+		int drawsSaved = 0; //Static caster draws skipped this frame
+		int totalRefreshes = 0;
+		int invalidations = 0; //Frames where the static casters changed, so every layer was redrawn
+		size_t bytes = 0;
+	};
+
+	/// <summary>
+	/// Depth of the static shadow casters, kept across frames. Each frame, for every layer of the shadow map:
+	/// needsRefresh() says whether the static casters must be drawn again (between beginStatic() and restore()),
+	/// then restore() copies the cached depth into the shadow map and the dynamic casters are drawn on top without clearing.
+	/// A layer is redrawn when its light matrix changes, and every layer is when the static casters added this frame
+	/// differ from last frame's (a transform or mesh changed, or one was added or removed).
+	/// Depth is GL_DEPTH_COMPONENT32F, so the shadow map must use the same format.
+	/// </summary>
+	class ShadowCache {
+	public:
+		ShadowCache() {};
+		~ShadowCache();
+		ShadowCache(const ShadowCache&) = delete;
+		ShadowCache& operator=(const ShadowCache&) = delete;
+		//Reallocates when the shadow map's size changed, which invalidates every layer
+		void setSize(int width, int height, int layers);
+		//Starts a frame: clears per frame stats and the static caster hash
+		void beginFrame();
+		//Every static caster, culled or not, before the first needsRefresh() of the frame. geometry = mesh or model pointer.
+		void addStaticCaster(const glm::mat4& transform, const void* geometry);
+		//True when the layer must be redrawn this frame. The layer is then counted as valid, so draw it right away.
+		/// <param name="staticDraws">Static casters the layer would draw, counted as saved when it comes from the cache</param>
+		bool needsRefresh(int layer, const glm::mat4& lightMatrix, int staticDraws);
+		//Binds the layer as depth target, sets the viewport and clears it. Other state, like depth clamp, is left as the caller set it.
+		void beginStatic(int layer);
+		//Copies the layer into a shadow map texture (GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY at the same layer).
+		//Leaves the framebuffer binding alone.
+		void restore(int layer, unsigned int targetTexture, unsigned int targetType);
+		//Redraws every layer next frame
+		void invalidate();
+		inline const ShadowCacheStats& getStats()const { return m_stats; }
+	private:
+		struct Layer {
+			glm::mat4 lightMatrix = glm::mat4(1.0f);
+			bool valid = false;
+		};
+		void checkStaticCasters();
+
+		int m_width = 0;
+		int m_height = 0;
+		unsigned int m_depthTexture = 0;
+		unsigned int m_fbo = 0;
+		std::vector<Layer> m_layers;
+		uint64_t m_staticHash = 0; //Last frame's casters
+		uint64_t m_frameHash = 0; //Casters added so far this frame
+		bool m_hashChecked = false;
+		ShadowCacheStats m_stats;
+	};
+}
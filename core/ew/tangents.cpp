@@ -0,0 +1,189 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "tangents.h"
+#include "parallel.h"
+#include <math.h>
+#include <chrono>
+
+namespace ew {
+	//Triangles (or vertices) per thread before it's worth splitting
+	static const size_t TANGENT_MIN_TRIANGLES_PER_THREAD = 16384;
+	//Corners whose tangents are further apart than this (cos 90 degrees) get their own vertex
+	static const float TANGENT_SPLIT_COS = 0.0f;
+
+	//One triangle corner's contribution to its vertex
+	struct TangentCorner {
+		glm::vec3 tangent; //Projected onto the vertex normal, normalized
+		float weight; //Corner angle. 0 when the triangle's UVs are degenerate.
+		float sign; //Bitangent sign
+	};
+
+	static inline float cornerAngle(const glm::vec3& corner, const glm::vec3& a, const glm::vec3& b) {
+		glm::vec3 e0 = a - corner;
+		glm::vec3 e1 = b - corner;
+		float len = glm::length(e0) * glm::length(e1);
+		if (len <= 0.0f)
+			return 0.0f;
+		float c = glm::dot(e0, e1) / len;
+		return acosf(c < -1.0f ? -1.0f : (c > 1.0f ? 1.0f : c));
+	}
+
+	static void computeCorners(const MeshData& mesh, size_t firstTriangle, size_t lastTriangle, TangentCorner* corners) {
+		const Vertex* vertices = mesh.vertices.data();
+		const unsigned int* indices = mesh.indices.data();
+		for (size_t t = firstTriangle; t < lastTriangle; t++)
+		{
+			const Vertex* v[3] = { &vertices[indices[t * 3]], &vertices[indices[t * 3 + 1]], &vertices[indices[t * 3 + 2]] };
+			glm::vec3 e1 = v[1]->pos - v[0]->pos;
+			glm::vec3 e2 = v[2]->pos - v[0]->pos;
+			glm::vec2 d1 = v[1]->uv - v[0]->uv;
+			glm::vec2 d2 = v[2]->uv - v[0]->uv;
+			float det = d1.x * d2.y - d2.x * d1.y;
+			bool degenerate = fabsf(det) < 1e-12f;
+			float r = degenerate ? 0.0f : 1.0f / det;
+			glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) * r;
+			glm::vec3 bitangent = (e2 * d1.x - e1 * d2.x) * r;
+			for (int c = 0; c < 3; c++)
+			{
+				TangentCorner& corner = corners[t * 3 + c];
+				const glm::vec3& n = v[c]->normal;
+				//In the plane of this corner's normal, before anything is summed
+				glm::vec3 projected = tangent - n * glm::dot(n, tangent);
+				float len = glm::length(projected);
+				if (degenerate || len < 1e-12f) {
+					//Takes whatever the other corners of the vertex agree on
+					corner.tangent = glm::vec3(0);
+					corner.weight = 0.0f;
+					corner.sign = 1.0f;
+					continue;
+				}
+				corner.tangent = projected / len;
+				corner.weight = cornerAngle(v[c]->pos, v[(c + 1) % 3]->pos, v[(c + 2) % 3]->pos);
+				corner.sign = glm::dot(glm::cross(n, corner.tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+			}
+		}
+	}
+
+	//Any vector perpendicular to the normal, for vertices without usable UVs
+	static inline glm::vec3 fallbackTangent(const glm::vec3& n) {
+		glm::vec3 t = fabsf(n.x) > 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+		return glm::normalize(t - n * glm::dot(n, t));
+	}
+
+	TangentStats generateTangents(MeshData* meshData) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		const size_t numVertices = meshData->vertices.size();
+		const size_t numCorners = meshData->indices.size() / 3 * 3;
+		const size_t numTriangles = numCorners / 3;
+
+		std::vector<TangentCorner> corners(numCorners);
+		parallelFor(numTriangles, TANGENT_MIN_TRIANGLES_PER_THREAD, [&](size_t begin, size_t end) {
+			computeCorners(*meshData, begin, end, corners.data());
+		});
+
+		//Corners of each vertex: vertexCorners[cornerStart[v], cornerStart[v + 1])
+		std::vector<unsigned int> cornerStart(numVertices + 1, 0);
+		for (size_t c = 0; c < numCorners; c++)
+		{
+			cornerStart[meshData->indices[c] + 1]++;
+		}
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			cornerStart[v + 1] += cornerStart[v];
+		}
+		std::vector<unsigned int> vertexCorners(numCorners);
+		std::vector<unsigned int> fill(cornerStart.begin(), cornerStart.end() - 1);
+		for (size_t c = 0; c < numCorners; c++)
+		{
+			vertexCorners[fill[meshData->indices[c]]++] = (unsigned int)c;
+		}
+
+		//Groups corners of each vertex that agree on sign and direction. Group 0 keeps the vertex, the rest are split off.
+		std::vector<unsigned char> cornerGroup(numCorners, 0);
+		std::vector<unsigned int> numGroups(numVertices, 1);
+		parallelFor(numVertices, TANGENT_MIN_TRIANGLES_PER_THREAD, [&](size_t begin, size_t end) {
+			std::vector<glm::vec3> groupSums;
+			std::vector<float> groupSigns;
+			for (size_t v = begin; v < end; v++)
+			{
+				groupSums.clear();
+				groupSigns.clear();
+				for (unsigned int i = cornerStart[v]; i < cornerStart[v + 1]; i++)
+				{
+					const TangentCorner& corner = corners[vertexCorners[i]];
+					if (corner.weight <= 0.0f)
+						continue; //Degenerate corners join group 0 below
+					size_t g = 0;
+					for (; g < groupSums.size(); g++)
+					{
+						if (groupSigns[g] == corner.sign && glm::dot(groupSums[g], corner.tangent) > TANGENT_SPLIT_COS * glm::length(groupSums[g]))
+							break;
+					}
+					if (g == groupSums.size()) {
+						if (g == 255)
+							g = 0; //Out of group ids, so it shares the first one
+						else {
+							groupSums.push_back(glm::vec3(0));
+							groupSigns.push_back(corner.sign);
+						}
+					}
+					groupSums[g] += corner.tangent * corner.weight;
+					cornerGroup[vertexCorners[i]] = (unsigned char)g;
+				}
+				if (groupSums.size() > 1)
+					numGroups[v] = (unsigned int)groupSums.size();
+			}
+		});
+
+		//Where each vertex's split copies go
+		std::vector<unsigned int> splitStart(numVertices);
+		size_t numSplits = 0;
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			splitStart[v] = (unsigned int)(numVertices + numSplits);
+			numSplits += numGroups[v] - 1;
+		}
+		meshData->vertices.resize(numVertices + numSplits);
+		meshData->tangents.resize(numVertices + numSplits);
+
+		//Sums each group, writes its tangent and points its corners at it. Every vertex touches only its own corners and copies.
+		parallelFor(numVertices, TANGENT_MIN_TRIANGLES_PER_THREAD, [&](size_t begin, size_t end) {
+			std::vector<glm::vec4> groups;
+			for (size_t v = begin; v < end; v++)
+			{
+				groups.assign(numGroups[v], glm::vec4(0));
+				for (unsigned int i = cornerStart[v]; i < cornerStart[v + 1]; i++)
+				{
+					unsigned int c = vertexCorners[i];
+					const TangentCorner& corner = corners[c];
+					unsigned int g = cornerGroup[c];
+					groups[g] += glm::vec4(corner.tangent * corner.weight, 0.0f);
+					if (corner.weight > 0.0f)
+						groups[g].w = corner.sign;
+					if (g > 0)
+						meshData->indices[c] = splitStart[v] + g - 1;
+				}
+				const glm::vec3& n = meshData->vertices[v].normal;
+				for (size_t g = 0; g < groups.size(); g++)
+				{
+					size_t target = g == 0 ? v : splitStart[v] + g - 1;
+					if (g > 0)
+						meshData->vertices[target] = meshData->vertices[v];
+					//Each corner was already in the normal's plane, so the sum only needs normalizing
+					glm::vec3 t = glm::vec3(groups[g]);
+					float len = glm::length(t);
+					t = len > 1e-8f ? t / len : fallbackTangent(n);
+					meshData->tangents[target] = glm::vec4(t, groups[g].w < 0.0f ? -1.0f : 1.0f);
+				}
+			}
+		});
+
+		TangentStats stats;
+		stats.triangles = numTriangles;
+		stats.splitVertices = numSplits;
+		stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return stats;
+	}
+}
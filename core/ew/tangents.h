@@ -0,0 +1,25 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	struct TangentStats {
+		size_t triangles = 0;
+		size_t splitVertices = 0; //Vertices added because corners sharing a vertex had mirrored or diverging tangents
+		double seconds = 0.0;
+		inline double trianglesPerSecond()const { return seconds > 0.0 ? triangles / seconds : 0.0; }
+	};
+
+	/// <summary>
+	/// Fills meshData->tangents with one tangent per vertex (xyz = tangent, w = bitangent sign).
+	/// Each triangle's UV tangent is projected onto the plane of every corner's normal, then summed per vertex weighted by corner angle.
+	/// Corners are only summed together when their bitangent signs match and their tangents are less than 90 degrees apart.
+	/// Otherwise the vertex is split: a copy is appended to meshData->vertices and the corner's index points at it.
+	/// Not MikkTSpace, so baked normal maps from other tools can differ slightly away from mirror seams.
+	/// </summary>
+	/// <param name="meshData">Triangle list with positions, normals and UVs</param>
+	TangentStats generateTangents(MeshData* meshData);
+}
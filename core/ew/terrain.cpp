@@ -0,0 +1,390 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "terrain.h"
+#include "parallel.h"
+#include <math.h>
+#include <chrono>
+
+namespace ew {
+	Terrain::Terrain(const TerrainSettings& settings)
+		: m_settings(settings)
+	{
+		if (m_settings.numLods < 1)
+			m_settings.numLods = 1;
+		if (m_settings.lodRingWidth < 1)
+			m_settings.lodRingWidth = 1;
+
+		//Every cell in the radius, plus room for a replacement per cell while LODs change
+		int diameter = m_settings.viewRadius * 2 + 1;
+		size_t poolSize = (size_t)diameter * diameter * 2;
+		m_chunks.resize(poolSize);
+		m_freeChunks.reserve(poolSize);
+		m_activeChunks.reserve(poolSize);
+		m_jobs.items.resize(poolSize);
+		m_completed.items.resize(poolSize);
+
+		//Reserve LOD 0 sized buffers once so chunks can be regenerated at any LOD without reallocating
+		size_t columns = m_settings.chunkResolution + 1;
+		size_t maxVertices = columns * columns;
+		size_t maxIndices = (size_t)m_settings.chunkResolution * m_settings.chunkResolution * 6;
+		for (size_t i = 0; i < poolSize; i++)
+		{
+			m_chunks[i].meshData.vertices.reserve(maxVertices);
+			m_chunks[i].meshData.indices.reserve(maxIndices);
+			m_freeChunks.push_back(poolSize - 1 - i);
+		}
+		m_stats.poolBytes = poolSize * (maxVertices * sizeof(Vertex) + maxIndices * sizeof(unsigned int)) * 2;
+
+		int numWorkers = m_settings.numWorkers;
+		if (numWorkers <= 0) {
+			numWorkers = (int)getNumWorkerThreads() - 1;
+			if (numWorkers < 1)
+				numWorkers = 1;
+		}
+		for (int i = 0; i < numWorkers; i++)
+		{
+			m_workers.emplace_back(&Terrain::workerLoop, this);
+		}
+	}
+
+	Terrain::~Terrain()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_workAvailable.notify_all();
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			m_workers[i].join();
+		}
+	}
+
+	float Terrain::sampleHeight(float x, float z) const
+	{
+		return fbm2D(x, z, m_settings.noise) * m_settings.heightScale;
+	}
+
+	bool Terrain::inRadius(int x, int z, int cameraX, int cameraZ) const
+	{
+		int dx = x - cameraX, dz = z - cameraZ;
+		return dx * dx + dz * dz <= m_settings.viewRadius * m_settings.viewRadius;
+	}
+
+	int Terrain::lodForCell(int x, int z, int cameraX, int cameraZ) const
+	{
+		int dx = abs(x - cameraX), dz = abs(z - cameraZ);
+		int ring = (dx > dz ? dx : dz) / m_settings.lodRingWidth;
+		return ring < m_settings.numLods ? ring : m_settings.numLods - 1;
+	}
+
+	size_t Terrain::chunkBytes(const Chunk& chunk) const
+	{
+		//CPU copy + GPU copy
+		return (chunk.meshData.vertices.size() * sizeof(Vertex) + chunk.meshData.indices.size() * sizeof(unsigned int)) * 2;
+	}
+
+	void Terrain::workerLoop()
+	{
+		//Heights for one chunk with a 1 sample border (for normals), then x/z inputs for one row
+		size_t border = m_settings.chunkResolution + 3;
+		std::vector<float> scratch(border * border + border * 2);
+		while (true) {
+			Chunk* chunk;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_workAvailable.wait(lock, [this] { return m_stopping || m_jobs.count > 0; });
+				if (m_stopping)
+					return;
+				chunk = &m_chunks[m_jobs.pop()];
+				if (chunk->cancelled) {
+					m_completed.push(chunk - m_chunks.data());
+					continue;
+				}
+			}
+			generateChunk(chunk, &scratch);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_completed.push(chunk - m_chunks.data());
+		}
+	}
+
+	/// <summary>
+	/// Fills chunk->meshData. Runs on a worker thread and only touches the chunk and the scratch buffer.
+	/// </summary>
+	void Terrain::generateChunk(Chunk* chunk, std::vector<float>* scratch) const
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		const int resolution = m_settings.chunkResolution >> chunk->lod;
+		const int columns = resolution + 1;
+		const int border = resolution + 3;
+		const float size = m_settings.chunkSize;
+		const float step = size / resolution;
+		const float originX = chunk->x * size;
+		const float originZ = chunk->z * size;
+
+		float* heights = scratch->data();
+		float* xs = heights + border * border;
+		float* zs = xs + border;
+
+		//HEIGHTS (row 0 is at +z like createPlane, 1 sample border on each side)
+		for (int c = 0; c < border; c++)
+		{
+			xs[c] = originX + (c - 1) * step;
+		}
+		for (int r = 0; r < border; r++)
+		{
+			float z = originZ + size - (r - 1) * step;
+			for (int c = 0; c < border; c++)
+			{
+				zs[c] = z;
+			}
+			fbm2D(xs, zs, heights + r * border, border, m_settings.noise);
+		}
+		for (int i = 0; i < border * border; i++)
+		{
+			heights[i] *= m_settings.heightScale;
+		}
+
+		//VERTICES
+		MeshData& mesh = chunk->meshData;
+		mesh.vertices.resize((size_t)columns * columns);
+		mesh.indices.resize((size_t)resolution * resolution * 6);
+		Vertex* v = mesh.vertices.data();
+		const float inv2Step = 1.0f / (2.0f * step);
+		for (int row = 0; row < columns; row++)
+		{
+			const float* h = heights + (row + 1) * border + 1;
+			for (int col = 0; col < columns; col++, v++)
+			{
+				v->uv.x = (float)col / resolution;
+				v->uv.y = (float)row / resolution;
+				v->pos.x = originX + size * v->uv.x;
+				v->pos.y = h[col];
+				v->pos.z = originZ + size - size * v->uv.y;
+				//Central differences. Moving down a row moves toward -z.
+				float dhdx = (h[col + 1] - h[col - 1]) * inv2Step;
+				float dhdz = (h[col - border] - h[col + border]) * inv2Step;
+				v->normal = glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+			}
+		}
+
+		//STITCHING: snap edge vertices facing a coarser neighbor onto the neighbor's edge
+		for (int edge = 0; edge < 4; edge++)
+		{
+			int lodDelta = chunk->neighborLods[edge] - chunk->lod;
+			if (lodDelta <= 0)
+				continue;
+			int ratio = 1 << lodDelta;
+			//-x = col 0, +x = col res, -z = row res, +z = row 0
+			int first, stride;
+			switch (edge) {
+			case 0: first = 0; stride = columns; break;
+			case 1: first = resolution; stride = columns; break;
+			case 2: first = resolution * columns; stride = 1; break;
+			default: first = 0; stride = 1; break;
+			}
+			Vertex* e = mesh.vertices.data() + first;
+			//Normals too: the neighbor takes central differences over its own, coarser step and interpolates between
+			//its edge vertices. Matching both keeps the lighting continuous across the border.
+			const float coarseStep = step * ratio;
+			for (int i = 0; i <= resolution; i += ratio)
+			{
+				Vertex& shared = e[i * stride];
+				float dhdx = (sampleHeight(shared.pos.x + coarseStep, shared.pos.z) - sampleHeight(shared.pos.x - coarseStep, shared.pos.z)) / (2.0f * coarseStep);
+				float dhdz = (sampleHeight(shared.pos.x, shared.pos.z + coarseStep) - sampleHeight(shared.pos.x, shared.pos.z - coarseStep)) / (2.0f * coarseStep);
+				shared.normal = glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+			}
+			for (int i = 0; i < resolution; i += ratio)
+			{
+				const Vertex& a = e[i * stride];
+				const Vertex& b = e[(i + ratio) * stride];
+				for (int j = 1; j < ratio; j++)
+				{
+					float t = (float)j / ratio;
+					Vertex& stitched = e[(i + j) * stride];
+					stitched.pos.y = a.pos.y + (b.pos.y - a.pos.y) * t;
+					stitched.normal = glm::normalize(a.normal + (b.normal - a.normal) * t);
+				}
+			}
+		}
+
+		//INDICES (same pattern as createPlane)
+		unsigned int* index = mesh.indices.data();
+		for (int row = 0; row < resolution; row++)
+		{
+			for (int col = 0; col < resolution; col++)
+			{
+				unsigned int start = row * columns + col;
+				*index++ = start;
+				*index++ = start + 1;
+				*index++ = start + columns + 1;
+				*index++ = start + columns + 1;
+				*index++ = start + columns;
+				*index++ = start;
+			}
+		}
+
+		chunk->generateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	void Terrain::update(const ew::Camera& camera)
+	{
+		const int cameraX = (int)floorf(camera.position.x / m_settings.chunkSize);
+		const int cameraZ = (int)floorf(camera.position.z / m_settings.chunkSize);
+
+		//Upload chunks finished by workers
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			while (m_completed.count > 0) {
+				Chunk& chunk = m_chunks[m_completed.pop()];
+				chunk.state = chunk.cancelled ? ChunkState::FREE : ChunkState::READY;
+			}
+		}
+		for (size_t i = 0; i < m_activeChunks.size(); i++)
+		{
+			Chunk& chunk = m_chunks[m_activeChunks[i]];
+			if (chunk.state != ChunkState::READY)
+				continue;
+			//Mesh::load reuses the GPU allocation when the data fits, so pooled chunks don't reallocate
+			chunk.mesh.load(chunk.meshData);
+			chunk.state = ChunkState::RESIDENT;
+			m_stats.chunksGenerated++;
+			m_stats.lastChunkMs = chunk.generateMs;
+			m_totalGenerateMs += chunk.generateMs;
+			m_stats.avgChunkMs = m_totalGenerateMs / m_stats.chunksGenerated;
+		}
+
+		//Mark wanted chunks and queue missing ones, nearest ring first
+		for (size_t i = 0; i < m_activeChunks.size(); i++)
+		{
+			m_chunks[m_activeChunks[i]].wanted = false;
+		}
+		const int radius = m_settings.viewRadius;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		bool queuedAny = false;
+		for (int ring = 0; ring <= radius; ring++)
+		{
+			for (int z = cameraZ - ring; z <= cameraZ + ring; z++)
+			{
+				for (int x = cameraX - ring; x <= cameraX + ring; x++)
+				{
+					//Only the outline of this ring
+					if (abs(x - cameraX) != ring && abs(z - cameraZ) != ring)
+						continue;
+					if (!inRadius(x, z, cameraX, cameraZ))
+						continue;
+					int lod = lodForCell(x, z, cameraX, cameraZ);
+					//Neighbors outside the radius are never drawn, so there is nothing to stitch against
+					const int nx[4] = { x - 1, x + 1, x, x };
+					const int nz[4] = { z, z, z - 1, z + 1 };
+					int neighborLods[4];
+					for (int n = 0; n < 4; n++)
+					{
+						neighborLods[n] = inRadius(nx[n], nz[n], cameraX, cameraZ) ? lodForCell(nx[n], nz[n], cameraX, cameraZ) : lod;
+					}
+					bool found = false;
+					for (size_t i = 0; i < m_activeChunks.size() && !found; i++)
+					{
+						Chunk& chunk = m_chunks[m_activeChunks[i]];
+						if (chunk.x != x || chunk.z != z || chunk.lod != lod || chunk.cancelled)
+							continue;
+						if (chunk.neighborLods[0] != neighborLods[0] || chunk.neighborLods[1] != neighborLods[1] ||
+							chunk.neighborLods[2] != neighborLods[2] || chunk.neighborLods[3] != neighborLods[3])
+							continue;
+						chunk.wanted = true;
+						found = true;
+					}
+					if (found || m_freeChunks.empty())
+						continue;
+					int index = m_freeChunks.back();
+					m_freeChunks.pop_back();
+					Chunk& chunk = m_chunks[index];
+					chunk.x = x;
+					chunk.z = z;
+					chunk.lod = lod;
+					for (int n = 0; n < 4; n++)
+					{
+						chunk.neighborLods[n] = neighborLods[n];
+					}
+					chunk.state = ChunkState::QUEUED;
+					chunk.cancelled = false;
+					chunk.wanted = true;
+					m_activeChunks.push_back(index);
+					m_jobs.push(index);
+					queuedAny = true;
+				}
+			}
+		}
+
+		//Cancel jobs nobody wants anymore. Workers hand them back through the completed queue.
+		for (size_t i = 0; i < m_activeChunks.size(); i++)
+		{
+			Chunk& chunk = m_chunks[m_activeChunks[i]];
+			if (!chunk.wanted && chunk.state == ChunkState::QUEUED) {
+				chunk.cancelled = true;
+			}
+		}
+		lock.unlock();
+		if (queuedAny) {
+			m_workAvailable.notify_all();
+		}
+
+		//Evict resident chunks that left the radius, or whose replacement for the same cell is ready
+		for (size_t i = 0; i < m_activeChunks.size(); i++)
+		{
+			Chunk& chunk = m_chunks[m_activeChunks[i]];
+			if (chunk.wanted || chunk.state != ChunkState::RESIDENT)
+				continue;
+			bool evict = !inRadius(chunk.x, chunk.z, cameraX, cameraZ);
+			for (size_t j = 0; j < m_activeChunks.size() && !evict; j++)
+			{
+				const Chunk& other = m_chunks[m_activeChunks[j]];
+				evict = other.wanted && other.state == ChunkState::RESIDENT && other.x == chunk.x && other.z == chunk.z;
+			}
+			//Stale chunks with no replacement yet stay on screen so the terrain has no holes
+			if (evict) {
+				chunk.state = ChunkState::FREE;
+			}
+		}
+
+		//Return free chunks to the pool and refresh stats
+		m_stats.residentChunks = 0;
+		m_stats.pendingChunks = 0;
+		m_stats.residentBytes = 0;
+		for (size_t i = 0; i < m_activeChunks.size();)
+		{
+			Chunk& chunk = m_chunks[m_activeChunks[i]];
+			if (chunk.state == ChunkState::FREE) {
+				m_freeChunks.push_back(m_activeChunks[i]);
+				m_activeChunks[i] = m_activeChunks.back();
+				m_activeChunks.pop_back();
+				continue;
+			}
+			if (chunk.state == ChunkState::RESIDENT) {
+				m_stats.residentChunks++;
+				m_stats.residentBytes += chunkBytes(chunk);
+			}
+			else {
+				m_stats.pendingChunks++;
+			}
+			i++;
+		}
+		if (m_stats.residentBytes > m_stats.peakResidentBytes) {
+			m_stats.peakResidentBytes = m_stats.residentBytes;
+		}
+	}
+
+	void Terrain::draw() const
+	{
+		for (size_t i = 0; i < m_activeChunks.size(); i++)
+		{
+			const Chunk& chunk = m_chunks[m_activeChunks[i]];
+			if (chunk.state == ChunkState::RESIDENT) {
+				chunk.mesh.draw();
+			}
+		}
+	}
+}
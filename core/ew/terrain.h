@@ -0,0 +1,103 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+#include "camera.h"
+#include "noise.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ew {
+	struct TerrainSettings {
+		float chunkSize = 32.0f; //World units per chunk edge
+		int chunkResolution = 64; //Quads per chunk edge at LOD 0. Must be divisible by 2^(numLods-1)
+		int numLods = 3;
+		int lodRingWidth = 2; //Chunks per LOD ring around the camera
+		int viewRadius = 6; //Chunks kept around the camera
+		float heightScale = 24.0f;
+		FbmSettings noise;
+		int numWorkers = 0; //0 = one per hardware thread, minus the main thread
+	};
+
+	struct TerrainStats {
+		unsigned int chunksGenerated = 0;
+		double lastChunkMs = 0.0; //Worker time to generate the most recent chunk
+		double avgChunkMs = 0.0;
+		int residentChunks = 0;
+		int pendingChunks = 0;
+		size_t poolBytes = 0; //CPU + GPU bytes reserved up front for every pooled chunk
+		size_t residentBytes = 0; //CPU + GPU bytes used by resident chunks
+		size_t peakResidentBytes = 0; //High-water mark of residentBytes
+	};
+
+	/// <summary>
+	/// Heightfield terrain streamed in fixed-size chunks around the camera.
+	/// Chunks are laid out like createPlane (row-major, same winding), displaced by fBm noise and generated on worker threads.
+	/// Chunk LOD drops with distance; edges facing a coarser neighbor are snapped onto the neighbor's vertices so there are no cracks.
+	/// Every chunk comes from a pool allocated in the constructor, so steady-state streaming does not allocate.
+	/// Vertices are in world space: draw with an identity model matrix.
+	/// </summary>
+	class Terrain {
+	public:
+		Terrain(const TerrainSettings& settings);
+		~Terrain();
+		Terrain(const Terrain&) = delete;
+		Terrain& operator=(const Terrain&) = delete;
+		//Uploads finished chunks, requests missing ones and evicts chunks that left the radius. Call once per frame.
+		void update(const ew::Camera& camera);
+		void draw()const;
+		//Terrain height at a world position, independent of chunk LOD
+		float sampleHeight(float x, float z)const;
+		inline const TerrainStats& getStats()const { return m_stats; }
+		inline const TerrainSettings& getSettings()const { return m_settings; }
+	private:
+		enum class ChunkState {
+			FREE,
+			QUEUED, //Waiting for or being generated by a worker
+			READY, //Generated, waiting for upload on the main thread
+			RESIDENT
+		};
+		struct Chunk {
+			int x = 0, z = 0; //Chunk grid coordinates
+			int lod = 0;
+			int neighborLods[4] = {}; //-x, +x, -z, +z
+			ChunkState state = ChunkState::FREE;
+			bool cancelled = false;
+			bool wanted = false;
+			double generateMs = 0.0;
+			MeshData meshData;
+			Mesh mesh;
+		};
+		//Fixed capacity FIFO of chunk indices
+		struct ChunkQueue {
+			std::vector<int> items;
+			size_t head = 0, count = 0;
+			void push(int chunk) { items[(head + count++) % items.size()] = chunk; }
+			int pop() { int chunk = items[head]; head = (head + 1) % items.size(); count--; return chunk; }
+		};
+
+		int lodForCell(int x, int z, int cameraX, int cameraZ)const;
+		bool inRadius(int x, int z, int cameraX, int cameraZ)const;
+		void generateChunk(Chunk* chunk, std::vector<float>* scratch)const;
+		void workerLoop();
+		size_t chunkBytes(const Chunk& chunk)const;
+
+		TerrainSettings m_settings;
+		TerrainStats m_stats;
+		double m_totalGenerateMs = 0.0;
+		std::vector<Chunk> m_chunks;
+		std::vector<int> m_freeChunks;
+		std::vector<int> m_activeChunks; //Every non-free chunk
+
+		std::mutex m_mutex;
+		std::condition_variable m_workAvailable;
+		ChunkQueue m_jobs; //Guarded by m_mutex
+		ChunkQueue m_completed; //Guarded by m_mutex
+		bool m_stopping = false;
+		std::vector<std::thread> m_workers;
+	};
+}
@@ -3,8 +3,17 @@
 */
 
 #include "texture.h"
+#include "glState.h"
+#include "bcn.h"
+#include "mipmaps.h"
+#include "textureCache.h"
 #include "external/glad.h"
 #include "external/stb_image.h"
+#include <chrono>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <vector>
 
 static int getTextureFormat(int numComponents) {
 	switch (numComponents) {
@@ -19,23 +28,108 @@ static int getTextureFormat(int numComponents) {
 	}
 }
 namespace ew {
-	unsigned int loadTexture(const char* filePath) {
-		stbi_set_flip_vertically_on_load(true);
-		return loadTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true);
+	static bool useCookedTextures = true;
+	static TextureCookStats cookStats;
+	//Mirrors the stb_image setting made for this thread, so cooked files are only used with the orientation they were cooked in
+	static thread_local bool flipOnLoad = false;
+
+	static bool isBCFormatSupported(BCFormat format) {
+		//RGTC (BC4/BC5) is core since GL 3.0, S3TC (BC1/BC3) is an extension every desktop driver has
+		static int s3tc = -1;
+		if (format == BC4 || format == BC5)
+			return true;
+		if (s3tc < 0)
+			s3tc = isGLExtensionSupported("GL_EXT_texture_compression_s3tc");
+		return s3tc != 0;
 	}
-	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap) {
-		int width, height, numComponents;
-		unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 0);
-		if (data == NULL) {
-			printf("Failed to load image %s", filePath);
-			stbi_image_free(data);
-			return 0;
+
+	//Normal maps are data, not colour, so they skip sRGB, get renormalized and are stored as BC5. Recognized by name, e.g. brick_normal.jpg.
+	static bool isNormalMapPath(const std::string& filePath) {
+		std::string name = filePath.substr(filePath.find_last_of("/\\") + 1);
+		for (size_t i = 0; i < name.size(); i++)
+		{
+			name[i] = (char)tolower((unsigned char)name[i]);
+		}
+		return name.find("normal") != std::string::npos || name.find("_nrm") != std::string::npos;
+	}
+
+	static BCFormat chooseBCFormat(const unsigned char* pixels, int width, int height, int numComponents, bool normalMap) {
+		//BC1's shared 565 endpoints skew tangent space normals. BC5 keeps X and Y at full precision and shaders rebuild Z.
+		if (normalMap && numComponents >= 2)
+			return BC5;
+		switch (numComponents) {
+		case 1:
+			return BC4;
+		case 2:
+			return BC5;
+		case 3:
+			return BC1;
+		default:
+			//Opaque RGBA doesn't need BC3's alpha block
+			for (size_t i = 3; i < (size_t)width * height * 4; i += 4)
+			{
+				if (pixels[i] != 255)
+					return BC3;
+			}
+			return BC1;
 		}
+	}
+
+	/// <summary>
+	/// Builds the mip chain, block compresses every level and saves it next to the source
+	/// </summary>
+	static bool cookTexture(const std::string& filePath, const unsigned char* pixels, int width, int height, int numComponents, BCFormat format, std::vector<std::vector<unsigned char>>* levels) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		MipOptions mipOptions;
+		mipOptions.normalMap = isNormalMapPath(filePath);
+		std::vector<MipLevel> mips;
+		generateMips(pixels, width, height, numComponents, mipOptions, &mips);
+		auto mipTime = std::chrono::high_resolution_clock::now();
+		cookStats.mipMs += std::chrono::duration<double, std::milli>(mipTime - startTime).count();
+		for (size_t i = 0; i < mips.size(); i++)
+		{
+			std::vector<unsigned char> blocks(getBCImageSize(format, mips[i].width, mips[i].height));
+			compressBC(format, mips[i].pixels.data(), mips[i].width, mips[i].height, numComponents, blocks.data());
+			cookStats.encodedMegapixels += (double)mips[i].width * mips[i].height / 1000000.0;
+			levels->push_back(std::move(blocks));
+		}
+		cookStats.encodeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - mipTime).count();
+		cookStats.cooked++;
+		return saveCookedTexture(filePath + ".ewtex", filePath, format, width, height, flipOnLoad, *levels);
+	}
+
+	/// <summary>
+	/// Tangent space normals from a height map: a Sobel slope per texel, wrapping at the edges so tiling textures stay seamless.
+	/// Rows are bottom up (flipped on load), so +x is +u and +y is +v. Only X and Y are written, [-1,1] as [0,255].
+	/// </summary>
+	static void heightToNormals(const unsigned char* heights, int width, int height, float depth, unsigned char* normals) {
+		//Heights are [0,255]. Slopes are in UV units, so the same depth looks the same at any resolution.
+		const float scaleX = depth * width / (255.0f * 8.0f);
+		const float scaleY = depth * height / (255.0f * 8.0f);
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char* below = heights + (size_t)((y + height - 1) % height) * width;
+			const unsigned char* row = heights + (size_t)y * width;
+			const unsigned char* above = heights + (size_t)((y + 1) % height) * width;
+			for (int x = 0; x < width; x++)
+			{
+				int left = (x + width - 1) % width;
+				int right = (x + 1) % width;
+				int dx = (below[right] + 2 * row[right] + above[right]) - (below[left] + 2 * row[left] + above[left]);
+				int dy = (above[left] + 2 * above[x] + above[right]) - (below[left] + 2 * below[x] + below[right]);
+				float nx = -dx * scaleX;
+				float ny = -dy * scaleY;
+				float invLength = 1.0f / sqrtf(nx * nx + ny * ny + 1.0f);
+				normals[((size_t)y * width + x) * 2] = (unsigned char)(nx * invLength * 127.5f + 128.0f);
+				normals[((size_t)y * width + x) * 2 + 1] = (unsigned char)(ny * invLength * 127.5f + 128.0f);
+			}
+		}
+	}
+
+	static unsigned int createTexture(int wrapMode, int magFilter, int minFilter) {
 		unsigned int texture;
 		glGenTextures(1, &texture);
 		glBindTexture(GL_TEXTURE_2D, texture);
-		int format = getTextureFormat(numComponents);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
@@ -44,14 +138,169 @@ namespace ew {
 		//Black border by default
 		float borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+		return texture;
+	}
+
+	static void finishTexture() {
+		glBindTexture(GL_TEXTURE_2D, 0);
+		//Bound on whichever unit was active, which the state cache can't tell
+		invalidateGLState();
+	}
+
+	//Blocks go to GL as they are, no decoding
+	static unsigned int uploadCompressed(BCFormat format, const std::vector<CookedTextureLevel>& levels, int wrapMode, int magFilter, int minFilter, bool mipmap) {
+		unsigned int texture = createTexture(wrapMode, magFilter, minFilter);
+		size_t numLevels = mipmap ? levels.size() : 1;
+		for (size_t i = 0; i < numLevels; i++)
+		{
+			const CookedTextureLevel& level = levels[i];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, getBCGLFormat(format), level.width, level.height, 0, (GLsizei)level.size, level.data);
+			cookStats.uncompressedBytes += (size_t)level.width * level.height * 4;
+			cookStats.compressedBytes += level.size;
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)numLevels - 1);
+		finishTexture();
+		return texture;
+	}
+
+	unsigned int loadTexture(const char* filePath) {
+		//Only for this thread, so decodes running on other threads keep their own setting
+		stbi_set_flip_vertically_on_load_thread(true);
+		flipOnLoad = true;
+		return loadTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true);
+	}
+	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap) {
+		if (useCookedTextures) {
+			CookedTexture cooked;
+			if (loadCookedTexture(std::string(filePath) + ".ewtex", filePath, &cooked) && cooked.flipped == flipOnLoad && isBCFormatSupported(cooked.format)) {
+				cookStats.loadedCooked++;
+				return uploadCompressed(cooked.format, cooked.levels, wrapMode, magFilter, minFilter, mipmap);
+			}
+		}
+		int width, height, numComponents;
+		unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 0);
+		if (data == NULL) {
+			printf("Failed to load image %s", filePath);
+			stbi_image_free(data);
+			return 0;
+		}
+		BCFormat bcFormat = chooseBCFormat(data, width, height, numComponents, isNormalMapPath(filePath));
+		if (useCookedTextures && isBCFormatSupported(bcFormat)) {
+			std::vector<std::vector<unsigned char>> blocks;
+			cookTexture(filePath, data, width, height, numComponents, bcFormat, &blocks);
+			stbi_image_free(data);
+			std::vector<CookedTextureLevel> levels(blocks.size());
+			int levelWidth = width, levelHeight = height;
+			for (size_t i = 0; i < blocks.size(); i++)
+			{
+				levels[i].width = levelWidth;
+				levels[i].height = levelHeight;
+				levels[i].data = blocks[i].data();
+				levels[i].size = blocks[i].size();
+				levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+				levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+			}
+			return uploadCompressed(bcFormat, levels, wrapMode, magFilter, minFilter, mipmap);
+		}
+		unsigned int texture = createTexture(wrapMode, magFilter, minFilter);
+		int format = getTextureFormat(numComponents);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 
 		if (mipmap) {
 			glGenerateMipmap(GL_TEXTURE_2D);
 		}
 
-		glBindTexture(GL_TEXTURE_2D, 0);
+		finishTexture();
 		stbi_image_free(data);
 		return texture;
 	}
-}
+	unsigned int loadNormalMapFromHeight(const char* filePath, float depth) {
+		stbi_set_flip_vertically_on_load_thread(true);
+		flipOnLoad = true;
+		int width, height, numComponents;
+		unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 1);
+		if (data == NULL) {
+			printf("Failed to load image %s", filePath);
+			return 0;
+		}
+		std::vector<unsigned char> normals((size_t)width * height * 2);
+		heightToNormals(data, width, height, depth, normals.data());
+		stbi_image_free(data);
 
+		MipOptions mipOptions;
+		mipOptions.srgb = false;
+		mipOptions.normalMap = true;
+		std::vector<MipLevel> mips;
+		generateMips(normals.data(), width, height, 2, mipOptions, &mips);
+		//Compressed like a cooked normal map, but rebuilt on every load since it depends on depth as well as the file
+		if (useCookedTextures && isBCFormatSupported(BC5)) {
+			std::vector<std::vector<unsigned char>> blocks(mips.size());
+			std::vector<CookedTextureLevel> levels(mips.size());
+			for (size_t i = 0; i < mips.size(); i++)
+			{
+				blocks[i].resize(getBCImageSize(BC5, mips[i].width, mips[i].height));
+				compressBC(BC5, mips[i].pixels.data(), mips[i].width, mips[i].height, 2, blocks[i].data());
+				levels[i].width = mips[i].width;
+				levels[i].height = mips[i].height;
+				levels[i].data = blocks[i].data();
+				levels[i].size = blocks[i].size();
+			}
+			return uploadCompressed(BC5, levels, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true);
+		}
+		unsigned int texture = createTexture(GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
+		//Rows of RG8 aren't 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t i = 0; i < mips.size(); i++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RG8, mips[i].width, mips[i].height, 0, GL_RG, GL_UNSIGNED_BYTE, mips[i].pixels.data());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		finishTexture();
+		return texture;
+	}
+	void setUseCookedTextures(bool enabled)
+	{
+		useCookedTextures = enabled;
+	}
+	bool isUsingCookedTextures()
+	{
+		return useCookedTextures;
+	}
+	const TextureCookStats& getTextureCookStats()
+	{
+		return cookStats;
+	}
+	size_t getTextureGPUBytes(unsigned int texture)
+	{
+		if (texture == 0)
+			return 0;
+		size_t bytes = 0;
+		//Past the last level, width reads as 0
+		for (int level = 0; level < 32; level++)
+		{
+			GLint width = 0, height = 0, depth = 0, compressed = 0;
+			glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &width);
+			if (width == 0)
+				break;
+			glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &height);
+			glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_DEPTH, &depth);
+			glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED, &compressed);
+			if (compressed) {
+				GLint size = 0;
+				glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+				bytes += size;
+				continue;
+			}
+			const GLenum sizeQueries[6] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE };
+			GLint bits = 0;
+			for (int i = 0; i < 6; i++)
+			{
+				GLint channelBits = 0;
+				glGetTextureLevelParameteriv(texture, level, sizeQueries[i], &channelBits);
+				bits += channelBits;
+			}
+			bytes += (size_t)width * height * (depth > 0 ? depth : 1) * ((bits + 7) / 8);
+		}
+		return bytes;
+	}
+}
@@ -3,8 +3,33 @@
 */
 
 #pragma once
+#include <stddef.h>
 
 namespace ew {
+	struct TextureCookStats {
+		int cooked = 0; //Block compressed from the source image, then saved
+		int loadedCooked = 0; //Mapped from a cooked file
+		double mipMs = 0.0; //CPU mip generation (generateMips)
+		double encodeMs = 0.0; //Block compression of every level
+		double encodedMegapixels = 0.0; //Every level of every cooked texture
+		//Every compressed texture uploaded, and what the same levels take as RGBA8 (drivers pad RGB8 to 4 bytes too)
+		size_t uncompressedBytes = 0;
+		size_t compressedBytes = 0;
+	};
+
+	//Prefers a cooked, block compressed copy (filePath + ".ewtex") and writes one when it is missing or out of date
 	unsigned int loadTexture(const char* filePath);
 	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+	/// <summary>
+	/// Builds a tangent space normal map (OpenGL convention, green up) from a grayscale height map, e.g. a displacement texture.
+	/// Only X and Y are stored, as BC5 when cooking is on or RG8 otherwise, so shaders rebuild Z. Repeats and has mips.
+	/// </summary>
+	/// <param name="depth">How far white sits above black, in UV units</param>
+	unsigned int loadNormalMapFromHeight(const char* filePath, float depth);
+	//On by default. Off, textures are decoded and uploaded uncompressed every time.
+	void setUseCookedTextures(bool enabled);
+	bool isUsingCookedTextures();
+	const TextureCookStats& getTextureCookStats();
+	//Bytes of every level (and layer) of any texture, asked from GL. Compressed levels report their real size.
+	size_t getTextureGPUBytes(unsigned int texture);
 }
@@ -0,0 +1,145 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "textureCache.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace ew {
+	static const char COOKED_TEXTURE_MAGIC[4] = { 'E', 'W', 'T', 'X' };
+	static const uint32_t COOKED_TEXTURE_VERSION = 2; //2: mips from generateMips instead of a gamma space box filter
+	static const uint64_t COOKED_TEXTURE_ALIGNMENT = 16;
+
+	struct CookedTextureHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t format; //BCFormat
+		uint32_t width;
+		uint32_t height;
+		uint32_t numLevels;
+		uint32_t flipped;
+		uint32_t reserved;
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+	};
+
+	//Followed by one entry per level, like KTX2's level index
+	struct CookedLevelEntry {
+		uint64_t offset; //From the start of the file
+		uint64_t size;
+	};
+
+	static bool getSourceInfo(const std::string& sourcePath, uint64_t* size, int64_t* modifiedTime) {
+		struct stat st;
+		if (stat(sourcePath.c_str(), &st) != 0)
+			return false;
+		*size = (uint64_t)st.st_size;
+		*modifiedTime = (int64_t)st.st_mtime;
+		return true;
+	}
+
+	static uint64_t alignOffset(uint64_t offset) {
+		return (offset + COOKED_TEXTURE_ALIGNMENT - 1) & ~(COOKED_TEXTURE_ALIGNMENT - 1);
+	}
+
+	bool saveCookedTexture(const std::string& cookedPath, const std::string& sourcePath, BCFormat format, int width, int height, bool flipped, const std::vector<std::vector<unsigned char>>& levels)
+	{
+		CookedTextureHeader header;
+		memcpy(header.magic, COOKED_TEXTURE_MAGIC, 4);
+		header.version = COOKED_TEXTURE_VERSION;
+		header.format = format;
+		header.width = width;
+		header.height = height;
+		header.numLevels = (uint32_t)levels.size();
+		header.flipped = flipped;
+		header.reserved = 0;
+		if (!getSourceInfo(sourcePath, &header.sourceSize, &header.sourceModifiedTime))
+			return false;
+
+		std::vector<CookedLevelEntry> entries(levels.size());
+		uint64_t offset = sizeof(header) + sizeof(CookedLevelEntry) * levels.size();
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			offset = alignOffset(offset);
+			entries[i].offset = offset;
+			entries[i].size = levels[i].size();
+			offset += levels[i].size();
+		}
+
+		FILE* file = fopen(cookedPath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write cooked texture %s", cookedPath.c_str());
+			return false;
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && fwrite(entries.data(), sizeof(CookedLevelEntry), entries.size(), file) == entries.size();
+		uint64_t written = sizeof(header) + sizeof(CookedLevelEntry) * levels.size();
+		const unsigned char padding[COOKED_TEXTURE_ALIGNMENT] = {};
+		for (size_t i = 0; i < levels.size() && ok; i++)
+		{
+			size_t padBytes = (size_t)(entries[i].offset - written);
+			ok = fwrite(padding, 1, padBytes, file) == padBytes;
+			ok = ok && fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+			written = entries[i].offset + entries[i].size;
+		}
+		fclose(file);
+		if (!ok) {
+			remove(cookedPath.c_str());
+		}
+		return ok;
+	}
+
+	bool loadCookedTexture(const std::string& cookedPath, const std::string& sourcePath, CookedTexture* texture)
+	{
+		if (!texture->file.open(cookedPath))
+			return false;
+		const unsigned char* data = texture->file.getData();
+		size_t fileSize = texture->file.getSize();
+		CookedTextureHeader header;
+		uint64_t sourceSize = 0;
+		int64_t sourceModifiedTime = 0;
+		bool ok = fileSize >= sizeof(header);
+		if (ok) {
+			memcpy(&header, data, sizeof(header));
+			ok = memcmp(header.magic, COOKED_TEXTURE_MAGIC, 4) == 0
+				&& header.version == COOKED_TEXTURE_VERSION
+				&& (header.format == BC1 || header.format == BC3 || header.format == BC4 || header.format == BC5)
+				&& header.numLevels > 0 && header.numLevels <= 32
+				&& fileSize >= sizeof(header) + sizeof(CookedLevelEntry) * header.numLevels
+				&& getSourceInfo(sourcePath, &sourceSize, &sourceModifiedTime)
+				&& header.sourceSize == sourceSize
+				&& header.sourceModifiedTime == sourceModifiedTime;
+		}
+		if (ok) {
+			texture->format = (BCFormat)header.format;
+			texture->width = header.width;
+			texture->height = header.height;
+			texture->flipped = header.flipped != 0;
+			texture->levels.resize(header.numLevels);
+		}
+		int levelWidth = header.width, levelHeight = header.height;
+		for (uint32_t i = 0; i < header.numLevels && ok; i++)
+		{
+			CookedLevelEntry entry;
+			memcpy(&entry, data + sizeof(header) + sizeof(CookedLevelEntry) * i, sizeof(entry));
+			ok = entry.size == getBCImageSize(texture->format, levelWidth, levelHeight)
+				&& entry.offset + entry.size <= fileSize;
+			CookedTextureLevel& level = texture->levels[i];
+			level.width = levelWidth;
+			level.height = levelHeight;
+			level.data = data + entry.offset;
+			level.size = (size_t)entry.size;
+			levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+			levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+		}
+		if (!ok) {
+			texture->levels.clear();
+			texture->file.close();
+		}
+		return ok;
+	}
+}
@@ -0,0 +1,39 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "bcn.h"
+#include "mappedFile.h"
+#include <string>
+#include <vector>
+
+namespace ew {
+	struct CookedTextureLevel {
+		int width;
+		int height;
+		const unsigned char* data; //Into the mapped file
+		size_t size;
+	};
+
+	/// <summary>
+	/// A cooked texture mapped straight from disk. Levels point into the mapping, so they are only valid while this lives.
+	/// </summary>
+	struct CookedTexture {
+		BCFormat format = BC1;
+		int width = 0;
+		int height = 0;
+		bool flipped = false; //Rows were flipped vertically when decoded
+		std::vector<CookedTextureLevel> levels; //Level 0 first
+		MappedFile file;
+	};
+
+	/// <summary>
+	/// Writes block compressed mip levels to a KTX2 style file: a header tagged with the source file's size and
+	/// modification time, a level index, then each level's blocks at a 16 byte aligned offset, ready to map and upload as is.
+	/// </summary>
+	/// <param name="levels">Level 0 first, each getBCImageSize bytes for its size (width and height halve, down to 1)</param>
+	bool saveCookedTexture(const std::string& cookedPath, const std::string& sourcePath, BCFormat format, int width, int height, bool flipped, const std::vector<std::vector<unsigned char>>& levels);
+	//Maps a file written by saveCookedTexture. Fails if the file is missing, corrupt, or the source changed since cooking.
+	bool loadCookedTexture(const std::string& cookedPath, const std::string& sourcePath, CookedTexture* texture);
+}
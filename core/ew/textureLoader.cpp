@@ -0,0 +1,324 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "textureLoader.h"
+#include "parallel.h"
+#include "external/stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	namespace {
+		//Buffers in flight. The one used this frame is normally free again two frames later.
+		const int NUM_UPLOAD_BUFFERS = 3;
+
+		void getTextureFormat(int numComponents, GLenum* internalFormat, GLenum* format) {
+			switch (numComponents) {
+			default:
+				*internalFormat = GL_RGBA8;
+				*format = GL_RGBA;
+				break;
+			case 3:
+				*internalFormat = GL_RGB8;
+				*format = GL_RGB;
+				break;
+			case 2:
+				*internalFormat = GL_RG8;
+				*format = GL_RG;
+				break;
+			case 1:
+				*internalFormat = GL_R8;
+				*format = GL_RED;
+				break;
+			}
+		}
+
+		int numMipLevels(int width, int height) {
+			int levels = 1;
+			while ((width | height) >> levels) {
+				levels++;
+			}
+			return levels;
+		}
+
+		//Rows of one texture copied into the upload buffer, waiting for their glTextureSubImage2D
+		struct PendingCopy {
+			int index;
+			int firstRow;
+			int numRows;
+			size_t offset;
+		};
+	}
+
+	TextureLoader::TextureLoader(unsigned int numThreads, size_t uploadBudget)
+		: m_uploadBudget(uploadBudget)
+	{
+		unsigned char grey[4] = { 128, 128, 128, 255 };
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_placeholder);
+		glTextureStorage2D(m_placeholder, 1, GL_RGBA8, 1, 1);
+		glTextureSubImage2D(m_placeholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+		m_uploadBuffers.resize(NUM_UPLOAD_BUFFERS);
+		for (size_t i = 0; i < m_uploadBuffers.size(); i++)
+		{
+			glCreateBuffers(1, &m_uploadBuffers[i].buffer);
+		}
+
+		if (numThreads == 0) {
+			//Leave a core for the render thread
+			numThreads = std::max(getNumWorkerThreads(), 2u) - 1;
+		}
+		for (unsigned int i = 0; i < numThreads; i++)
+		{
+			m_workers.emplace_back(&TextureLoader::workerLoop, this);
+		}
+	}
+
+	TextureLoader::~TextureLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			m_workers[i].join();
+		}
+		for (size_t i = 0; i < m_decoded.size(); i++)
+		{
+			stbi_image_free(m_decoded[i].pixels);
+		}
+		for (size_t i = 0; i < m_textures.size(); i++)
+		{
+			stbi_image_free(m_textures[i].pixels);
+		}
+		for (size_t i = 0; i < m_uploadBuffers.size(); i++)
+		{
+			if (m_uploadBuffers[i].fence)
+				glDeleteSync(m_uploadBuffers[i].fence);
+			glDeleteBuffers(1, &m_uploadBuffers[i].buffer);
+		}
+		//Loaded textures belong to the caller, the same as with loadTexture
+		glDeleteTextures(1, &m_placeholder);
+	}
+
+	void TextureLoader::workerLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_wake.wait(lock, [this]() { return m_quit || !m_decodeQueue.empty(); });
+			if (m_quit)
+				return;
+			DecodeJob job = m_decodeQueue.front();
+			m_decodeQueue.pop_front();
+			m_numDecoding++;
+			lock.unlock();
+
+			auto startTime = std::chrono::high_resolution_clock::now();
+			//stb_image's global flip setting is shared by every thread, so each decode sets its own
+			stbi_set_flip_vertically_on_load_thread(job.flipVertically);
+			Decoded decoded;
+			decoded.index = job.index;
+			decoded.pixels = stbi_load(job.filePath.c_str(), &decoded.width, &decoded.height, &decoded.numComponents, 0);
+			double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+			lock.lock();
+			m_decoded.push_back(decoded);
+			m_decodeMs += decodeMs;
+			m_numDecoding--;
+			m_decodedSignal.notify_all();
+		}
+	}
+
+	TextureHandle TextureLoader::load(const std::string& filePath, const TextureLoadOptions& options)
+	{
+		TextureHandle handle;
+		handle.index = (int)m_textures.size();
+		Texture texture;
+		texture.filePath = filePath;
+		texture.options = options;
+		m_textures.push_back(texture);
+		m_stats.requested++;
+		DecodeJob job;
+		job.index = handle.index;
+		job.filePath = filePath;
+		job.flipVertically = options.flipVertically;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_decodeQueue.push_back(job);
+		}
+		m_wake.notify_one();
+		return handle;
+	}
+
+	void TextureLoader::createTexture(Texture* texture, const Decoded& decoded)
+	{
+		texture->pixels = decoded.pixels;
+		texture->width = decoded.width;
+		texture->height = decoded.height;
+		texture->numComponents = decoded.numComponents;
+		GLenum internalFormat, format;
+		getTextureFormat(decoded.numComponents, &internalFormat, &format);
+		//Immutable storage with every mip up front, so the driver never has to reallocate.
+		//DSA calls leave the bindings the GL state cache knows about alone.
+		int levels = texture->options.mipmap ? numMipLevels(decoded.width, decoded.height) : 1;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture->texture);
+		glTextureStorage2D(texture->texture, levels, internalFormat, decoded.width, decoded.height);
+		glTextureParameteri(texture->texture, GL_TEXTURE_WRAP_S, texture->options.wrapMode);
+		glTextureParameteri(texture->texture, GL_TEXTURE_WRAP_T, texture->options.wrapMode);
+		glTextureParameteri(texture->texture, GL_TEXTURE_MIN_FILTER, texture->options.minFilter);
+		glTextureParameteri(texture->texture, GL_TEXTURE_MAG_FILTER, texture->options.magFilter);
+		//Black border by default
+		float borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		glTextureParameterfv(texture->texture, GL_TEXTURE_BORDER_COLOR, borderColor);
+	}
+
+	void TextureLoader::update()
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		m_stats.bytesUploaded = 0;
+		m_stats.uploads = 0;
+		m_stats.pboStalls = 0;
+
+		std::vector<Decoded> decoded;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			decoded.swap(m_decoded);
+			m_stats.decodeMs = m_decodeMs;
+		}
+		for (size_t i = 0; i < decoded.size(); i++)
+		{
+			Texture& texture = m_textures[decoded[i].index];
+			if (!decoded[i].pixels) {
+				printf("Failed to load image %s", texture.filePath.c_str());
+				texture.failed = true;
+				m_stats.failed++;
+				continue;
+			}
+			createTexture(&texture, decoded[i]);
+			m_uploadQueue.push_back(decoded[i].index);
+			m_stats.decoded++;
+		}
+		if (m_uploadQueue.empty()) {
+			m_stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			return;
+		}
+
+		//One buffer per frame holds every row uploaded this frame. If the GPU is still reading it, try next frame.
+		UploadBuffer& uploadBuffer = m_uploadBuffers[m_nextUploadBuffer];
+		if (uploadBuffer.fence) {
+			GLenum status = glClientWaitSync(uploadBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			//A failed wait says nothing about the GPU, so the buffer is treated as still in use
+			if (status == GL_WAIT_FAILED) {
+				printf("Failed to wait on texture upload fence");
+			}
+			if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+				m_stats.pboStalls++;
+				m_stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+				return;
+			}
+			glDeleteSync(uploadBuffer.fence);
+			uploadBuffer.fence = nullptr;
+		}
+		//Always room for at least one row of the next texture
+		const Texture& front = m_textures[m_uploadQueue.front()];
+		size_t bufferSize = std::max(m_uploadBudget, (size_t)front.width * front.numComponents);
+		if (uploadBuffer.size < bufferSize) {
+			glNamedBufferData(uploadBuffer.buffer, bufferSize, nullptr, GL_STREAM_DRAW);
+			uploadBuffer.size = bufferSize;
+		}
+		//The fence above guarantees the GPU is done with the old contents
+		unsigned char* mapped = (unsigned char*)glMapNamedBufferRange(uploadBuffer.buffer, 0, bufferSize,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!mapped) {
+			printf("Failed to map texture upload buffer");
+			m_stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			return;
+		}
+		std::vector<PendingCopy> copies;
+		size_t used = 0;
+		for (size_t i = 0; i < m_uploadQueue.size(); i++)
+		{
+			Texture& texture = m_textures[m_uploadQueue[i]];
+			size_t rowBytes = (size_t)texture.width * texture.numComponents;
+			int numRows = std::min((int)((bufferSize - used) / rowBytes), texture.height - texture.nextRow);
+			if (numRows <= 0)
+				break;
+			PendingCopy copy;
+			copy.index = m_uploadQueue[i];
+			copy.firstRow = texture.nextRow;
+			copy.numRows = numRows;
+			copy.offset = used;
+			memcpy(mapped + used, texture.pixels + (size_t)texture.nextRow * rowBytes, numRows * rowBytes);
+			copies.push_back(copy);
+			texture.nextRow += numRows;
+			used += numRows * rowBytes;
+		}
+		glUnmapNamedBuffer(uploadBuffer.buffer);
+
+		//Rows of RGB and single channel images aren't 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer.buffer);
+		for (size_t i = 0; i < copies.size(); i++)
+		{
+			const PendingCopy& copy = copies[i];
+			Texture& texture = m_textures[copy.index];
+			GLenum internalFormat, format;
+			getTextureFormat(texture.numComponents, &internalFormat, &format);
+			//With a buffer bound the pointer is an offset into it
+			glTextureSubImage2D(texture.texture, 0, 0, copy.firstRow, texture.width, copy.numRows, format, GL_UNSIGNED_BYTE, (const void*)(uintptr_t)copy.offset);
+			m_stats.uploads++;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		uploadBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_nextUploadBuffer = (m_nextUploadBuffer + 1) % m_uploadBuffers.size();
+		m_stats.bytesUploaded = used;
+
+		//Finished textures only ever sit at the front, since the copies above went in queue order
+		while (!m_uploadQueue.empty()) {
+			Texture& texture = m_textures[m_uploadQueue.front()];
+			if (texture.nextRow < texture.height)
+				break;
+			if (texture.options.mipmap) {
+				glGenerateTextureMipmap(texture.texture);
+			}
+			stbi_image_free(texture.pixels);
+			texture.pixels = nullptr;
+			texture.ready = true;
+			m_stats.ready++;
+			m_uploadQueue.pop_front();
+		}
+		m_stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	void TextureLoader::finishAll()
+	{
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_decodedSignal.wait(lock, [this]() { return m_decodeQueue.empty() && m_numDecoding == 0; });
+			}
+			update();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_uploadQueue.empty() && m_decoded.empty() && m_decodeQueue.empty())
+				return;
+		}
+	}
+
+	unsigned int TextureLoader::get(TextureHandle handle) const
+	{
+		if (!isReady(handle))
+			return m_placeholder;
+		return m_textures[handle.index].texture;
+	}
+
+	bool TextureLoader::isReady(TextureHandle handle) const
+	{
+		return handle.isValid() && handle.index < (int)m_textures.size() && m_textures[handle.index].ready;
+	}
+}
@@ -0,0 +1,122 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "external/glad.h"
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Texture from TextureLoader::load. Only valid for the loader that made it.
+	/// </summary>
+	struct TextureHandle {
+		int index = -1;
+		inline bool isValid()const { return index >= 0; }
+	};
+
+	struct TextureLoadOptions {
+		int wrapMode = GL_REPEAT;
+		int magFilter = GL_LINEAR;
+		int minFilter = GL_LINEAR_MIPMAP_LINEAR;
+		bool mipmap = true;
+		bool flipVertically = true; //Per decode, never touches stb_image's global setting
+	};
+
+	struct TextureLoaderStats {
+		int requested = 0;
+		int decoded = 0;
+		int ready = 0; //Fully uploaded, get() returns the real texture
+		int failed = 0; //get() keeps returning the placeholder
+		double decodeMs = 0.0; //Summed over the worker threads
+		//Per update()
+		size_t bytesUploaded = 0;
+		int uploads = 0; //glTextureSubImage2D calls
+		int pboStalls = 0; //Times the next PBO was still being read by the GPU (or waiting on it failed), so uploading stopped for the frame
+		double updateMs = 0.0; //Main thread CPU time
+	};
+
+	/// <summary>
+	/// Loads textures without stalling the frame. load() returns at once and worker threads decode with stb_image.
+	/// update() streams decoded pixels to immutable (glTextureStorage2D) textures through a ring of pixel buffer objects,
+	/// at most uploadBudget bytes per call, so big images are spread over several frames.
+	/// Until a texture is complete, get() returns a 1x1 grey placeholder, so callers can bind get() every frame.
+	/// Mips are generated on the GPU once the last rows are in.
+	/// </summary>
+	class TextureLoader {
+	public:
+		/// <param name="numThreads">Decode threads. 0 = one per core, less one for the render thread</param>
+		/// <param name="uploadBudget">Bytes uploaded per update(). At least one row of one image is always uploaded.</param>
+		TextureLoader(unsigned int numThreads = 0, size_t uploadBudget = 8 * 1024 * 1024);
+		~TextureLoader();
+		TextureLoader(const TextureLoader&) = delete;
+		TextureLoader& operator=(const TextureLoader&) = delete;
+		TextureHandle load(const std::string& filePath, const TextureLoadOptions& options = TextureLoadOptions());
+		//Call once per frame, on the GL thread
+		void update();
+		//Blocks until every texture requested so far is ready or failed
+		void finishAll();
+		//The texture, or the placeholder until it is ready
+		unsigned int get(TextureHandle handle)const;
+		bool isReady(TextureHandle handle)const;
+		inline unsigned int getPlaceholder()const { return m_placeholder; }
+		inline void setUploadBudget(size_t bytes) { m_uploadBudget = bytes; }
+		inline size_t getUploadBudget()const { return m_uploadBudget; }
+		inline const TextureLoaderStats& getStats()const { return m_stats; }
+	private:
+		struct Texture {
+			std::string filePath;
+			TextureLoadOptions options;
+			unsigned int texture = 0; //Created once decoded
+			unsigned char* pixels = nullptr; //Freed once uploaded
+			int width = 0;
+			int height = 0;
+			int numComponents = 0;
+			int nextRow = 0; //First row not uploaded yet
+			bool ready = false;
+			bool failed = false;
+		};
+		struct DecodeJob {
+			int index;
+			std::string filePath;
+			bool flipVertically;
+		};
+		struct Decoded {
+			int index;
+			unsigned char* pixels; //Null if decoding failed
+			int width, height, numComponents;
+		};
+		struct UploadBuffer {
+			unsigned int buffer = 0;
+			size_t size = 0;
+			GLsync fence = nullptr; //Signalled once the GPU has read the last upload from this buffer
+		};
+		void workerLoop();
+		void createTexture(Texture* texture, const Decoded& decoded);
+
+		std::vector<Texture> m_textures; //GL thread only. Workers get copies of what they need.
+		unsigned int m_placeholder = 0;
+		size_t m_uploadBudget;
+		std::vector<UploadBuffer> m_uploadBuffers;
+		size_t m_nextUploadBuffer = 0;
+		std::deque<int> m_uploadQueue; //Decoded, waiting for upload. GL thread only.
+		TextureLoaderStats m_stats;
+
+		//Shared with the workers
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_decodedSignal;
+		std::deque<DecodeJob> m_decodeQueue;
+		std::vector<Decoded> m_decoded; //Finished since the last update()
+		int m_numDecoding = 0;
+		double m_decodeMs = 0.0;
+		bool m_quit = false;
+	};
+}
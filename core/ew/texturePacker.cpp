@@ -0,0 +1,335 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "texturePacker.h"
+#include "external/glad.h"
+#include "external/stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	namespace {
+		int numMipLevels(int width, int height) {
+			int levels = 1;
+			while ((width | height) >> levels) {
+				levels++;
+			}
+			return levels;
+		}
+
+		int alignUp(int value, int alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		/// <summary>
+		/// Copies an RGBA8 image into the atlas with padding texels on every side repeating its edge,
+		/// so filtering and the first few mips see the texture's own border instead of its neighbours
+		/// </summary>
+		void blitPadded(const unsigned char* pixels, int width, int height, int padding, unsigned char* atlas, int atlasWidth, int x, int y) {
+			for (int row = -padding; row < height + padding; row++)
+			{
+				int srcRow = row < 0 ? 0 : (row >= height ? height - 1 : row);
+				const unsigned char* src = pixels + (size_t)srcRow * width * 4;
+				unsigned char* dst = atlas + ((size_t)(y + padding + row) * atlasWidth + x) * 4;
+				for (int i = 0; i < padding; i++)
+				{
+					memcpy(dst + i * 4, src, 4);
+					memcpy(dst + (padding + width + i) * 4, src + (width - 1) * 4, 4);
+				}
+				memcpy(dst + padding * 4, src, (size_t)width * 4);
+			}
+		}
+	}
+
+	SkylinePacker::SkylinePacker(int width, int height)
+		: m_width(width), m_height(height)
+	{
+		Segment floor;
+		floor.x = 0;
+		floor.y = 0;
+		floor.width = width;
+		m_skyline.push_back(floor);
+	}
+
+	int SkylinePacker::fitAt(size_t index, int width, int height)const
+	{
+		if (m_skyline[index].x + width > m_width) {
+			return -1;
+		}
+		//Rests on the highest segment it spans
+		int y = 0;
+		int remaining = width;
+		for (size_t i = index; remaining > 0; i++)
+		{
+			y = std::max(y, m_skyline[i].y);
+			if (y + height > m_height) {
+				return -1;
+			}
+			remaining -= m_skyline[i].width;
+		}
+		return y;
+	}
+
+	bool SkylinePacker::insert(int width, int height, int* x, int* y)
+	{
+		int bestTop = INT_MAX;
+		int bestY = 0;
+		size_t bestIndex = 0;
+		for (size_t i = 0; i < m_skyline.size(); i++)
+		{
+			int fitY = fitAt(i, width, height);
+			if (fitY >= 0 && fitY + height < bestTop) {
+				bestTop = fitY + height;
+				bestY = fitY;
+				bestIndex = i;
+			}
+		}
+		if (bestTop == INT_MAX) {
+			return false;
+		}
+		Segment placed;
+		placed.x = m_skyline[bestIndex].x;
+		placed.y = bestTop;
+		placed.width = width;
+		m_skyline.insert(m_skyline.begin() + bestIndex, placed);
+		//Trim the segments now under the new one
+		size_t next = bestIndex + 1;
+		while (next < m_skyline.size() && m_skyline[next].x < placed.x + placed.width) {
+			int overlap = placed.x + placed.width - m_skyline[next].x;
+			if (overlap < m_skyline[next].width) {
+				m_skyline[next].x += overlap;
+				m_skyline[next].width -= overlap;
+				break;
+			}
+			m_skyline.erase(m_skyline.begin() + next);
+		}
+		//Neighbours at the same height become one segment
+		for (size_t i = 0; i + 1 < m_skyline.size();)
+		{
+			if (m_skyline[i].y == m_skyline[i + 1].y) {
+				m_skyline[i].width += m_skyline[i + 1].width;
+				m_skyline.erase(m_skyline.begin() + i + 1);
+			}
+			else {
+				i++;
+			}
+		}
+		*x = placed.x;
+		*y = bestY;
+		m_usedArea += (size_t)width * height;
+		return true;
+	}
+
+	int SkylinePacker::getUsedHeight()const
+	{
+		int height = 0;
+		for (size_t i = 0; i < m_skyline.size(); i++)
+		{
+			height = std::max(height, m_skyline[i].y);
+		}
+		return height;
+	}
+
+	TexturePacker::TexturePacker(const TexturePackOptions& options)
+		: m_options(options)
+	{
+	}
+
+	int TexturePacker::add(const std::string& filePath)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		Image image;
+		image.filePath = filePath;
+		int numComponents;
+		stbi_set_flip_vertically_on_load_thread(m_options.flipVertically);
+		image.pixels = stbi_load(filePath.c_str(), &image.width, &image.height, &numComponents, 4);
+		if (!image.pixels) {
+			printf("Failed to load image %s", filePath.c_str());
+			m_stats.failed++;
+		}
+		m_images.push_back(image);
+		m_packed.push_back(PackedTexture());
+		m_stats.textures++;
+		m_stats.decodeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return (int)m_images.size() - 1;
+	}
+
+	void TexturePacker::pack()
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		if (m_options.mode == TEXTURE_PACK_ARRAY) {
+			packArrays();
+		}
+		else {
+			packAtlases();
+		}
+		for (size_t i = 0; i < m_images.size(); i++)
+		{
+			stbi_image_free(m_images[i].pixels);
+			m_images[i].pixels = nullptr;
+		}
+		m_stats.packMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	void TexturePacker::packArrays()
+	{
+		//Size -> images, in the order they were added
+		std::map<std::pair<int, int>, std::vector<int>> groups;
+		for (size_t i = 0; i < m_images.size(); i++)
+		{
+			if (m_images[i].pixels) {
+				groups[std::make_pair(m_images[i].width, m_images[i].height)].push_back((int)i);
+			}
+		}
+		GLint maxLayers = 256;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		for (auto it = groups.begin(); it != groups.end(); ++it)
+		{
+			int width = it->first.first, height = it->first.second;
+			const std::vector<int>& indices = it->second;
+			for (size_t first = 0; first < indices.size(); first += maxLayers)
+			{
+				int numLayers = (int)std::min(indices.size() - first, (size_t)maxLayers);
+				unsigned int texture;
+				glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+				glTextureStorage3D(texture, numMipLevels(width, height), GL_RGBA8, width, height, numLayers);
+				glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+				glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				for (int layer = 0; layer < numLayers; layer++)
+				{
+					int index = indices[first + layer];
+					glTextureSubImage3D(texture, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, m_images[index].pixels);
+					m_packed[index].texture = texture;
+					m_packed[index].layer = layer;
+				}
+				glGenerateTextureMipmap(texture);
+				m_glTextures.push_back(texture);
+				m_stats.arrays++;
+				m_stats.layers += numLayers;
+				m_stats.bytes += (size_t)width * height * 4 * numLayers;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Fills one atlas at a time from the images left, tallest first. Each atlas is as wide as packs the most images
+	/// into the least area, and cropped to the height used.
+	/// </summary>
+	void TexturePacker::packAtlases()
+	{
+		int padding = std::max(m_options.padding, 0);
+		int alignment = 1, maxLevel = 0;
+		while (alignment * 2 <= padding) {
+			alignment *= 2;
+			maxLevel++;
+		}
+		//Rectangles start on multiples of the padding, so every mip level up to log2(padding) keeps whole texels of padding
+		std::vector<int> remaining;
+		for (size_t i = 0; i < m_images.size(); i++)
+		{
+			const Image& image = m_images[i];
+			if (!image.pixels) {
+				continue;
+			}
+			if (image.width + padding * 2 > m_options.maxAtlasSize || image.height + padding * 2 > m_options.maxAtlasSize) {
+				printf("Failed to pack %s: %dx%d plus padding is bigger than the %d atlas limit", image.filePath.c_str(), image.width, image.height, m_options.maxAtlasSize);
+				m_stats.failed++;
+				continue;
+			}
+			remaining.push_back((int)i);
+		}
+		std::stable_sort(remaining.begin(), remaining.end(), [this](int a, int b) {
+			return m_images[a].height > m_images[b].height;
+		});
+
+		while (!remaining.empty()) {
+			size_t area = 0;
+			int widest = 0;
+			for (size_t i = 0; i < remaining.size(); i++)
+			{
+				const Image& image = m_images[remaining[i]];
+				int width = alignUp(image.width + padding * 2, alignment);
+				int height = alignUp(image.height + padding * 2, alignment);
+				area += (size_t)width * height;
+				widest = std::max(widest, width);
+			}
+			//Tries widths from the widest image up, each with the full height, and keeps the one with the smallest cropped area.
+			//Packing is cheap next to uploading, so trying a few dozen widths costs little.
+			int bestWidth = 0, bestHeight = 0;
+			size_t bestPlaced = 0, bestArea = 0;
+			for (int width = widest; ; width = alignUp(width + std::max(width / 16, alignment), alignment))
+			{
+				width = std::min(width, m_options.maxAtlasSize);
+				SkylinePacker packer(width, m_options.maxAtlasSize);
+				size_t numPlaced = 0;
+				for (size_t i = 0; i < remaining.size(); i++)
+				{
+					const Image& image = m_images[remaining[i]];
+					int x, y;
+					numPlaced += packer.insert(alignUp(image.width + padding * 2, alignment), alignUp(image.height + padding * 2, alignment), &x, &y);
+				}
+				size_t usedArea = (size_t)width * packer.getUsedHeight();
+				if (numPlaced > bestPlaced || (numPlaced == bestPlaced && usedArea < bestArea)) {
+					bestWidth = width;
+					bestHeight = packer.getUsedHeight();
+					bestPlaced = numPlaced;
+					bestArea = usedArea;
+				}
+				//Wider than a square holding everything only adds empty columns
+				if (width >= m_options.maxAtlasSize || (numPlaced == remaining.size() && (size_t)width * width >= area * 2)) {
+					break;
+				}
+			}
+			int atlasWidth = bestWidth, atlasHeight = bestHeight;
+			std::vector<int> placed, left;
+			std::vector<glm::ivec2> positions;
+			SkylinePacker packer(atlasWidth, atlasHeight);
+			for (size_t i = 0; i < remaining.size(); i++)
+			{
+				const Image& image = m_images[remaining[i]];
+				glm::ivec2 position;
+				if (packer.insert(alignUp(image.width + padding * 2, alignment), alignUp(image.height + padding * 2, alignment), &position.x, &position.y)) {
+					placed.push_back(remaining[i]);
+					positions.push_back(position);
+				}
+				else {
+					left.push_back(remaining[i]);
+				}
+			}
+
+			std::vector<unsigned char> pixels((size_t)atlasWidth * atlasHeight * 4);
+			unsigned int texture;
+			glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+			glTextureStorage2D(texture, std::min(maxLevel + 1, numMipLevels(atlasWidth, atlasHeight)), GL_RGBA8, atlasWidth, atlasHeight);
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			for (size_t i = 0; i < placed.size(); i++)
+			{
+				const Image& image = m_images[placed[i]];
+				blitPadded(image.pixels, image.width, image.height, padding, pixels.data(), atlasWidth, positions[i].x, positions[i].y);
+				PackedTexture& packed = m_packed[placed[i]];
+				packed.texture = texture;
+				packed.uvRect = glm::vec4((float)image.width / atlasWidth, (float)image.height / atlasHeight,
+					(float)(positions[i].x + padding) / atlasWidth, (float)(positions[i].y + padding) / atlasHeight);
+				m_stats.packedTexels += (size_t)image.width * image.height;
+			}
+			glTextureSubImage2D(texture, 0, 0, 0, atlasWidth, atlasHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			glGenerateTextureMipmap(texture);
+			m_glTextures.push_back(texture);
+			m_stats.atlases++;
+			m_stats.atlasTexels += (size_t)atlasWidth * atlasHeight;
+			m_stats.bytes += pixels.size();
+			remaining.swap(left);
+		}
+	}
+}
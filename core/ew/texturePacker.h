@@ -0,0 +1,112 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace ew {
+	enum TexturePackMode {
+		//Same size textures share a GL_TEXTURE_2D_ARRAY, one per layer. Wrapping and the full mip chain keep working.
+		TEXTURE_PACK_ARRAY,
+		//Any size, packed into GL_TEXTURE_2D atlases with padded, edge-extended borders. lit.frag wraps UVs inside
+		//each texture's rectangle, so repeating UVs tile it without reading its neighbours. Mips stop once the padding is used up.
+		TEXTURE_PACK_ATLAS
+	};
+
+	struct TexturePackOptions {
+		TexturePackMode mode = TEXTURE_PACK_ARRAY;
+		int padding = 8; //Atlas only. Texels of edge colour around each texture, a power of two. Mip levels past log2(padding) would bleed, so atlases stop there.
+		int maxAtlasSize = 4096; //Atlas only. Textures that don't fit start another atlas.
+		bool flipVertically = true; //Same as loadTexture
+	};
+
+	/// <summary>
+	/// Where a texture ended up. Bind texture, then sample it at vec3(uv * uvRect.xy + uvRect.zw, layer), with fract(uv) for
+	/// repeating UVs in an atlas (lit.frag does this from MaterialUniforms::MainTexLayer and MainTexRect).
+	/// </summary>
+	struct PackedTexture {
+		unsigned int texture = 0; //GL_TEXTURE_2D_ARRAY, or GL_TEXTURE_2D for atlases. 0 if loading failed.
+		int layer = 0; //Always 0 in an atlas
+		glm::vec4 uvRect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); //Scale xy, offset zw. Identity for array layers.
+	};
+
+	struct TexturePackStats {
+		int textures = 0;
+		int failed = 0;
+		int arrays = 0;
+		int layers = 0;
+		int atlases = 0;
+		size_t packedTexels = 0; //Texels of the packed images, not counting padding
+		size_t atlasTexels = 0;
+		size_t bytes = 0; //Level 0 of every array and atlas, RGBA8
+		double packMs = 0.0; //Packing and upload, not decoding
+		double decodeMs = 0.0;
+		//Share of atlas texels holding texture data. Arrays are always full.
+		inline float atlasOccupancy()const { return atlasTexels ? (float)packedTexels / atlasTexels : 0.0f; }
+	};
+
+	/// <summary>
+	/// Skyline bottom-left rectangle packer. Keeps the top edge of everything placed so far as a list of horizontal
+	/// segments and puts each rectangle where its top ends lowest, so it wastes little space on rectangles sorted by height.
+	/// </summary>
+	class SkylinePacker {
+	public:
+		SkylinePacker(int width, int height);
+		//False if it doesn't fit anywhere
+		bool insert(int width, int height, int* x, int* y);
+		//Highest point of the skyline, i.e. the height actually used
+		int getUsedHeight()const;
+		inline float getOccupancy()const { return (float)m_usedArea / ((float)m_width * m_height); }
+		inline int getWidth()const { return m_width; }
+		inline int getHeight()const { return m_height; }
+	private:
+		struct Segment {
+			int x, y, width;
+		};
+		//Lowest y a width x height rectangle can sit at with its left edge on segment index. -1 if it doesn't fit.
+		int fitAt(size_t index, int width, int height)const;
+
+		int m_width, m_height;
+		size_t m_usedArea = 0;
+		std::vector<Segment> m_skyline;
+	};
+
+	/// <summary>
+	/// Packs many small textures into a few big ones at load time, so materials that used to need their own texture
+	/// can share one binding. add() every texture first, then pack() once; materials then point at get(index).
+	/// Every image is expanded to RGBA8, so arrays only group by size.
+	/// The packed textures belong to the caller, the same as with loadTexture.
+	/// </summary>
+	class TexturePacker {
+	public:
+		TexturePacker(const TexturePackOptions& options = TexturePackOptions());
+		//Decodes now. Returns the index for get(), even if decoding failed.
+		int add(const std::string& filePath);
+		//Creates and uploads the GL textures. Call once, on the GL thread.
+		void pack();
+		inline const PackedTexture& get(int index)const { return m_packed[index]; }
+		inline size_t getNumTextures()const { return m_packed.size(); }
+		inline const std::vector<unsigned int>& getGLTextures()const { return m_glTextures; }
+		inline const TexturePackStats& getStats()const { return m_stats; }
+		inline const TexturePackOptions& getOptions()const { return m_options; }
+	private:
+		struct Image {
+			std::string filePath;
+			unsigned char* pixels = nullptr; //RGBA8, freed once packed
+			int width = 0;
+			int height = 0;
+		};
+		void packArrays();
+		void packAtlases();
+
+		TexturePackOptions m_options;
+		std::vector<Image> m_images;
+		std::vector<PackedTexture> m_packed;
+		std::vector<unsigned int> m_glTextures;
+		TexturePackStats m_stats;
+	};
+}
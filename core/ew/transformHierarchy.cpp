@@ -0,0 +1,168 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "transformHierarchy.h"
+#include <stdio.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_TRANSFORM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	int TransformHierarchy::add(const Transform& local, int parent)
+	{
+		int node = (int)m_parents.size();
+		if (parent >= node || parent < TRANSFORM_NO_PARENT) {
+			printf("Failed to add transform: parent %d does not exist", parent);
+			parent = TRANSFORM_NO_PARENT;
+		}
+		m_parents.push_back(parent);
+		m_dirty.push_back(1);
+		m_world.push_back(glm::mat4(1.0f));
+		//Grow the SoA arrays a block of 4 identity transforms at a time
+		if ((size_t)node >= m_posX.size()) {
+			size_t padded = m_posX.size() + 4;
+			m_posX.resize(padded, 0.0f);
+			m_posY.resize(padded, 0.0f);
+			m_posZ.resize(padded, 0.0f);
+			m_rotX.resize(padded, 0.0f);
+			m_rotY.resize(padded, 0.0f);
+			m_rotZ.resize(padded, 0.0f);
+			m_rotW.resize(padded, 1.0f);
+			m_scaleX.resize(padded, 1.0f);
+			m_scaleY.resize(padded, 1.0f);
+			m_scaleZ.resize(padded, 1.0f);
+			m_local.resize(padded, glm::mat4(1.0f));
+		}
+		setLocal(node, local);
+		return node;
+	}
+
+	void TransformHierarchy::setLocal(int node, const Transform& local)
+	{
+		setPosition(node, local.position);
+		setRotation(node, local.rotation);
+		setScale(node, local.scale);
+	}
+
+	void TransformHierarchy::setPosition(int node, const glm::vec3& position)
+	{
+		m_posX[node] = position.x;
+		m_posY[node] = position.y;
+		m_posZ[node] = position.z;
+		m_dirty[node] = 1;
+	}
+
+	void TransformHierarchy::setRotation(int node, const glm::quat& rotation)
+	{
+		m_rotX[node] = rotation.x;
+		m_rotY[node] = rotation.y;
+		m_rotZ[node] = rotation.z;
+		m_rotW[node] = rotation.w;
+		m_dirty[node] = 1;
+	}
+
+	void TransformHierarchy::setScale(int node, const glm::vec3& scale)
+	{
+		m_scaleX[node] = scale.x;
+		m_scaleY[node] = scale.y;
+		m_scaleZ[node] = scale.z;
+		m_dirty[node] = 1;
+	}
+
+	Transform TransformHierarchy::getLocal(int node) const
+	{
+		Transform t;
+		t.position = glm::vec3(m_posX[node], m_posY[node], m_posZ[node]);
+		t.rotation = glm::quat(m_rotW[node], m_rotX[node], m_rotY[node], m_rotZ[node]);
+		t.scale = glm::vec3(m_scaleX[node], m_scaleY[node], m_scaleZ[node]);
+		return t;
+	}
+
+	void TransformHierarchy::update()
+	{
+		const int numNodes = (int)m_parents.size();
+		//Children of dirty nodes are dirty. Parents come first, so one forward pass is enough.
+		int recomputed = 0;
+		for (int i = 0; i < numNodes; i++)
+		{
+			int parent = m_parents[i];
+			if (parent != TRANSFORM_NO_PARENT && m_dirty[parent])
+				m_dirty[i] = 1;
+			recomputed += m_dirty[i];
+		}
+		m_stats.recomputed = recomputed;
+		m_stats.reused = numNodes - recomputed;
+		if (recomputed == 0)
+			return;
+
+		//Local matrices, same result as Transform::modelMatrix(). Blocks without a dirty node are skipped.
+		for (int b = 0; b < numNodes; b += 4)
+		{
+			bool anyDirty = false;
+			for (int i = b; i < b + 4 && i < numNodes; i++)
+			{
+				anyDirty |= m_dirty[i] != 0;
+			}
+			if (!anyDirty)
+				continue;
+#ifdef EW_TRANSFORM_SSE2
+			__m128 x = _mm_loadu_ps(&m_rotX[b]), y = _mm_loadu_ps(&m_rotY[b]), z = _mm_loadu_ps(&m_rotZ[b]), w = _mm_loadu_ps(&m_rotW[b]);
+			const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+			__m128 sx = _mm_loadu_ps(&m_scaleX[b]), sy = _mm_loadu_ps(&m_scaleY[b]), sz = _mm_loadu_ps(&m_scaleZ[b]);
+			//cols[c][r] holds element (c, r) of 4 nodes, one per lane
+			__m128 cols[4][4];
+			cols[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+			cols[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+			cols[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+			cols[0][3] = _mm_setzero_ps();
+			cols[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+			cols[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+			cols[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+			cols[1][3] = _mm_setzero_ps();
+			cols[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+			cols[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+			cols[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+			cols[2][3] = _mm_setzero_ps();
+			cols[3][0] = _mm_loadu_ps(&m_posX[b]);
+			cols[3][1] = _mm_loadu_ps(&m_posY[b]);
+			cols[3][2] = _mm_loadu_ps(&m_posZ[b]);
+			cols[3][3] = one;
+			//Transposing a column turns 4 lanes of one element into one column for each of the 4 nodes
+			for (int c = 0; c < 4; c++)
+			{
+				_MM_TRANSPOSE4_PS(cols[c][0], cols[c][1], cols[c][2], cols[c][3]);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					_mm_storeu_ps(&m_local[b + lane][c][0], cols[c][lane]);
+				}
+			}
+#else
+			for (int i = b; i < b + 4; i++)
+			{
+				float x = m_rotX[i], y = m_rotY[i], z = m_rotZ[i], w = m_rotW[i];
+				glm::mat4& m = m_local[i];
+				m[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * m_scaleX[i];
+				m[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * m_scaleY[i];
+				m[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * m_scaleZ[i];
+				m[3] = glm::vec4(m_posX[i], m_posY[i], m_posZ[i], 1.0f);
+			}
+#endif
+		}
+
+		//World = parent world * local, parents already final
+		for (int i = 0; i < numNodes; i++)
+		{
+			if (!m_dirty[i])
+				continue;
+			int parent = m_parents[i];
+			m_world[i] = parent == TRANSFORM_NO_PARENT ? m_local[i] : m_world[parent] * m_local[i];
+			m_dirty[i] = 0;
+		}
+	}
+}
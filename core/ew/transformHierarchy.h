@@ -0,0 +1,52 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "transform.h"
+#include <stdint.h>
+#include <vector>
+
+namespace ew {
+	const int TRANSFORM_NO_PARENT = -1;
+
+	struct TransformHierarchyStats {
+		int recomputed = 0; //World matrices rebuilt by the last update()
+		int reused = 0; //World matrices left as they were
+	};
+
+	/// <summary>
+	/// Flat scene transform hierarchy. Local TRS is stored as structure-of-arrays with a parent index and dirty bit per node.
+	/// update() rebuilds only dirty nodes and their descendants, 4 nodes per SSE2 instruction, and caches the world matrices
+	/// so every render pass can read them without rebuilding.
+	/// Nodes are referenced by the index returned from add(). Parents always come before their children.
+	/// </summary>
+	class TransformHierarchy {
+	public:
+		//parent must be a node that already exists, or TRANSFORM_NO_PARENT
+		int add(const Transform& local = Transform(), int parent = TRANSFORM_NO_PARENT);
+		void setLocal(int node, const Transform& local);
+		void setPosition(int node, const glm::vec3& position);
+		void setRotation(int node, const glm::quat& rotation);
+		void setScale(int node, const glm::vec3& scale);
+		Transform getLocal(int node)const;
+		inline int getParent(int node)const { return m_parents[node]; }
+		//Recomputes world matrices for dirty nodes and their descendants. Call once per frame, after edits and before drawing.
+		void update();
+		inline const glm::mat4& getWorldMatrix(int node)const { return m_world[node]; }
+		//Contiguous world matrices, indexed by node. Can be uploaded straight to an InstanceBuffer.
+		inline const glm::mat4* getWorldMatrices()const { return m_world.data(); }
+		inline int getNumNodes()const { return (int)m_parents.size(); }
+		inline const TransformHierarchyStats& getStats()const { return m_stats; }
+	private:
+		//Local TRS, padded to a multiple of 4 with identity transforms
+		std::vector<float> m_posX, m_posY, m_posZ;
+		std::vector<float> m_rotX, m_rotY, m_rotZ, m_rotW;
+		std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+		std::vector<int> m_parents;
+		std::vector<uint8_t> m_dirty;
+		std::vector<glm::mat4> m_local;
+		std::vector<glm::mat4> m_world;
+		TransformHierarchyStats m_stats;
+	};
+}
@@ -0,0 +1,43 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "uniformBuffer.h"
+#include "external/glad.h"
+
+namespace ew {
+	UniformBuffer::UniformBuffer(size_t size)
+	{
+		create(size);
+	}
+	UniformBuffer::~UniformBuffer()
+	{
+		if (m_ubo != 0) {
+			glDeleteBuffers(1, &m_ubo);
+		}
+	}
+	void UniformBuffer::create(size_t size)
+	{
+		if (m_ubo == 0) {
+			glGenBuffers(1, &m_ubo);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_size = size;
+	}
+	void UniformBuffer::update(const void* data, size_t size)
+	{
+		if (size > m_size)
+			size = m_size;
+		if (size == 0)
+			return;
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	void UniformBuffer::bind(unsigned int binding) const
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_ubo);
+	}
+}
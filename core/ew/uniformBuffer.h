@@ -0,0 +1,74 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+#include <stddef.h>
+
+namespace ew {
+	//Uniform block bindings shared by the lit shaders: layout(std140, binding = N) uniform ...
+	const unsigned int UNIFORM_BLOCK_FRAME = 0; //Camera and light, updated once per frame
+	const unsigned int UNIFORM_BLOCK_MATERIAL = 1; //One buffer per material, bound when the material changes
+	const unsigned int UNIFORM_BLOCK_SHADOWS = 2; //Cascaded shadow matrices, updated once per frame
+	const int SHADOW_MAX_CASCADES = 4;
+
+	//std140 layout of FrameData in assets/ew/frame.glsl
+	struct FrameUniforms {
+		glm::mat4 viewProjection;
+		glm::mat4 lightSpaceMatrix;
+		glm::vec3 eyePos;
+		float bias = 0.0f;
+		glm::vec3 lightPos;
+		float padding0 = 0.0f;
+		glm::vec3 lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+		float padding1 = 0.0f;
+	};
+	static_assert(sizeof(FrameUniforms) == 176, "FrameUniforms must match std140 FrameData");
+
+	//std140 layout of MaterialData in assets/ew/material.glsl
+	struct MaterialUniforms {
+		float Ka = 1.0f;
+		float Kd = 0.5f;
+		float Ks = 0.5f;
+		float Shininess = 128.0f;
+		glm::vec4 MainTexRect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); //_MainTex UV scale xy, offset zw. See PackedTexture::uvRect.
+		float MainTexLayer = 0.0f; //_MainTex layer in TEXTURE_ARRAY variants
+		float padding0 = 0.0f;
+		float padding1 = 0.0f;
+		float padding2 = 0.0f;
+	};
+	static_assert(sizeof(MaterialUniforms) == 48, "MaterialUniforms must match std140 MaterialData");
+
+	//std140 layout of ShadowData in assets/ew/shadows.glsl. Filled by CascadedShadowMap::getUniforms.
+	struct CascadeUniforms {
+		glm::mat4 lightMatrices[SHADOW_MAX_CASCADES]; //World -> light clip space of each cascade
+		glm::vec4 splits = glm::vec4(0.0f); //Far view depth of each cascade
+		glm::vec4 bias = glm::vec4(0.0f); //Depth bias of each cascade
+		glm::vec3 cameraForward = glm::vec3(0.0f, 0.0f, -1.0f); //View depth = dot(worldPos - eyePos, cameraForward)
+		int numCascades = 0;
+	};
+	static_assert(sizeof(CascadeUniforms) == 304, "CascadeUniforms must match std140 ShadowData");
+
+	/// <summary>
+	/// Uniform buffer holding one std140 block. The CPU struct uploaded to it must match the block's std140 layout:
+	/// vec3s take 16 bytes unless followed by a float, and mat4/vec4 must start on 16 byte boundaries.
+	/// </summary>
+	class UniformBuffer {
+	public:
+		UniformBuffer() {};
+		UniformBuffer(size_t size);
+		~UniformBuffer();
+		UniformBuffer(const UniformBuffer&) = delete;
+		UniformBuffer& operator=(const UniformBuffer&) = delete;
+		void create(size_t size);
+		//Replaces the start of the buffer. Clamped to its size.
+		void update(const void* data, size_t size);
+		void bind(unsigned int binding)const;
+		inline size_t getSize()const { return m_size; }
+		inline unsigned int getId()const { return m_ubo; }
+	private:
+		unsigned int m_ubo = 0;
+		size_t m_size = 0;
+	};
+}